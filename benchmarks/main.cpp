@@ -1,6 +1,10 @@
 #include <benchmark/benchmark.h>
 
 #include <engine/utils/mesh_generation.h>
+#include <engine/rendering/vulkan/shader_parsing.h>
+#include <engine/rendering/vulkan/fileutils.h>
+
+#include <spirv_cross/spirv_glsl.hpp>
 
 void BM_SphereMeshGeneration(benchmark::State& state)
 {
@@ -14,4 +18,55 @@ void BM_SphereMeshGeneration(benchmark::State& state)
 
 BENCHMARK(BM_SphereMeshGeneration)->Unit(benchmark::kSecond);
 
+namespace
+{
+  std::vector<std::vector<uint32_t>> ReadParsingTestShaders()
+  {
+    std::vector<std::vector<uint32_t>> shaders;
+    for (const char* name : { "test0_all_uniform_types.vert", "test1_merge_uniforms.vert", "test1_merge_uniforms.frag",
+                              "test2_compute_storage.comp", "test3_frequency_sets.vert", "test4_push_constants.vert",
+                              "test4_push_constants.frag", "test5_specialization.vert", "test5_specialization.frag" })
+    {
+      shaders.push_back(Vulkan::ReadFile(std::string("../data/shaders/spirv/tests/") + name + ".spv"));
+    }
+
+    return shaders;
+  }
+}
+
+void BM_SpirvParser(benchmark::State& state)
+{
+  const std::vector<std::vector<uint32_t>> shaders = ReadParsingTestShaders();
+  Vulkan::SpirvParser parser;
+
+  for (auto _ : state)
+    for (const std::vector<uint32_t>& shader : shaders)
+      benchmark::DoNotOptimize(parser.ParseShader(shader));
+
+  state.SetItemsProcessed(state.iterations() * shaders.size());
+}
+
+BENCHMARK(BM_SpirvParser)->Unit(benchmark::kMicrosecond);
+
+//setup of the previous parser, a glsl backend built only for the reflection
+void BM_SpirvGlslCompilerReflection(benchmark::State& state)
+{
+  const std::vector<std::vector<uint32_t>> shaders = ReadParsingTestShaders();
+
+  for (auto _ : state)
+  {
+    for (const std::vector<uint32_t>& shader : shaders)
+    {
+      spirv_cross::CompilerGLSL glsl{ shader };
+      benchmark::DoNotOptimize(glsl.get_shader_resources());
+      benchmark::DoNotOptimize(glsl.get_entry_points_and_stages());
+      benchmark::DoNotOptimize(glsl.get_entry_points_and_stages());
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * shaders.size());
+}
+
+BENCHMARK(BM_SpirvGlslCompilerReflection)->Unit(benchmark::kMicrosecond);
+
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 450
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D LightingTexture;
+
+void main()
+{
+  outColor = texelFetch(LightingTexture, ivec2(gl_FragCoord.xy), 0);
+}
@@ -4,7 +4,7 @@ layout(location = 0 ) in vec3 texPosition;
 
 layout(location = 0) out vec4 outBaseColor;
 
-layout(set = 0, binding = 1) uniform samplerCube SkyboxTexture;
+layout(set = 1, binding = 0) uniform samplerCube SkyboxTexture;
 
 void main()
 {
@@ -8,6 +8,10 @@ layout(set = 0, binding = 0) uniform PerFrame
 {
   mat4 Projection;
   mat4 View;
+};
+
+layout(push_constant) uniform PerDraw
+{
   mat4 Model; //should be only scaled
 };
 
@@ -13,16 +13,23 @@ layout(location = 3) out vec4 outMetallic;
 layout(location = 4) out vec4 outRoughness;
 layout(location = 5) out vec4 outDepth;
 
-layout(set = 0, binding = 1) uniform sampler2D BaseColorTexture;
-layout(set = 0, binding = 2) uniform sampler2D NormalTexture;
-layout(set = 0, binding = 3) uniform sampler2D MetallicRoughnessTexture;
+layout(set = 1, binding = 0) uniform sampler2D BaseColorTexture;
+layout(set = 1, binding = 1) uniform sampler2D NormalTexture;
+layout(set = 1, binding = 2) uniform sampler2D MetallicRoughnessTexture;
+
+//variants without normal mapping skip the normal texture fetch
+layout(constant_id = 0) const bool NORMAL_MAPPING = true;
 
 void main()
 {
-  mat3 tbn = mat3(tangent, bitangent, normal);
+  vec3 worldNormal = normal;
+  if (NORMAL_MAPPING)
+  {
+    mat3 tbn = mat3(tangent, bitangent, normal);
 
-  vec3 tangentNormal = texture(NormalTexture, uv).rgb * 2.0f -1.0f;
-  vec3 worldNormal = tbn * tangentNormal;
+    vec3 tangentNormal = texture(NormalTexture, uv).rgb * 2.0f -1.0f;
+    worldNormal = tbn * tangentNormal;
+  }
 
   outBaseColor = texture(BaseColorTexture,uv);
   outWorldPosition = vec4(worldPosition, 1.0f);
@@ -12,9 +12,12 @@ layout(location = 2) out vec3 normal_out;
 layout(location = 3) out vec2 uv_out;
 layout(location = 4) out vec3 worldPosition;
 
-layout(set=0, binding=0) uniform PerStaticMeshResource {
+layout(set=0, binding=0) uniform PerFrame {
    mat4 Projection;
    mat4 View;
+};
+
+layout(push_constant) uniform PerStaticMeshResource {
    mat4 Model;
 };
 
@@ -0,0 +1,14 @@
+#version 450
+
+layout(set=0, binding=0) uniform per_frame_uniform {
+   mat4 view_projection;
+};
+
+layout(set=2, binding=0) uniform per_draw_uniform {
+   mat4 model;
+};
+
+void main()
+{
+  gl_Position = view_projection * model * vec4(1.0f, 1.0f, 0.0, 1.0);
+}
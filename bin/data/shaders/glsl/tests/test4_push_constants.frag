@@ -0,0 +1,14 @@
+#version 450
+
+layout(push_constant) uniform push_constants_uniform {
+   layout(offset = 64) vec4 color;
+};
+
+layout(location = 0) in vec4 color_in;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+  outColor = color_in * color;
+}
@@ -0,0 +1,14 @@
+#version 450
+
+layout(push_constant) uniform push_constants_uniform {
+   mat4 model;
+   vec4 color;
+};
+
+layout(location = 0) out vec4 color_out;
+
+void main()
+{
+  color_out = color;
+  gl_Position = model * vec4(1.0f, 1.0f, 0.0, 1.0);
+}
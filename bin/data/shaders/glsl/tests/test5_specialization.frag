@@ -0,0 +1,11 @@
+#version 450
+
+layout(constant_id = 0) const bool use_offset = false;
+layout(constant_id = 2) const int outputs_count = 3;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+  outColor = vec4(use_offset ? 1.0f : 0.0f, float(outputs_count), 0.0f, 1.0f);
+}
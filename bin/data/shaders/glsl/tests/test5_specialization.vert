@@ -0,0 +1,9 @@
+#version 450
+
+layout(constant_id = 0) const bool use_offset = false;
+layout(constant_id = 1) const float offset = 0.5f;
+
+void main()
+{
+  gl_Position = vec4(use_offset ? offset : 0.0f, 1.0f, 0.0, 1.0);
+}
@@ -2,9 +2,12 @@
 #include "camera.h"
 
 #include <engine/engine.h>
+#include <engine/profiling/cpu_profiler.h>
 
 #include <yaml-cpp/yaml.h>
 
+#include <iostream>
+
 int main()
 {
   const YAML::Node config = YAML::LoadFile("../data/levels/cubes.yaml");
@@ -16,6 +19,16 @@ int main()
   settings.window.width = engineConfig["window"]["width"].as<uint32_t>();
   settings.window.height = engineConfig["window"]["height"].as<uint32_t>();
 
+  std::string traceFile;
+  if (const YAML::Node headlessConfig = engineConfig["headless"])
+  {
+    settings.headless.isEnabled = headlessConfig["enabled"].as<bool>();
+    settings.headless.framesCount = headlessConfig["frames"].as<uint32_t>();
+
+    if (const YAML::Node traceFileConfig = headlessConfig["trace_file"])
+      traceFile = traceFileConfig.as<std::string>();
+  }
+
   Engine engine{ settings };
 
   engine.AddSystems([&](Context& ecsContext)
@@ -31,4 +44,18 @@ int main()
   });
 
   engine.Start();
+
+  if (settings.headless.isEnabled)
+  {
+    const Engine::FrameTimeStatistics& stats = engine.GetFrameTimeStatistics();
+    std::cout << "frames: " << stats.framesCount
+              << " cpu avg: " << stats.averageMilliseconds << "ms"
+              << " min: " << stats.minMilliseconds << "ms"
+              << " max: " << stats.maxMilliseconds << "ms"
+              << " gpu finished: " << stats.totalMilliseconds << "ms"
+              << " (" << stats.averageFrameMilliseconds << "ms per frame)" << std::endl;
+
+    if (!traceFile.empty())
+      CpuProfiler::Get().ExportChromeTrace(traceFile);
+  }
 }
@@ -5,8 +5,6 @@
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include <GLFW/glfw3native.h>
 
 namespace
 {
@@ -137,10 +135,8 @@ void SphereConstructDemo::Dt(float dt)
 
         Vulkan::UniformsAccessor* uniforms = ctx.GetUniformsAccessor(*m_LineShader);
         uniforms->SetUniformBuffer("Camera", &camera);
-        std::vector<vk::DescriptorSet> descriptorSets = uniforms->GetUpdatedDescriptorSets();
-
         vk::DeviceSize offset = 0;
-        ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+        ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, uniforms->GetUpdatedDescriptorSets(), uniforms->GetDynamicOffsets());
         ctx.commandBuffer.bindVertexBuffers(0, 1, &m_Mesh.vertexBuffer.GetBuffer(), &offset);
         ctx.commandBuffer.bindIndexBuffer(m_Mesh.indexBuffer.GetBuffer(), 0, vk::IndexType::eUint32);
 
@@ -82,9 +82,7 @@ namespace Rendering
 
     Vulkan::UniformsAccessor* uniforms = ctx.GetUniformsAccessor(*m_SceneLinesProgram);
     uniforms->SetUniformBuffer("Camera", &cameraResource);
-    std::vector<vk::DescriptorSet> descriptorSets = uniforms->GetUpdatedDescriptorSets();
-
-    ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+    ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, uniforms->GetUpdatedDescriptorSets(), uniforms->GetDynamicOffsets());
 
     vk::DeviceSize offset = 0;
     ctx.commandBuffer.bindVertexBuffers(0, 1, &m_SceneLines.vertices.GetBuffer(), &offset);
@@ -113,9 +111,7 @@ namespace Rendering
 
     Vulkan::UniformsAccessor* uniforms = ctx.GetUniformsAccessor(*m_StaticMeshProgram);
     uniforms->SetUniformBuffer("Camera", &cameraResource);
-    std::vector<vk::DescriptorSet> descriptorSets = uniforms->GetUpdatedDescriptorSets();
-
-    ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+    ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, uniforms->GetUpdatedDescriptorSets(), uniforms->GetDynamicOffsets());
 
     for (const auto& obj : objects)
     {
@@ -1,6 +1,7 @@
 #include "asset_storage.h"
 #include <engine/components/static_mesh_component.h>
 #include <engine/rendering/vulkan/core.h>
+#include <engine/profiling/cpu_profiler.h>
 
 #include <iostream>
 #include <array>
@@ -265,6 +266,8 @@ AssetStorage::AssetStorage(Vulkan::Core& vkCore)
 
 Vulkan::Image* AssetStorage::LoadCubeMap(const std::string& file, const std::string& cubeMapName)
 {
+  PROFILE_ZONE("AssetStorage::LoadCubeMap");
+
   ktxTexture* texture;
   KTX_error_code result;
   ktx_size_t offset;
@@ -301,6 +304,8 @@ Vulkan::Image* AssetStorage::LoadCubeMap(const std::string& file, const std::str
 
 void AssetStorage::LoadTexture(const std::string& file, const std::string& cubeMapName)
 {
+  PROFILE_ZONE("AssetStorage::LoadTexture");
+
   ktxTexture* texture;
 
   const KTX_error_code result = ktxTexture_CreateFromNamedFile(file.c_str(),
@@ -320,6 +325,8 @@ void AssetStorage::LoadTexture(const std::string& file, const std::string& cubeM
 
 Vulkan::StaticModel* AssetStorage::LoadModel(const std::string& file, const std::string& modelName)
 {
+  PROFILE_ZONE("AssetStorage::LoadModel");
+
   const std::string rootUri = GetFolderPath(file);
 
   tinygltf::Model model;
@@ -346,6 +353,9 @@ Vulkan::StaticModel* AssetStorage::LoadModel(const std::string& file, const std:
   Vulkan::StaticModel staticModel = ProcessModel(model, rootUri);
   staticModels.insert({ modelName, std::move(staticModel) });
 
+  //all model's buffers and textures go to the gpu in a single transfer submit
+  vkCore.GetUploadContext().Submit();
+
   return &staticModels.at(modelName);
 }
 
@@ -389,8 +399,12 @@ Vulkan::StaticModel AssetStorage::ProcessModel(const tinygltf::Model& model, con
     const std::string metallicRoughnessTextureName = rootUri + "/" + model.images[gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index].uri;
     material.metallicRoughnessTexture = &textures.at(metallicRoughnessTextureName);
 
-    const std::string normalTextureName = rootUri + "/" + model.images[gltfMaterial.normalTexture.index].uri;
-    material.normalTexture = &textures.at(normalTextureName);
+    //materials without a normal map are drawn with the interpolated normals
+    if (gltfMaterial.normalTexture.index >= 0)
+    {
+      const std::string normalTextureName = rootUri + "/" + model.images[gltfMaterial.normalTexture.index].uri;
+      material.normalTexture = &textures.at(normalTextureName);
+    }
 
     staticModel.meshes.push_back(
       Vulkan::StaticMesh{
@@ -408,6 +422,8 @@ Vulkan::StaticModel AssetStorage::ProcessModel(const tinygltf::Model& model, con
 
 void AssetStorage::LoadStaticMesh(void* vertexSrc, size_t vertexSrcSize, void* indexSrc, uint32_t indexSrcSize, uint32_t indexCount, const std::string& meshName)
 {
+  PROFILE_ZONE("AssetStorage::LoadStaticMesh");
+
   Vulkan::Buffer vertexBuffer = vkCore.AllocateDeviceBuffer(vertexSrc, vertexSrcSize, vk::BufferUsageFlagBits::eVertexBuffer);
   Vulkan::Buffer indexBuffer = vkCore.AllocateDeviceBuffer(indexSrc, indexSrcSize, vk::BufferUsageFlagBits::eIndexBuffer);
 
@@ -2,16 +2,41 @@
 
 #include <engine/assets/asset_storage.h>
 #include <engine/rendering/renderer.h>
+#include <engine/profiling/cpu_profiler.h>
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include <GLFW/glfw3native.h>
 
-#include <ctime>
+#include <algorithm>
+#include <chrono>
+#include <limits>
 
 Engine::Engine(const Settings& settings)
   : settings(settings)
+  , wnd(nullptr)
+{
+  if (settings.headless.isEnabled)
+  {
+    const auto description = Vulkan::HeadlessDescription()
+      .SetSize(vk::Extent2D{ settings.window.width, settings.window.height });
+
+    vkCore = std::make_unique<Vulkan::Core>(description);
+  }
+  else
+  {
+    CreateWindowCore();
+  }
+
+  assetStorage = std::make_unique<AssetStorage>(*vkCore);
+  inputHandler = std::make_unique<InputHandler>(wnd);
+
+  ecsContext.SetUserData(this);
+  ecsContext.AddLogicSystems({
+    new RenderSystem{&ecsContext,*vkCore}
+  });
+}
+
+void Engine::CreateWindowCore()
 {
   glfwInit();
 
@@ -33,31 +58,83 @@ Engine::Engine(const Settings& settings)
   const char** extensions = glfwGetRequiredInstanceExtensions(&count);
 
   vkCore = std::make_unique<Vulkan::Core>(wnd, extensions, count, vk::Extent2D{ settings.window.width, settings.window.height });
-  assetStorage = std::make_unique<AssetStorage>(*vkCore);
-  inputHandler = std::make_unique<InputHandler>(wnd);
-
-  ecsContext.SetUserData(this);
-  ecsContext.AddLogicSystems({
-    new RenderSystem{&ecsContext,*vkCore}
-  });
 }
 
 Engine::~Engine()
 {
-  glfwDestroyWindow(wnd);
-  glfwTerminate();
+  //assets are destroyed before the core, the gpu mustn't use them anymore
+  vkCore->WaitIdle();
+
+  if (wnd != nullptr)
+  {
+    glfwDestroyWindow(wnd);
+    glfwTerminate();
+  }
 }
 
 void Engine::Start()
 {
+  PROFILE_THREAD_NAME("main");
+
   ecsContext.RunInitializationSystems();
 
-  clock_t t1 = clock();
+  if (settings.headless.isEnabled)
+  {
+    RunHeadless();
+    return;
+  }
+
+  //wall time, clock() counts cpu time of the whole process
+  using Clock = std::chrono::steady_clock;
+
+  Clock::time_point t1 = Clock::now();
   while (!glfwWindowShouldClose(wnd)) {
-    const clock_t t2 = clock();
-    const float dt = static_cast<float>(t2 - t1) / static_cast<float>(CLOCKS_PER_SEC);
+    const Clock::time_point t2 = Clock::now();
+    const float dt = std::chrono::duration<float>(t2 - t1).count();
     t1 = t2;
 
+    PROFILE_ZONE("Engine::UpdateSystems");
     ecsContext.UpdateSystems(dt);
   }
+}
+
+void Engine::RunHeadless()
+{
+  using Clock = std::chrono::steady_clock;
+
+  frameTimeStatistics = FrameTimeStatistics{};
+  frameTimeStatistics.minMilliseconds = std::numeric_limits<float>::max();
+
+  float totalMilliseconds = 0.0f;
+  float dt = 0.0f;
+  const Clock::time_point runStart = Clock::now();
+  for (uint32_t frame = 0; frame < settings.headless.framesCount; ++frame)
+  {
+    const Clock::time_point t1 = Clock::now();
+    {
+      PROFILE_ZONE("Engine::UpdateSystems");
+      ecsContext.UpdateSystems(dt);
+    }
+    const Clock::time_point t2 = Clock::now();
+
+    const float frameMilliseconds = std::chrono::duration<float, std::milli>(t2 - t1).count();
+    dt = frameMilliseconds / 1000.0f;
+
+    totalMilliseconds += frameMilliseconds;
+    frameTimeStatistics.minMilliseconds = std::min(frameTimeStatistics.minMilliseconds, frameMilliseconds);
+    frameTimeStatistics.maxMilliseconds = std::max(frameTimeStatistics.maxMilliseconds, frameMilliseconds);
+    ++frameTimeStatistics.framesCount;
+  }
+
+  //submitted frames are still running, the run ends when the gpu finished them
+  vkCore->WaitIdle();
+  frameTimeStatistics.totalMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - runStart).count();
+
+  if (frameTimeStatistics.framesCount > 0)
+  {
+    frameTimeStatistics.averageMilliseconds = totalMilliseconds / frameTimeStatistics.framesCount;
+    frameTimeStatistics.averageFrameMilliseconds = frameTimeStatistics.totalMilliseconds / frameTimeStatistics.framesCount;
+  }
+  else
+    frameTimeStatistics.minMilliseconds = 0.0f;
 }
\ No newline at end of file
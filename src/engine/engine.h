@@ -25,6 +25,26 @@ public:
       uint32_t width = 800;
       uint32_t height = 800;
     } window;
+
+    struct
+    {
+      //no window is opened, frames are rendered into an offscreen image of the window's size
+      bool isEnabled = false;
+      //frames rendered by Start before it returns
+      uint32_t framesCount = 1000;
+    } headless;
+  };
+
+  struct FrameTimeStatistics
+  {
+    uint32_t framesCount = 0;
+    //cpu time of a frame's recording and submission, including the wait for a free virtual frame
+    float averageMilliseconds = 0.0f;
+    float minMilliseconds = 0.0f;
+    float maxMilliseconds = 0.0f;
+    //wall time from the first frame until the gpu finished the last one
+    float totalMilliseconds = 0.0f;
+    float averageFrameMilliseconds = 0.0f;
   };
 
 public:
@@ -53,7 +73,16 @@ public:
     return settings;
   }
 
+  //frame times of the last headless run
+  inline const FrameTimeStatistics& GetFrameTimeStatistics() const
+  {
+    return frameTimeStatistics;
+  }
+
 private:
+  void CreateWindowCore();
+
+  void RunHeadless();
 
 private:
   Settings settings;
@@ -62,4 +91,5 @@ private:
   std::unique_ptr<Vulkan::Core> vkCore;
   std::unique_ptr<AssetStorage> assetStorage;
   std::unique_ptr<InputHandler> inputHandler;
+  FrameTimeStatistics frameTimeStatistics;
 };
\ No newline at end of file
@@ -90,6 +90,10 @@ void GLFW_CursorPositionCallback(GLFWwindow* window, double xpos, double ypos)
 InputHandler::InputHandler(GLFWwindow* window)
   : window(window)
 {
+  //headless engine has no window, bindings are kept but never triggered
+  if (window == nullptr)
+    return;
+
   glfwSetWindowUserPointer(window, this);
   glfwSetKeyCallback(window, GLFW_KeyCallback);
   glfwSetCursorPosCallback(window, GLFW_CursorPositionCallback);
@@ -97,7 +101,8 @@ InputHandler::InputHandler(GLFWwindow* window)
 
 void InputHandler::PollEvents()
 {
-  glfwPollEvents();
+  if (window != nullptr)
+    glfwPollEvents();
 }
 
 void InputHandler::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -144,5 +149,6 @@ void InputHandler::SetKeyBinding(const std::string& key, float value, KeyInputBi
 
 void InputHandler::DisableCursor()
 {
-  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+  if (window != nullptr)
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 }
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "cpu_profiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+  constexpr uint32_t MAX_ZONES_PER_THREAD = 1 << 16;
+
+  std::chrono::steady_clock::time_point GetProfilerStart()
+  {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return start;
+  }
+
+  void WriteJsonString(std::ofstream& out, const char* str)
+  {
+    out << '"';
+    for (const char* c = str; *c != '\0'; ++c)
+    {
+      if (*c == '"' || *c == '\\')
+        out << '\\';
+      out << *c;
+    }
+    out << '"';
+  }
+}
+
+CpuProfiler& CpuProfiler::Get()
+{
+  static CpuProfiler profiler;
+  return profiler;
+}
+
+uint64_t CpuProfiler::Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - GetProfilerStart()).count();
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::GetThreadBuffer()
+{
+  //registration is the only locked step, the buffer lives as long as the profiler
+  thread_local ThreadBuffer* threadBuffer = nullptr;
+
+  if (threadBuffer == nullptr)
+  {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->events = std::make_unique<CpuZoneEvent[]>(MAX_ZONES_PER_THREAD);
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->threadIndex = static_cast<uint32_t>(buffers.size());
+    buffer->name = "thread_" + std::to_string(buffer->threadIndex);
+    threadBuffer = buffer.get();
+    buffers.push_back(std::move(buffer));
+  }
+
+  return *threadBuffer;
+}
+
+void CpuProfiler::RecordZone(const char* name, uint64_t beginNanoseconds, uint64_t endNanoseconds)
+{
+  ThreadBuffer& buffer = GetThreadBuffer();
+
+  const uint32_t index = buffer.eventsCount.load(std::memory_order_relaxed);
+  if (index == MAX_ZONES_PER_THREAD)
+  {
+    buffer.droppedCount.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  buffer.events[index] = CpuZoneEvent{ name, beginNanoseconds, endNanoseconds };
+
+  //exporter sees the event only after it was written
+  buffer.eventsCount.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::SetThreadName(const std::string& name)
+{
+  ThreadBuffer& buffer = GetThreadBuffer();
+
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  buffer.name = name;
+}
+
+void CpuProfiler::ExportChromeTrace(const std::string& path) const
+{
+  std::ofstream out(path, std::ios::trunc);
+  if (!out)
+    throw std::runtime_error("CpuProfiler::ExportChromeTrace: failed to open " + path);
+
+  std::lock_guard<std::mutex> lock(buffersMutex);
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  bool isFirst = true;
+  auto separate = [&]()
+  {
+    if (!isFirst)
+      out << ",\n";
+    isFirst = false;
+  };
+
+  for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+  {
+    separate();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadIndex << ",\"args\":{\"name\":";
+    WriteJsonString(out, buffer->name.c_str());
+    out << "}}";
+
+    const uint32_t eventsCount = buffer->eventsCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < eventsCount; ++i)
+    {
+      const CpuZoneEvent& e = buffer->events[i];
+
+      //trace timestamps are in microseconds
+      separate();
+      out << "{\"name\":";
+      WriteJsonString(out, e.name);
+      out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadIndex
+          << ",\"ts\":" << (e.beginNanoseconds / 1000) << '.' << (e.beginNanoseconds % 1000) / 100
+          << ",\"dur\":" << ((e.endNanoseconds - e.beginNanoseconds) / 1000) << '.' << ((e.endNanoseconds - e.beginNanoseconds) % 1000) / 100
+          << "}";
+    }
+  }
+
+  out << "]}\n";
+}
+
+void CpuProfiler::Clear()
+{
+  std::lock_guard<std::mutex> lock(buffersMutex);
+
+  for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+  {
+    buffer->eventsCount.store(0, std::memory_order_release);
+    buffer->droppedCount.store(0, std::memory_order_relaxed);
+  }
+}
+
+uint64_t CpuProfiler::GetDroppedZonesCount() const
+{
+  std::lock_guard<std::mutex> lock(buffersMutex);
+
+  uint64_t dropped = 0;
+  for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+    dropped += buffer->droppedCount.load(std::memory_order_relaxed);
+
+  return dropped;
+}
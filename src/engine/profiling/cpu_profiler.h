@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct CpuZoneEvent
+{
+  //zone names are string literals, only the pointer is stored
+  const char* name;
+  uint64_t beginNanoseconds;
+  uint64_t endNanoseconds;
+};
+
+//every thread records its zones into its own buffer, registered once and appended only by that thread,
+//so recording doesn't lock. full buffers drop new zones instead of reallocating under a reader
+class CpuProfiler
+{
+public:
+  static CpuProfiler& Get();
+
+  //nanoseconds since the profiler's start, wall clock
+  static uint64_t Now();
+
+  CpuProfiler(const CpuProfiler&) = delete;
+  CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+  void RecordZone(const char* name, uint64_t beginNanoseconds, uint64_t endNanoseconds);
+
+  void SetThreadName(const std::string& name);
+
+  //recorded zones in the Chrome/Perfetto trace event format,
+  //other threads may keep recording, zones appended during the export are skipped
+  void ExportChromeTrace(const std::string& path) const;
+
+  //threads must not record during the clear
+  void Clear();
+
+  uint64_t GetDroppedZonesCount() const;
+
+private:
+  struct ThreadBuffer
+  {
+    uint32_t threadIndex;
+    std::string name;
+    std::unique_ptr<CpuZoneEvent[]> events;
+    std::atomic<uint32_t> eventsCount{ 0 };
+    std::atomic<uint64_t> droppedCount{ 0 };
+  };
+
+  CpuProfiler() = default;
+
+  ThreadBuffer& GetThreadBuffer();
+
+private:
+  mutable std::mutex buffersMutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+class CpuZone
+{
+public:
+  CpuZone(const char* name)
+    : name(name)
+    , beginNanoseconds(CpuProfiler::Now())
+  {
+  }
+
+  ~CpuZone()
+  {
+    CpuProfiler::Get().RecordZone(name, beginNanoseconds, CpuProfiler::Now());
+  }
+
+  CpuZone(const CpuZone&) = delete;
+  CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+  const char* name;
+  uint64_t beginNanoseconds;
+};
+
+#define CPU_PROFILER_CONCAT_IMPL(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_IMPL(a, b)
+
+//zones are compiled out without ENGINE_PROFILING
+#if defined(ENGINE_PROFILING)
+  #define PROFILE_ZONE(name) CpuZone CPU_PROFILER_CONCAT(cpuZone, __LINE__){ name }
+  #define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+  #define PROFILE_THREAD_NAME(name) CpuProfiler::Get().SetThreadName(name)
+#else
+  #define PROFILE_ZONE(name)
+  #define PROFILE_FUNCTION()
+  #define PROFILE_THREAD_NAME(name)
+#endif
@@ -8,7 +8,7 @@
 
 namespace
 {
-  Vulkan::VertexInputDeclaration GetImGuiVID()
+  Vulkan::VertexInputDeclaration CreateImGuiVID()
   {
     Vulkan::VertexInputDeclaration vid;
 
@@ -21,6 +21,13 @@ namespace
     return vid;
   }
 
+  //built once, copies keep the interned id of the pipeline keys
+  const Vulkan::VertexInputDeclaration& GetImGuiVID()
+  {
+    static const Vulkan::VertexInputDeclaration vid = CreateImGuiVID();
+    return vid;
+  }
+
   struct ImGuiConstants
   {
     glm::vec2 scale;
@@ -50,7 +57,6 @@ namespace GUI
 {
   ImGuiBackend::ImGuiBackend(GLFWwindow* wnd, Vulkan::Core& vkCore)
     : vkCore(vkCore)
-    , iFrame(0)
   {
     //imgui shaders
     auto vertexShader = vkCore.CreateShader(Vulkan::ReadFile("../data/shaders/spirv/imgui/shader.vert.spv"));
@@ -68,7 +74,7 @@ namespace GUI
     io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
     fontTexture = vkCore.Allocate2DImage((void*)pixels, width * height * 4, vk::Format::eR8G8B8A8Unorm, { (uint32_t)width, (uint32_t)height }, vk::ImageUsageFlagBits::eSampled);
 
-    frameResources.resize(vkCore.GetSwapchainImagesCount());
+    frameResources.resize(vkCore.GetFramesInFlightCount());
   }
 
   std::tuple<Vulkan::Buffer, Vulkan::Buffer, size_t> ImGuiBackend::GatherDrawBuffers(const ImDrawData* drawData)
@@ -109,7 +115,8 @@ namespace GUI
     if (drawData == nullptr || drawData->TotalVtxCount <= 0)
       return;
 
-    FrameResources& fResources = frameResources[iFrame % frameResources.size()];
+    //buffers of the frame which used this slot before are free once the core began the frame
+    FrameResources& fResources = frameResources[vkCore.GetFrameNumber() % frameResources.size()];
 
     auto [vertices, indices, vertexCount] = GatherDrawBuffers(drawData);
 
@@ -125,8 +132,7 @@ namespace GUI
     ImGuiConstants constants = GetImGuiScaleTranslate(drawData);
     uniforms->SetUniformBuffer("Constants", &constants);
 
-    std::vector<vk::DescriptorSet> descriptorSets = uniforms->GetUpdatedDescriptorSets();
-    ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+    ctx.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, uniforms->GetUpdatedDescriptorSets(), uniforms->GetDynamicOffsets());
 
     vk::DeviceSize offset = 0;
     ctx.commandBuffer.bindVertexBuffers(0, 1, &fResources.vertexBuffer.GetBuffer(), &offset);
@@ -146,7 +152,5 @@ namespace GUI
       indexOffset += cmdList->IdxBuffer.size();
       vertexOffset += cmdList->VtxBuffer.size();
     }
-
-    ++iFrame;
   }
 }
\ No newline at end of file
@@ -47,6 +47,5 @@ namespace GUI
     std::vector<FrameResources> frameResources;
 
     std::function<void()> savedRenderCallback;
-    uint64_t iFrame;
   };
 }
@@ -7,19 +7,18 @@
 
 #include <ecs/Context.h>
 
+#include <algorithm>
+
 namespace
 {
-  struct PerStaticMeshResource
+  struct PerFrameResource
   {
     glm::mat4 projection;
     glm::mat4 view;
-    glm::mat4 model;
   };
 
-  struct SkyboxPerFrameResource
+  struct PerDrawResource
   {
-    glm::mat4 projection;
-    glm::mat4 view;
     glm::mat4 model;
   };
 }
@@ -44,6 +43,12 @@ RenderSystem::RenderSystem(Context* ctx, Vulkan::Core& vkCore)
     deferredLightProgram = std::make_unique<Vulkan::ShaderProgram>(vkCore, std::move(vertexShader), std::move(fragmentShader));
   }
 
+  {
+    Vulkan::Shader vertexShader = vkCore.CreateShader(Vulkan::ReadFile("../data/shaders/spirv/deferred_light.vert.spv"));
+    Vulkan::Shader fragmentShader = vkCore.CreateShader(Vulkan::ReadFile("../data/shaders/spirv/present.frag.spv"));
+    presentProgram = std::make_unique<Vulkan::ShaderProgram>(vkCore, std::move(vertexShader), std::move(fragmentShader));
+  }
+
   {
     Vulkan::Shader vertexShader = vkCore.CreateShader(Vulkan::ReadFile("../data/shaders/spirv/sky_box.vert.spv"));
     Vulkan::Shader fragmentShader = vkCore.CreateShader(Vulkan::ReadFile("../data/shaders/spirv/sky_box.frag.spv"));
@@ -62,6 +67,7 @@ void RenderSystem::Update(const double dt)
   Vulkan::RenderGraph* rg = vkCore.BeginFrame();
   RenderGBuffer(camera, rg);
   RenderLight(camera, rg);
+  RenderPresent(rg);
 
   vkCore.EndFrame();
 }
@@ -69,7 +75,21 @@ void RenderSystem::Update(const double dt)
 
 void RenderSystem::RenderGBuffer(CameraComponent* camera, Vulkan::RenderGraph* rg)
 {
+  staticMeshes.clear();
+  for (Entity* e : staticMeshGroup->GetEntities())
+  {
+    if (e == nullptr)
+      continue;
+
+    for (auto* meshComponent : e->GetComponents<Vulkan::StaticMeshComponent>())
+      staticMeshes.push_back(meshComponent);
+  }
+
+  //skybox is the last item of the draw list
+  const uint32_t drawItemsCount = static_cast<uint32_t>(staticMeshes.size()) + 1;
+
   rg->AddRenderSubpass()
+    .SetName("gbuffer")
     .AddNewOutputColorAttachment("GBUFFER_BaseColor")
     .AddNewOutputColorAttachment("GBUFFER_WorldPosition")
     .AddNewOutputColorAttachment("GBUFFER_WorldNormal")
@@ -77,95 +97,131 @@ void RenderSystem::RenderGBuffer(CameraComponent* camera, Vulkan::RenderGraph* r
     .AddNewOutputColorAttachment("GBUFFER_Roughness")
     .AddNewOutputColorAttachment("GBUFFER_Depth")
     .AddDepthStencilAttachment("depth")
-    .SetRenderCallback([&](Vulkan::FrameContext& context)
+    .SetParallelRenderCallback(drawItemsCount, [this, camera](Vulkan::FrameContext& context, uint32_t firstItem, uint32_t itemsCount)
     {
-      vk::CommandBuffer& commandBuffer = context.commandBuffer;
-      Vulkan::VertexInputDeclaration vid = Vulkan::StaticMeshVertex::GetVID();
+      const uint32_t meshesCount = static_cast<uint32_t>(staticMeshes.size());
+      const uint32_t endItem = firstItem + itemsCount;
 
-      Vulkan::Pipeline* pipeline = context.GetPipeline(*staticMeshShaderGbufferProgram, vid, vk::PrimitiveTopology::eTriangleList, Vulkan::EnableDepthTest, Vulkan::FillMode);
-      Vulkan::UniformsAccessor* uniforms = context.GetUniformsAccessor(*staticMeshShaderGbufferProgram);
+      if (firstItem < meshesCount)
+        RenderStaticMeshes(camera, context, firstItem, std::min(endItem, meshesCount) - firstItem);
 
-      commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline());
+      if (endItem > meshesCount)
+        RenderSkyBox(camera, context);
+    });
+}
+
+void RenderSystem::RenderStaticMeshes(CameraComponent* camera, Vulkan::FrameContext& context, uint32_t firstMesh, uint32_t meshesCount)
+{
+  vk::CommandBuffer& commandBuffer = context.commandBuffer;
+  const Vulkan::VertexInputDeclaration& vid = Vulkan::StaticMeshVertex::GetVID();
+
+  //materials without a normal map use the variant skipping its fetch
+  const Vulkan::ShaderProgram* programs[] = {
+    &staticMeshShaderGbufferProgram->GetVariant({ { "NORMAL_MAPPING", 0 } }),
+    staticMeshShaderGbufferProgram.get()
+  };
+
+  PerFrameResource perFrame;
+  perFrame.projection = camera->GetProjection();
+  perFrame.view = camera->GetView();
+
+  const Vulkan::ShaderProgram* boundProgram = nullptr;
+  Vulkan::Pipeline* pipeline = nullptr;
+  Vulkan::UniformsAccessor* uniforms = nullptr;
 
-      for (Entity* e : staticMeshGroup->GetEntities())
+  for (uint32_t meshIndex = firstMesh; meshIndex < firstMesh + meshesCount; ++meshIndex)
+  {
+    Vulkan::StaticMeshComponent* meshComponent = staticMeshes[meshIndex];
+
+    PerDrawResource perDraw;
+    perDraw.model = meshComponent->transform.GetTransformationMatrix();
+
+    for (int i = 0; i < meshComponent->model->meshes.size(); ++i)
+    {
+      const Vulkan::StaticMesh& mesh = meshComponent->model->meshes[i];
+      const Vulkan::Material& meshMaterial = meshComponent->model->materials[i];
+
+      assert(meshMaterial.colorTexture != nullptr);
+
+      const Vulkan::ShaderProgram* program = programs[meshMaterial.normalTexture != nullptr ? 1 : 0];
+      if (program != boundProgram)
       {
-        if (e == nullptr)
+        //meshes appear once their pipeline is compiled instead of stalling the frame
+        Vulkan::Pipeline* programPipeline = context.TryGetPipeline(*program, vid, vk::PrimitiveTopology::eTriangleList, Vulkan::EnableDepthTest, Vulkan::FillMode);
+        if (programPipeline == nullptr)
           continue;
 
-        for (auto* meshComponent : e->GetComponents<Vulkan::StaticMeshComponent>())
-        {
-          const glm::mat4 model = meshComponent->transform.GetTransformationMatrix();
-          const glm::mat4 view = camera->GetView();
-          const glm::mat4 projection = camera->GetProjection();
-
-          PerStaticMeshResource mvpResource;
-          mvpResource.projection = projection;
-          mvpResource.view = view;
-          mvpResource.model = model;
-
-          uniforms->SetUniformBuffer("PerStaticMeshResource", &mvpResource);
-
-          for (int i = 0; i < meshComponent->model->meshes.size(); ++i)
-          {
-            const Vulkan::StaticMesh& mesh = meshComponent->model->meshes[i];
-            const Vulkan::Material& meshMaterial = meshComponent->model->materials[i];
-
-            assert(meshMaterial.colorTexture != nullptr);
-
-            uniforms->SetSampler2D("BaseColorTexture", *meshMaterial.colorTexture);
-            uniforms->SetSampler2D("NormalTexture", *meshMaterial.normalTexture);
-            uniforms->SetSampler2D("MetallicRoughnessTexture", *meshMaterial.metallicRoughnessTexture);
-            std::vector<vk::DescriptorSet> descriptorSets = uniforms->GetUpdatedDescriptorSets();
-
-            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
-            vk::DeviceSize offset = 0;
-            commandBuffer.bindVertexBuffers(0, 1, &mesh.vertices.GetBuffer(), &offset);
-            commandBuffer.bindVertexBuffers(1, 1, &mesh.tbnVectorsBuffer.GetBuffer(), &offset);
-            commandBuffer.bindIndexBuffer(mesh.indices.GetBuffer(), 0, vk::IndexType::eUint32);
-            commandBuffer.drawIndexed(mesh.indexCount, 1, 0, 0, 0);
-          }
-        }
+        boundProgram = program;
+        pipeline = programPipeline;
+        uniforms = context.GetUniformsAccessor(*program);
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline());
+
+        uniforms->SetUniformBuffer("PerFrame", &perFrame);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), Vulkan::PER_FRAME_SET,
+          uniforms->GetUpdatedDescriptorSets(Vulkan::PER_FRAME_SET, 1), uniforms->GetDynamicOffsets(Vulkan::PER_FRAME_SET, 1));
       }
 
-      //render skybox
-      {
-        Vulkan::SkyBoxComponent* skybox = skyboxGroup->GetFirstNotNullEntity()->GetFirstComponent<Vulkan::SkyBoxComponent>();
-        Vulkan::VertexInputDeclaration vid = Vulkan::SkyBoxVertex::GetVID();
+      uniforms->SetPushConstants(commandBuffer, pipeline->GetLayout(), &perDraw);
 
-        Vulkan::Pipeline* pipeline = context.GetPipeline(*skyBoxShaderProgram, vid, vk::PrimitiveTopology::eTriangleList, Vulkan::EnableDepthTest, Vulkan::FillMode);
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline());
+      //the variant never samples the normal texture, any valid image keeps the set complete
+      uniforms->SetSampler2D("BaseColorTexture", *meshMaterial.colorTexture);
+      uniforms->SetSampler2D("NormalTexture", meshMaterial.normalTexture != nullptr ? *meshMaterial.normalTexture : *meshMaterial.colorTexture);
+      uniforms->SetSampler2D("MetallicRoughnessTexture", *meshMaterial.metallicRoughnessTexture);
+      commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), Vulkan::PER_MATERIAL_SET,
+        uniforms->GetUpdatedDescriptorSets(Vulkan::PER_MATERIAL_SET, 1), uniforms->GetDynamicOffsets(Vulkan::PER_MATERIAL_SET, 1));
+
+      vk::DeviceSize offset = 0;
+      commandBuffer.bindVertexBuffers(0, 1, &mesh.vertices.GetBuffer(), &offset);
+      commandBuffer.bindVertexBuffers(1, 1, &mesh.tbnVectorsBuffer.GetBuffer(), &offset);
+      commandBuffer.bindIndexBuffer(mesh.indices.GetBuffer(), 0, vk::IndexType::eUint32);
+      commandBuffer.drawIndexed(mesh.indexCount, 1, 0, 0, 0);
+    }
+  }
+}
 
-        Vulkan::UniformsAccessor* uniforms = context.GetUniformsAccessor(*skyBoxShaderProgram);
+void RenderSystem::RenderSkyBox(CameraComponent* camera, Vulkan::FrameContext& context)
+{
+  vk::CommandBuffer& commandBuffer = context.commandBuffer;
 
-        SkyboxPerFrameResource perFrameUbo;
-        perFrameUbo.projection = camera->GetProjection();
-        perFrameUbo.view = camera->GetView();
-        perFrameUbo.model = skybox->transform.GetTransformationMatrix();
+  Vulkan::SkyBoxComponent* skybox = skyboxGroup->GetFirstNotNullEntity()->GetFirstComponent<Vulkan::SkyBoxComponent>();
+  const Vulkan::VertexInputDeclaration& vid = Vulkan::SkyBoxVertex::GetVID();
 
-        uniforms->SetUniformBuffer("PerFrame", &perFrameUbo);
-        uniforms->SetSamplerCube("SkyboxTexture", skybox->cubeMap->GetView());
+  Vulkan::Pipeline* pipeline = context.GetPipeline(*skyBoxShaderProgram, vid, vk::PrimitiveTopology::eTriangleList, Vulkan::EnableDepthTest, Vulkan::FillMode);
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline());
 
-        std::vector<vk::DescriptorSet> descriptorSets = uniforms->GetUpdatedDescriptorSets();
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+  Vulkan::UniformsAccessor* uniforms = context.GetUniformsAccessor(*skyBoxShaderProgram);
 
-        vk::DeviceSize offset = 0;
-        commandBuffer.bindVertexBuffers(0, 1, &skybox->skyboxMesh->vertices.GetBuffer(), &offset);
-        commandBuffer.bindIndexBuffer(skybox->skyboxMesh->indices.GetBuffer(), 0, vk::IndexType::eUint32);
-        commandBuffer.drawIndexed(skybox->skyboxMesh->indexCount, 1, 0, 0, 0);
-      }
-    });
+  PerFrameResource perFrame;
+  perFrame.projection = camera->GetProjection();
+  perFrame.view = camera->GetView();
+
+  PerDrawResource perDraw;
+  perDraw.model = skybox->transform.GetTransformationMatrix();
+
+  uniforms->SetUniformBuffer("PerFrame", &perFrame);
+  uniforms->SetSamplerCube("SkyboxTexture", skybox->cubeMap->GetView());
+
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, uniforms->GetUpdatedDescriptorSets(), uniforms->GetDynamicOffsets());
+  uniforms->SetPushConstants(commandBuffer, pipeline->GetLayout(), &perDraw);
+
+  vk::DeviceSize offset = 0;
+  commandBuffer.bindVertexBuffers(0, 1, &skybox->skyboxMesh->vertices.GetBuffer(), &offset);
+  commandBuffer.bindIndexBuffer(skybox->skyboxMesh->indices.GetBuffer(), 0, vk::IndexType::eUint32);
+  commandBuffer.drawIndexed(skybox->skyboxMesh->indexCount, 1, 0, 0, 0);
 }
 
 void RenderSystem::RenderLight(CameraComponent* camera, Vulkan::RenderGraph* rg)
 {
   rg->AddRenderSubpass()
+    .SetName("deferred_light")
     .AddInputAttachment({"GBUFFER_BaseColor"})
     .AddInputAttachment({"GBUFFER_WorldPosition"})
     .AddInputAttachment({"GBUFFER_WorldNormal"})
     .AddInputAttachment({"GBUFFER_Metallic"})
     .AddInputAttachment({"GBUFFER_Roughness"})
     .AddInputAttachment({"GBUFFER_Depth"})
-    .AddExistOutputColorAttachment(BACKBUFFER_RESOURCE_ID)
+    .AddNewOutputColorAttachment("LIGHTING_Color")
     .SetRenderCallback([&](Vulkan::FrameContext& context)
     {
       vk::CommandBuffer& commandBuffer = context.commandBuffer;
@@ -181,10 +237,33 @@ void RenderSystem::RenderLight(CameraComponent* camera, Vulkan::RenderGraph* rg)
       uniforms->SetSubpassInput("MetallicTexture", context.GetImageView("GBUFFER_Metallic"));
       uniforms->SetSubpassInput("RoughnessTexture", context.GetImageView("GBUFFER_Roughness"));
 
-      std::vector<vk::DescriptorSet> descriptorSets = uniforms->GetUpdatedDescriptorSets();
-      commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+      commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, uniforms->GetUpdatedDescriptorSets(), uniforms->GetDynamicOffsets());
 
       vk::DeviceSize offset = 0;
       commandBuffer.draw(4, 1, 0, 0);
     });
 }
+
+void RenderSystem::RenderPresent(Vulkan::RenderGraph* rg)
+{
+  //sampling the lit image closes the gbuffer's render pass, only this pass waits for the swapchain image.
+  //gbuffer and lighting are recorded and submitted before the acquire
+  rg->AddRenderSubpass()
+    .SetName("present")
+    .AddInputSampler("LIGHTING_Color")
+    .AddExistOutputColorAttachment(BACKBUFFER_RESOURCE_ID)
+    .SetRenderCallback([&](Vulkan::FrameContext& context)
+    {
+      vk::CommandBuffer& commandBuffer = context.commandBuffer;
+
+      Vulkan::Pipeline* pipeline = context.GetPipeline(*presentProgram, Vulkan::VertexInputDeclaration{}, vk::PrimitiveTopology::eTriangleStrip, Vulkan::DisableDepthTest, Vulkan::FillMode);
+      Vulkan::UniformsAccessor* uniforms = context.GetUniformsAccessor(*presentProgram);
+
+      commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline());
+
+      uniforms->SetSampler2D("LightingTexture", context.GetImageView("LIGHTING_Color"));
+      commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 0, uniforms->GetUpdatedDescriptorSets(), uniforms->GetDynamicOffsets());
+
+      commandBuffer.draw(4, 1, 0, 0);
+    });
+}
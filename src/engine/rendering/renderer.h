@@ -5,10 +5,12 @@
 #include <ecs/BaseSystems.h>
 
 #include <memory>
+#include <vector>
 
 namespace Vulkan
 {
   class Core;
+  struct StaticMeshComponent;
 }
 
 class Context;
@@ -24,10 +26,12 @@ public:
   virtual void Update(const double dt) override;
 
 private:
-  void RenderStaticMeshes(CameraComponent* camera, Vulkan::Pipeline* pipeline, Vulkan::UniformsAccessor* uniforms, vk::CommandBuffer& commandBuffer);
+  void RenderStaticMeshes(CameraComponent* camera, Vulkan::FrameContext& context, uint32_t firstMesh, uint32_t meshesCount);
+  void RenderSkyBox(CameraComponent* camera, Vulkan::FrameContext& context);
 
   void RenderGBuffer(CameraComponent* camera, Vulkan::RenderGraph* rg);
   void RenderLight(CameraComponent* camera, Vulkan::RenderGraph* rg);
+  void RenderPresent(Vulkan::RenderGraph* rg);
 
 private:
   Vulkan::Core& vkCore;
@@ -36,7 +40,11 @@ private:
   Group* staticMeshGroup;
   Group* skyboxGroup;
 
+  //draw list of the current frame, gathered before the parallel recording
+  std::vector<Vulkan::StaticMeshComponent*> staticMeshes;
+
   std::unique_ptr<Vulkan::ShaderProgram> staticMeshShaderGbufferProgram;
   std::unique_ptr<Vulkan::ShaderProgram> skyBoxShaderProgram;
   std::unique_ptr<Vulkan::ShaderProgram> deferredLightProgram;
+  std::unique_ptr<Vulkan::ShaderProgram> presentProgram;
 };
\ No newline at end of file
@@ -2,11 +2,11 @@
 
 namespace Vulkan
 {
-  Buffer::Buffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, vk::UniqueDeviceMemory&& memory, vk::DeviceSize memorySize)
+  Buffer::Buffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, MemoryAllocation&& memory)
     : logicalDevice(logicalDevice)
-    , buffer(std::move(buffer))
     , memory(std::move(memory))
-    , memorySize(memorySize)
+    , buffer(std::move(buffer))
+    , memorySize(this->memory.GetSize())
   {
     fullBufferUpdateInfo = vk::DescriptorBufferInfo()
       .setBuffer(this->buffer.get())
@@ -14,19 +14,17 @@ namespace Vulkan
       .setRange(VK_WHOLE_SIZE);
   }
 
-  HostBuffer::HostBuffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, vk::UniqueDeviceMemory&& memory, vk::DeviceSize memorySize)
-    : Buffer(logicalDevice, std::move(buffer), std::move(memory), memorySize)
+  HostBuffer::HostBuffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, MemoryAllocation&& memory)
+    : Buffer(logicalDevice, std::move(buffer), std::move(memory))
     , mappedMemory(nullptr)
   {
   }
 
   void HostBuffer::UploadMemory(const void* src, vk::DeviceSize size, vk::DeviceSize offset)
   {
-    mappedMemory = logicalDevice.mapMemory(memory.get(), offset, size);
-
-    std::memcpy(mappedMemory, src, size);
+    if (offset + size > memorySize)
+      throw std::runtime_error("HostBuffer::UploadMemory: out of buffer range.");
 
-    logicalDevice.unmapMemory(memory.get());
-    mappedMemory = nullptr;
+    std::memcpy(static_cast<char*>(memory.GetMappedMemory()) + offset, src, size);
   }
 }
@@ -1,9 +1,10 @@
 #pragma once
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
 #include <memory>
 
+#include "memory_allocator.h"
+
 namespace Vulkan
 {
   class Buffer
@@ -11,7 +12,7 @@ namespace Vulkan
   public:
     Buffer() = default;
 
-    Buffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, vk::UniqueDeviceMemory&& memory, vk::DeviceSize memorySize);
+    Buffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, MemoryAllocation&& memory);
 
     inline vk::Buffer GetBuffer() const
     {
@@ -25,8 +26,8 @@ namespace Vulkan
 
   protected:
     vk::Device logicalDevice;
+    MemoryAllocation memory;
     vk::UniqueBuffer buffer;
-    vk::UniqueDeviceMemory memory;
     vk::DeviceSize memorySize;
 
     vk::DescriptorBufferInfo fullBufferUpdateInfo;
@@ -37,17 +38,17 @@ namespace Vulkan
   public:
     HostBuffer() = default;
 
-    HostBuffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, vk::UniqueDeviceMemory&& memory, vk::DeviceSize memorySize);
+    HostBuffer(vk::Device logicalDevice, vk::UniqueBuffer&& buffer, MemoryAllocation&& memory);
 
+    //the memory block is persistently mapped by the allocator
     inline void* Map()
     {
-      mappedMemory = logicalDevice.mapMemory(memory.get(), 0, memorySize);
+      mappedMemory = memory.GetMappedMemory();
       return mappedMemory;
     }
 
     inline void Unmap()
     {
-      logicalDevice.unmapMemory(memory.get());
       mappedMemory = nullptr;
     }
 
@@ -59,6 +60,6 @@ namespace Vulkan
     }
 
   private:
-    void* mappedMemory;
+    void* mappedMemory = nullptr;
   };
 }
@@ -3,7 +3,6 @@
 #include "enums.h"
 #include "image.h"
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
 
 #include <tuple>
@@ -23,11 +22,13 @@ namespace Vulkan
     vk::AttachmentLoadOp loadOp;
     vk::AttachmentStoreOp storeOp;
     vk::ImageUsageFlags usageFlags;
+    //shares memory with another attachment of the render pass
+    bool mayAlias = false;
 
     inline bool operator<(const ImageAttachment& r) const
     {
-      return std::tie(id, format, type, initialLayout, finalLayout, loadOp, storeOp, usageFlags) <
-        std::tie(r.id, r.format, r.type, r.initialLayout, r.finalLayout, r.loadOp, r.storeOp, r.usageFlags);
+      return std::tie(id, format, type, initialLayout, finalLayout, loadOp, storeOp, usageFlags, mayAlias) <
+        std::tie(r.id, r.format, r.type, r.initialLayout, r.finalLayout, r.loadOp, r.storeOp, r.usageFlags, r.mayAlias);
     }
   };
 
@@ -1,47 +1,149 @@
 #include "core.h"
 
+#include <engine/profiling/cpu_profiler.h>
+
+#include <algorithm>
+#include <cstring>
+
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include <GLFW/glfw3native.h>
 
-namespace Vulkan
+namespace
 {
-  Core::Core(GLFWwindow* window, const char** instanceExtensions, uint32_t instanceExtensionsCount, vk::Extent2D windowSize)
+  constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+  constexpr uint32_t PIPELINE_CACHE_SAVE_PERIOD = 1000;
+  constexpr const char* VALIDATION_LAYER_NAME = "VK_LAYER_KHRONOS_validation";
+  constexpr uint32_t DESCRIPTOR_SETS_PER_PAGE = 256;
+  constexpr uint32_t DESCRIPTOR_CACHE_MAX_SETS = 4096;
+
+  vk::DeviceSize GetTexelSize(vk::Format format)
+  {
+    switch (format)
+    {
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+      return 4;
+    case vk::Format::eR16G16B16A16Sfloat:
+      return 8;
+    case vk::Format::eR32G32B32A32Sfloat:
+      return 16;
+    default:
+      throw std::runtime_error("GetTexelSize: unsupported backbuffer format");
+    }
+  }
+
+  //waits of a single submission, binary semaphores take a zero value
+  struct SubmitWaits
   {
-    HINSTANCE hInstance = GetModuleHandle(NULL);
-    HWND hWnd = glfwGetWin32Window(window);
+    std::array<vk::Semaphore, 3> semaphores;
+    std::array<uint64_t, 3> values;
+    std::array<vk::PipelineStageFlags, 3> stages;
+    uint32_t count = 0;
 
-    std::vector<const char*> validationLayers{ "VK_LAYER_KHRONOS_validation" };
+    void Add(vk::Semaphore semaphore, uint64_t value, vk::PipelineStageFlags stage)
+    {
+      semaphores[count] = semaphore;
+      values[count] = value;
+      stages[count] = stage;
+      ++count;
+    }
+  };
+}
 
-    //physical device
+namespace Vulkan
+{
+  vk::CommandBuffer ThreadFrameResources::GetSecondaryCommandBuffer(vk::Device device)
+  {
+    if (usedSecondaryCmdBuffers == secondaryCmdBuffers.size())
     {
-      const auto appInfo = vk::ApplicationInfo()
-        .setPApplicationName("test app")
-        .setApplicationVersion(VK_MAKE_VERSION(-1, 0, 0))
-        .setPEngineName("test engine")
-        .setEngineVersion(VK_MAKE_VERSION(-1, 0, 0))
-        .setApiVersion(VK_API_VERSION_1_2);
-
-      const auto instanceCreateInfo = vk::InstanceCreateInfo()
-        .setPApplicationInfo(&appInfo)
-        .setEnabledExtensionCount(instanceExtensionsCount)
-        .setPpEnabledExtensionNames(instanceExtensions)
-        .setEnabledLayerCount((uint32_t)validationLayers.size())
-        .setPpEnabledLayerNames(validationLayers.data());
+      const auto allocateInfo = vk::CommandBufferAllocateInfo()
+        .setCommandPool(cmdPool.get())
+        .setCommandBufferCount(1)
+        .setLevel(vk::CommandBufferLevel::eSecondary);
 
-      this->instance = vk::createInstanceUnique(instanceCreateInfo);
+      secondaryCmdBuffers.push_back(std::move(device.allocateCommandBuffersUnique(allocateInfo)[0]));
     }
 
-    this->physicalDevice = GetPhysicalDevice(instance.get());
+    return secondaryCmdBuffers[usedSecondaryCmdBuffers++].get();
+  }
+
+  void ThreadFrameResources::Reset(vk::Device device)
+  {
+    //buffers of the whole pool are reset at once, they stay allocated for the next frames
+    device.resetCommandPool(cmdPool.get(), vk::CommandPoolResetFlags());
+    usedSecondaryCmdBuffers = 0;
+    uniformRing->Reset();
+    uaStorage->Reset();
+    descriptorSetCache->BeginFrame();
+  }
+
+  Core::Core(GLFWwindow* window, const char** instanceExtensions, uint32_t instanceExtensionsCount, vk::Extent2D windowSize, uint32_t framesInFlight)
+  {
+    InitializeInstance(instanceExtensions, instanceExtensionsCount);
 
     //create surface
-    const auto surfaceCreateInfo = vk::Win32SurfaceCreateInfoKHR()
-      .setHwnd(hWnd)
-      .setHinstance(hInstance);
+    VkSurfaceKHR rawSurface;
+    if (glfwCreateWindowSurface(instance.get(), window, nullptr, &rawSurface) != VK_SUCCESS)
+      throw std::runtime_error("Core::Core: failed to create window surface");
+
+    this->surface = vk::UniqueSurfaceKHR{ vk::SurfaceKHR{ rawSurface }, instance.get() };
+
+    InitializeDevice();
+
+    //create swapchain
+    const int swapchainImagesCount = 2;
+    swapchain = std::make_unique<Swapchain>(surface.get(), windowSize, *instance, physicalDevice, *logicalDevice, presentFamilyIndex, graphicsFamilyIndex, vk::PresentModeKHR::eImmediate, swapchainImagesCount, presentQueue);
+
+    InitializeFrames(framesInFlight);
+  }
+
+  Core::Core(const HeadlessDescription& description)
+    : headless(description)
+  {
+    InitializeInstance(nullptr, 0);
+    InitializeDevice();
+    InitializeFrames(description.framesInFlight);
+  }
+
+  Core::~Core()
+  {
+    //frame timeline doesn't cover the presentation and uploads, every queue has to be idle
+    logicalDevice->waitIdle();
+
+    releaseQueue.clear();
+  }
 
-    this->surface = instance->createWin32SurfaceKHRUnique(surfaceCreateInfo);
+  void Core::InitializeInstance(const char** instanceExtensions, uint32_t instanceExtensionsCount)
+  {
+    //validation is skipped on machines without the sdk, e.g. build agents
+    const std::vector<vk::LayerProperties> availableLayers = vk::enumerateInstanceLayerProperties();
+    for (const vk::LayerProperties& layer : availableLayers)
+      if (std::strcmp(layer.layerName, VALIDATION_LAYER_NAME) == 0)
+        validationLayers.push_back(VALIDATION_LAYER_NAME);
+
+    const auto appInfo = vk::ApplicationInfo()
+      .setPApplicationName("test app")
+      .setApplicationVersion(VK_MAKE_VERSION(-1, 0, 0))
+      .setPEngineName("test engine")
+      .setEngineVersion(VK_MAKE_VERSION(-1, 0, 0))
+      .setApiVersion(VK_API_VERSION_1_2);
+
+    const auto instanceCreateInfo = vk::InstanceCreateInfo()
+      .setPApplicationInfo(&appInfo)
+      .setEnabledExtensionCount(instanceExtensionsCount)
+      .setPpEnabledExtensionNames(instanceExtensions)
+      .setEnabledLayerCount((uint32_t)validationLayers.size())
+      .setPpEnabledLayerNames(validationLayers.data());
+
+    this->instance = vk::createInstanceUnique(instanceCreateInfo);
+
+    this->physicalDevice = GetPhysicalDevice(instance.get());
+  }
 
+  void Core::InitializeDevice()
+  {
     //find queue indices
     {
       std::vector<vk::QueueFamilyProperties> queueFamilies = physicalDevice.getQueueFamilyProperties();
@@ -49,27 +151,41 @@ namespace Vulkan
       graphicsFamilyIndex = uint32_t(-1);
       presentFamilyIndex = uint32_t(-1);
       transferFamilyIndex = uint32_t(-1);
+      computeFamilyIndex = uint32_t(-1);
       for (uint32_t familyIndex = 0; familyIndex < queueFamilies.size(); familyIndex++)
       {
         if (queueFamilies[familyIndex].queueFlags & vk::QueueFlagBits::eGraphics && queueFamilies[familyIndex].queueCount > 0 && graphicsFamilyIndex == uint32_t(-1))
           graphicsFamilyIndex = familyIndex;
 
-        if (physicalDevice.getSurfaceSupportKHR(familyIndex, surface.get()) && queueFamilies[familyIndex].queueCount > 0 && presentFamilyIndex == uint32_t(-1))
+        if (surface && physicalDevice.getSurfaceSupportKHR(familyIndex, surface.get()) && queueFamilies[familyIndex].queueCount > 0 && presentFamilyIndex == uint32_t(-1))
           presentFamilyIndex = familyIndex;
 
         if (queueFamilies[familyIndex].queueFlags & vk::QueueFlagBits::eTransfer && queueFamilies[familyIndex].queueCount > 0 && transferFamilyIndex == uint32_t(-1))
-          transferFamilyIndex;
+          transferFamilyIndex = familyIndex;
+
+        //family without graphics runs compute next to the graphics queue
+        const bool isComputeOnly = (queueFamilies[familyIndex].queueFlags & vk::QueueFlagBits::eCompute) && !(queueFamilies[familyIndex].queueFlags & vk::QueueFlagBits::eGraphics);
+        if (isComputeOnly && queueFamilies[familyIndex].queueCount > 0 && computeFamilyIndex == uint32_t(-1))
+          computeFamilyIndex = familyIndex;
       }
+
+      //nothing is presented without a surface
+      if (!surface)
+        presentFamilyIndex = graphicsFamilyIndex;
+
       if (graphicsFamilyIndex == uint32_t(-1) || presentFamilyIndex == uint32_t(-1))
         throw std::runtime_error("Failed to find appropriate queue families");
 
       if (transferFamilyIndex == uint32_t(-1))
         transferFamilyIndex = graphicsFamilyIndex;
+
+      if (computeFamilyIndex == uint32_t(-1))
+        computeFamilyIndex = graphicsFamilyIndex;
     }
 
     //create logical device
     {
-      std::set<uint32_t> uniqueQueueFamilyIndices = { graphicsFamilyIndex, presentFamilyIndex, transferFamilyIndex };
+      std::set<uint32_t> uniqueQueueFamilyIndices = { graphicsFamilyIndex, presentFamilyIndex, transferFamilyIndex, computeFamilyIndex };
 
       std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
       float queuePriority = 1.0f;
@@ -87,12 +203,24 @@ namespace Vulkan
       deviceFeatures.vertexPipelineStoresAndAtomics = true;
 
       std::vector<const char*> deviceExtensions;
-      deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+      if (surface)
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+      //pipeline statistics of the gpu profiler are optional
+      isPipelineStatisticsQuerySupported = physicalDevice.getFeatures().pipelineStatisticsQuery;
+
+      vk::PhysicalDeviceFeatures enabledFeatures = {};
+      enabledFeatures.pipelineStatisticsQuery = isPipelineStatisticsQuerySupported;
+
+      const auto timelineSemaphoreFeatures = vk::PhysicalDeviceTimelineSemaphoreFeatures()
+        .setTimelineSemaphore(true);
 
       const auto deviceCreateInfo = vk::DeviceCreateInfo()
+        .setPNext(&timelineSemaphoreFeatures)
         .setQueueCreateInfoCount(uint32_t(queueCreateInfos.size()))
         .setPQueueCreateInfos(queueCreateInfos.data())
         //.setPEnabledFeatures(&deviceFeatures)
+        .setPEnabledFeatures(&enabledFeatures)
         .setEnabledExtensionCount(uint32_t(deviceExtensions.size()))
         .setPpEnabledExtensionNames(deviceExtensions.data())
         .setEnabledLayerCount((uint32_t)validationLayers.size())
@@ -105,23 +233,33 @@ namespace Vulkan
     this->graphicsQueue = logicalDevice->getQueue(graphicsFamilyIndex, 0);
     this->presentQueue = logicalDevice->getQueue(presentFamilyIndex, 0);
     this->transferQueue = logicalDevice->getQueue(transferFamilyIndex, 0);
+    this->computeQueue = logicalDevice->getQueue(computeFamilyIndex, 0);
 
     //get memory types index
     hostVisibleMemoryIndex = -1;
     deviceLocalMemoryIndex = -1;
+    lazilyAllocatedMemoryIndex = -1;
     vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
     for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
     {
       const vk::MemoryType& memType = memoryProperties.memoryTypes[i];
-      if ((hostVisibleMemoryIndex == -1) && memType.propertyFlags & (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent))
+      const vk::MemoryPropertyFlags hostVisibleFlags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+      if ((hostVisibleMemoryIndex == -1) && (memType.propertyFlags & hostVisibleFlags) == hostVisibleFlags)
       {
         hostVisibleMemoryIndex = i;
       }
 
-      if ((deviceLocalMemoryIndex == -1) && memType.propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)
+      const bool isLazilyAllocated = static_cast<bool>(memType.propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated);
+
+      if ((deviceLocalMemoryIndex == -1) && (memType.propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) && !isLazilyAllocated)
       {
         deviceLocalMemoryIndex = i;
       }
+
+      if ((lazilyAllocatedMemoryIndex == -1) && isLazilyAllocated)
+      {
+        lazilyAllocatedMemoryIndex = i;
+      }
     }
     if (hostVisibleMemoryIndex == -1)
       throw std::runtime_error("No host visible memory heap found");
@@ -129,46 +267,68 @@ namespace Vulkan
     if (deviceLocalMemoryIndex == -1)
       throw std::runtime_error("No device local memory heap found");
 
+    memoryAllocator = std::make_unique<MemoryAllocator>(physicalDevice, logicalDevice.get());
+
+    //create pipeline cache, data of the previous runs is used when it was made by the same device and driver
+    pipelineCache = std::make_unique<PipelineCache>(physicalDevice, logicalDevice.get(), PIPELINE_CACHE_PATH);
+    framesSincePipelineCacheSave = 0;
+
     //create command pool
     const auto cmdPoolCreateInfo = vk::CommandPoolCreateInfo()
       .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
       .setQueueFamilyIndex(graphicsFamilyIndex);
     cmdPool = logicalDevice->createCommandPoolUnique(cmdPoolCreateInfo);
 
-    //create swapchain
-    const int swapchainImagesCount = 2;
-    swapchain = std::make_unique<Swapchain>(surface.get(), windowSize, *instance, physicalDevice, *logicalDevice, presentFamilyIndex, graphicsFamilyIndex, vk::PresentModeKHR::eImmediate, swapchainImagesCount, presentQueue);
-
-    //create descriptor pool
-    std::vector<vk::DescriptorPoolSize> dscPoolSizes;
-    dscPoolSizes.push_back(
-      vk::DescriptorPoolSize()
-      .setDescriptorCount(1000)
-      .setType(vk::DescriptorType::eUniformBuffer)
-    );
+    const auto computeCmdPoolCreateInfo = vk::CommandPoolCreateInfo()
+      .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+      .setQueueFamilyIndex(computeFamilyIndex);
+    computeCmdPool = logicalDevice->createCommandPoolUnique(computeCmdPoolCreateInfo);
 
-    const auto dscPoolCreateInfo = vk::DescriptorPoolCreateInfo()
-      .setMaxSets(1000)
-      .setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
-      .setPoolSizeCount(dscPoolSizes.size())
-      .setPPoolSizes(dscPoolSizes.data());
+    //create upload context
+    const vk::DeviceSize stagingSize = 64 * 1024 * 1024;
+    uploadContext = std::make_unique<UploadContext>(*this, transferQueue, transferFamilyIndex, graphicsFamilyIndex, stagingSize);
 
-    descriptorPool = logicalDevice->createDescriptorPoolUnique(dscPoolCreateInfo);
+    //create workers for the parallel recording, main thread waits for them
+    const uint32_t workersCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    workerPool = std::make_unique<WorkerPool>("record", workersCount);
 
     //create storages
     fbStorage = std::make_unique<FramebufferStorage>(logicalDevice.get());
     rpStorage = std::make_unique<RenderPassStorage>(*this);
     ppStorage = std::make_unique<PipelineStorage>(*this);
+    attachmentPool = std::make_unique<TransientAttachmentPool>(*this);
+  }
 
+  void Core::InitializeFrames(uint32_t framesCount)
+  {
     //create virtual frames without swapchain image
+    const vk::DeviceSize uniformRingPageSize = 4 * 1024 * 1024;
+    const vk::DeviceSize uniformAlignment = physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+
+    const uint32_t workersCount = workerPool->GetWorkersCount();
+
+    if (framesCount == 0)
+      throw std::runtime_error("Core::InitializeFrames: at least one frame in flight is required");
+
+    gpuProfiler = std::make_unique<GpuProfiler>(physicalDevice, logicalDevice.get(), graphicsFamilyIndex, computeFamilyIndex, framesCount, isPipelineStatisticsQuerySupported);
+
+    const auto semaphoreTypeCreateInfo = vk::SemaphoreTypeCreateInfo()
+      .setSemaphoreType(vk::SemaphoreType::eTimeline)
+      .setInitialValue(0);
+    frameTimeline = logicalDevice->createSemaphoreUnique(vk::SemaphoreCreateInfo().setPNext(&semaphoreTypeCreateInfo));
+
+    frameNumber = 0;
     currentVirtualFrame = 0;
-    for (int i = 0; i < swapchainImagesCount; ++i)
+    for (uint32_t i = 0; i < framesCount; ++i)
     {
       FrameResources fr;
-      fr.cmdBufferFreeToUse = logicalDevice->createFenceUnique(vk::FenceCreateInfo().setFlags(vk::FenceCreateFlagBits::eSignaled));
       fr.swapchainImageAckquired = logicalDevice->createSemaphoreUnique(vk::SemaphoreCreateInfo());
       fr.renderingFinished = logicalDevice->createSemaphoreUnique(vk::SemaphoreCreateInfo());
-      fr.uaStorage = std::make_unique<UniformsAccessorStorage>(*this, descriptorPool.get());
+      fr.computeFinished = logicalDevice->createSemaphoreUnique(vk::SemaphoreCreateInfo());
+      fr.uniformRing = std::make_unique<UniformRing>(*this, uniformRingPageSize, uniformAlignment);
+      fr.descriptorAllocator = std::make_unique<DescriptorAllocator>(logicalDevice.get(), DESCRIPTOR_SETS_PER_PAGE);
+      fr.descriptorSetCache = std::make_unique<DescriptorSetCache>(logicalDevice.get(), fr.descriptorAllocator.get(), DESCRIPTOR_CACHE_MAX_SETS);
+      fr.uaStorage = std::make_unique<UniformsAccessorStorage>(*this, fr.descriptorSetCache.get(), fr.uniformRing.get());
       fr.renderGraph = std::make_unique<RenderGraph>(*this);
 
       const auto cmdBufferAllocateInfo = vk::CommandBufferAllocateInfo()
@@ -177,10 +337,48 @@ namespace Vulkan
         .setLevel(vk::CommandBufferLevel::ePrimary);
 
       fr.cmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
+      fr.uploadAcquireCmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
+      fr.graphicsAfterComputeCmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
+      fr.backbufferCmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
+
+      const auto computeCmdBufferAllocateInfo = vk::CommandBufferAllocateInfo()
+        .setCommandPool(computeCmdPool.get())
+        .setCommandBufferCount(1)
+        .setLevel(vk::CommandBufferLevel::ePrimary);
+
+      fr.computeCmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(computeCmdBufferAllocateInfo)[0]);
+
+      for (uint32_t worker = 0; worker < workersCount; ++worker)
+      {
+        ThreadFrameResources tr;
+
+        const auto threadCmdPoolCreateInfo = vk::CommandPoolCreateInfo()
+          .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+          .setQueueFamilyIndex(graphicsFamilyIndex);
+
+        tr.cmdPool = logicalDevice->createCommandPoolUnique(threadCmdPoolCreateInfo);
+        tr.descriptorAllocator = std::make_unique<DescriptorAllocator>(logicalDevice.get(), DESCRIPTOR_SETS_PER_PAGE);
+        tr.descriptorSetCache = std::make_unique<DescriptorSetCache>(logicalDevice.get(), tr.descriptorAllocator.get(), DESCRIPTOR_CACHE_MAX_SETS);
+        tr.uniformRing = std::make_unique<UniformRing>(*this, uniformRingPageSize, uniformAlignment);
+        tr.uaStorage = std::make_unique<UniformsAccessorStorage>(*this, tr.descriptorSetCache.get(), tr.uniformRing.get());
+
+        fr.threadResources.push_back(std::move(tr));
+      }
+
+      if (IsHeadless())
+      {
+        fr.offscreenImage = Allocate2DImage(headless.format, headless.size, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc);
+
+        if (headless.isReadbackEnabled)
+        {
+          const vk::DeviceSize readbackSize = vk::DeviceSize{ headless.size.width } * headless.size.height * GetTexelSize(headless.format);
+          fr.readbackBuffer = AllocateHostBuffer(readbackSize, vk::BufferUsageFlagBits::eTransferDst);
+          fr.readbackCmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
+        }
+      }
 
       frameResources.push_back(std::move(fr));
     }
-
   }
 
   FramebufferStorage& Core::GetFramebufferStorage()
@@ -198,6 +396,31 @@ namespace Vulkan
     return *ppStorage;
   }
 
+  PipelineCache& Core::GetPipelineCache()
+  {
+    return *pipelineCache;
+  }
+
+  UploadContext& Core::GetUploadContext()
+  {
+    return *uploadContext;
+  }
+
+  WorkerPool& Core::GetWorkerPool()
+  {
+    return *workerPool;
+  }
+
+  GpuProfiler& Core::GetGpuProfiler()
+  {
+    return *gpuProfiler;
+  }
+
+  TransientAttachmentPool& Core::GetTransientAttachmentPool()
+  {
+    return *attachmentPool;
+  }
+
   vk::Device Core::GetDebugDevice()
   {
     return logicalDevice.get();
@@ -205,7 +428,7 @@ namespace Vulkan
 
   vk::Format Core::GetDebugSurfaceFormat()
   {
-    return swapchain->GetImageFormat();
+    return swapchain ? swapchain->GetImageFormat() : headless.format;
   }
 
   Shader Core::CreateShader(const std::vector<uint32_t>& byteCode)
@@ -215,23 +438,48 @@ namespace Vulkan
 
   RenderGraph* Core::BeginFrame()
   {
-    currentVirtualFrame = (currentVirtualFrame + 1) % frameResources.size();
+    PROFILE_ZONE("Core::BeginFrame");
+
+    ++frameNumber;
+    currentVirtualFrame = static_cast<uint32_t>(frameNumber % frameResources.size());
     FrameResources& fr = frameResources[currentVirtualFrame];
 
-    logicalDevice->waitForFences(1, &fr.cmdBufferFreeToUse.get(), true, -1);
-    logicalDevice->resetFences(1, &fr.cmdBufferFreeToUse.get());
-    fr.cmdBuffer->reset(vk::CommandBufferResetFlags());
+    //previous frame of this slot has to be finished, later frames may still be in flight
+    WaitFrame(fr.frameNumber);
+    fr.frameNumber = frameNumber;
 
-    fr.swapchainImage = swapchain->AcquireNextImage(fr.swapchainImageAckquired.get());
+    const uint64_t completedFrame = GetCompletedFrameNumber();
+    while (!releaseQueue.empty() && releaseQueue.front().first <= completedFrame)
+      releaseQueue.pop_front();
+
+    gpuProfiler->BeginFrame(currentVirtualFrame);
+    fr.cmdBuffer->reset(vk::CommandBufferResetFlags());
+    fr.uploadAcquireCmdBuffer->reset(vk::CommandBufferResetFlags());
+    fr.computeCmdBuffer->reset(vk::CommandBufferResetFlags());
+    fr.graphicsAfterComputeCmdBuffer->reset(vk::CommandBufferResetFlags());
+    fr.backbufferCmdBuffer->reset(vk::CommandBufferResetFlags());
+    if (fr.readbackCmdBuffer)
+      fr.readbackCmdBuffer->reset(vk::CommandBufferResetFlags());
+
+    //swapchain image is acquired in EndFrame, right before the first pass using it
+    fr.swapchainImage = swapchain ? ImageView{} : fr.offscreenImage.GetView();
+    fr.uniformRing->Reset();
     fr.uaStorage->Reset();
+    fr.descriptorSetCache->BeginFrame();
+    for (ThreadFrameResources& tr : fr.threadResources)
+      tr.Reset(logicalDevice.get());
     fr.renderGraph->Reset();
+    attachmentPool->BeginFrame();
 
     const auto bfd = BackbufferDescription()
-      .SetFormat(swapchain->GetImageFormat())
-      .SetSize(swapchain->GetSurfaceSize());
+      .SetFormat(GetDebugSurfaceFormat())
+      .SetSize(swapchain ? swapchain->GetSurfaceSize() : headless.size);
 
     fr.renderGraph->SetCommandBuffer(fr.cmdBuffer.get());
+    fr.renderGraph->SetAsyncComputeCommandBuffers(fr.computeCmdBuffer.get(), fr.graphicsAfterComputeCmdBuffer.get());
+    fr.renderGraph->SetBackbufferCommandBuffer(fr.backbufferCmdBuffer.get());
     fr.renderGraph->SetUniformsAccessorStorage(fr.uaStorage.get());
+    fr.renderGraph->SetThreadResources(&fr.threadResources);
     fr.renderGraph->SetBackbufferDescription(bfd);
 
     ImageAttachment backbufferAttachment;
@@ -240,7 +488,7 @@ namespace Vulkan
     backbufferAttachment.format = bfd.format;
     backbufferAttachment.type = ImageType::Present;
     backbufferAttachment.initialLayout = vk::ImageLayout::eUndefined;
-    backbufferAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+    backbufferAttachment.finalLayout = swapchain ? vk::ImageLayout::ePresentSrcKHR : vk::ImageLayout::eTransferSrcOptimal;
     backbufferAttachment.loadOp = vk::AttachmentLoadOp::eClear;
     backbufferAttachment.storeOp = vk::AttachmentStoreOp::eStore;
     backbufferAttachment.usageFlags = vk::ImageUsageFlagBits::eColorAttachment;
@@ -252,101 +500,382 @@ namespace Vulkan
 
   void Core::EndFrame()
   {
+    PROFILE_ZONE("Core::EndFrame");
+
     FrameResources& fr = frameResources[currentVirtualFrame];
 
     fr.renderGraph->Compile();
     fr.renderGraph->Execute();
 
-    vk::PipelineStageFlags stageFlags[]{
-      vk::PipelineStageFlagBits::eAllGraphics
+    //resources uploaded this frame are waited on the gpu only
+    const UploadTicket uploadTicket = uploadContext->Submit();
+    const vk::Semaphore uploadSemaphore = uploadContext->GetTimelineSemaphore();
+    const vk::PipelineStageFlags uploadWaitStages = vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader |
+      vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer;
+
+    //images uploaded on another family are acquired by the graphics queue before anything reads them
+    fr.uploadAcquireCmdBuffer->begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    const bool hasUploadAcquires = uploadContext->RecordAcquireBarriers(fr.uploadAcquireCmdBuffer.get());
+    fr.uploadAcquireCmdBuffer->end();
+
+    const vk::CommandBuffer earlyCmdBuffers[]{
+      fr.uploadAcquireCmdBuffer.get(),
+      fr.cmdBuffer.get()
     };
+    const uint32_t firstEarlyCmdBuffer = hasUploadAcquires ? 0 : 1;
+
+    //work which doesn't need the backbuffer runs while the presentation engine still holds it
+    if (fr.renderGraph->UsesAsyncCompute())
+    {
+      const vk::PipelineStageFlags computeWaitStage = vk::PipelineStageFlagBits::eComputeShader;
+
+      const auto computeTimelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+        .setWaitSemaphoreValueCount(1)
+        .setPWaitSemaphoreValues(&uploadTicket);
+
+      const auto computeSubmitInfo = vk::SubmitInfo()
+        .setPNext(&computeTimelineSubmitInfo)
+        .setCommandBufferCount(1)
+        .setPCommandBuffers(&fr.computeCmdBuffer.get())
+        .setWaitSemaphoreCount(1)
+        .setPWaitSemaphores(&uploadSemaphore)
+        .setPWaitDstStageMask(&computeWaitStage)
+        .setSignalSemaphoreCount(1)
+        .setPSignalSemaphores(&fr.computeFinished.get());
+
+      computeQueue.submit(1, &computeSubmitInfo, vk::Fence{});
+    }
+
+    //graphics work independent from the compute overlaps with it, the rest waits for its results
+    const vk::PipelineStageFlags computeWaitStages = fr.renderGraph->GetAsyncComputeWaitStages();
+    const bool usesGraphicsAfterCompute = fr.renderGraph->UsesGraphicsAfterCompute();
+
+    SubmitWaits earlyWaits;
+    earlyWaits.Add(uploadSemaphore, uploadTicket, uploadWaitStages);
+
+    SubmitWaits afterComputeWaits;
+    afterComputeWaits.Add(uploadSemaphore, uploadTicket, uploadWaitStages);
+    afterComputeWaits.Add(fr.computeFinished.get(), 0, computeWaitStages);
+
+    const auto earlyTimelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+      .setWaitSemaphoreValueCount(earlyWaits.count)
+      .setPWaitSemaphoreValues(earlyWaits.values.data());
+
+    const auto afterComputeTimelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+      .setWaitSemaphoreValueCount(afterComputeWaits.count)
+      .setPWaitSemaphoreValues(afterComputeWaits.values.data());
+
+    const vk::SubmitInfo earlySubmitInfo[] = {
+      vk::SubmitInfo()
+      .setPNext(&earlyTimelineSubmitInfo)
+      .setCommandBufferCount(2 - firstEarlyCmdBuffer)
+      .setPCommandBuffers(earlyCmdBuffers + firstEarlyCmdBuffer)
+      .setWaitSemaphoreCount(earlyWaits.count)
+      .setPWaitSemaphores(earlyWaits.semaphores.data())
+      .setPWaitDstStageMask(earlyWaits.stages.data()),
 
-    const vk::SubmitInfo submitInfo[] = {
       vk::SubmitInfo()
+      .setPNext(&afterComputeTimelineSubmitInfo)
+      .setCommandBufferCount(1)
+      .setPCommandBuffers(&fr.graphicsAfterComputeCmdBuffer.get())
+      .setWaitSemaphoreCount(afterComputeWaits.count)
+      .setPWaitSemaphores(afterComputeWaits.semaphores.data())
+      .setPWaitDstStageMask(afterComputeWaits.stages.data())
+    };
+
+    graphicsQueue.submit(usesGraphicsAfterCompute ? 2 : 1, earlySubmitInfo, vk::Fence{});
+
+    //the only place the frame may block on the presentation engine
+    if (swapchain)
+    {
+      PROFILE_ZONE("Core::AcquireNextImage");
+      fr.swapchainImage = swapchain->AcquireNextImage(fr.swapchainImageAckquired.get());
+    }
+
+    fr.renderGraph->SetBackbufferView(fr.swapchainImage);
+    fr.renderGraph->ExecuteBackbufferPasses();
+
+    //work before the backbuffer's first use isn't held back by the presentation
+    const vk::PipelineStageFlags backbufferWaitStages = fr.renderGraph->GetBackbufferWaitStages();
+
+    SubmitWaits backbufferWaits;
+    backbufferWaits.Add(uploadSemaphore, uploadTicket, uploadWaitStages);
+    if (swapchain)
+      backbufferWaits.Add(fr.swapchainImageAckquired.get(), 0, backbufferWaitStages ? backbufferWaitStages : vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eColorAttachmentOutput });
+    if (fr.renderGraph->UsesAsyncCompute() && !usesGraphicsAfterCompute)
+      backbufferWaits.Add(fr.computeFinished.get(), 0, computeWaitStages);
+
+    vk::Semaphore signalSemaphores[]{
+      fr.renderingFinished.get(),
+      frameTimeline.get()
+    };
+
+    const uint64_t signalValues[]{
+      0,
+      frameNumber
+    };
+
+    //headless frame has nothing to present,
+    //readback submission signals the frame timeline when it is used
+    const uint32_t firstSignal = swapchain ? 0 : 1;
+    const uint32_t signalsCount = (fr.readbackCmdBuffer ? 1 : 2) - firstSignal;
+
+    const auto backbufferTimelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+      .setWaitSemaphoreValueCount(backbufferWaits.count)
+      .setPWaitSemaphoreValues(backbufferWaits.values.data())
+      .setSignalSemaphoreValueCount(signalsCount)
+      .setPSignalSemaphoreValues(signalValues + firstSignal);
+
+    const auto backbufferSubmitInfo = vk::SubmitInfo()
+      .setPNext(&backbufferTimelineSubmitInfo)
       .setCommandBufferCount(1)
-      .setPCommandBuffers(&fr.cmdBuffer.get())
-      .setWaitSemaphoreCount(1)
-      .setPWaitSemaphores(&fr.swapchainImageAckquired.get())
-      .setPWaitDstStageMask(stageFlags)
-      .setSignalSemaphoreCount(1)
-      .setPSignalSemaphores(&fr.renderingFinished.get())
+      .setPCommandBuffers(&fr.backbufferCmdBuffer.get())
+      .setWaitSemaphoreCount(backbufferWaits.count)
+      .setPWaitSemaphores(backbufferWaits.semaphores.data())
+      .setPWaitDstStageMask(backbufferWaits.stages.data())
+      .setSignalSemaphoreCount(signalsCount)
+      .setPSignalSemaphores(signalSemaphores + firstSignal);
+
+    graphicsQueue.submit(1, &backbufferSubmitInfo, vk::Fence{});
+
+    if (fr.readbackCmdBuffer)
+    {
+      //copy is ordered after the graph's work by the submission order on the same queue
+      RecordBackbufferReadback(fr);
+
+      const auto readbackTimelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+        .setSignalSemaphoreValueCount(1)
+        .setPSignalSemaphoreValues(&frameNumber);
+
+      const auto readbackSubmitInfo = vk::SubmitInfo()
+        .setPNext(&readbackTimelineSubmitInfo)
+        .setCommandBufferCount(1)
+        .setPCommandBuffers(&fr.readbackCmdBuffer.get())
+        .setSignalSemaphoreCount(1)
+        .setPSignalSemaphores(&frameTimeline.get());
+
+      graphicsQueue.submit(1, &readbackSubmitInfo, vk::Fence{});
+    }
+
+    if (swapchain)
+      swapchain->PresentImage(fr.renderingFinished.get());
+
+    //pipelines created in the middle of a run survive a crash
+    if (++framesSincePipelineCacheSave >= PIPELINE_CACHE_SAVE_PERIOD)
+    {
+      framesSincePipelineCacheSave = 0;
+      pipelineCache->SaveIfChanged();
+    }
+  }
+
+  void Core::RecordBackbufferReadback(FrameResources& fr)
+  {
+    const vk::CommandBuffer cmd = fr.readbackCmdBuffer.get();
+    const ImageView backbuffer = fr.offscreenImage.GetView();
+
+    cmd.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    //graph has already moved the backbuffer to the transfer layout, only its writes are waited here
+    const auto imageBarrier = vk::ImageMemoryBarrier()
+      .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eShaderWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+      .setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+      .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(backbuffer.GetImage())
+      .setSubresourceRange(backbuffer.GetSubresourceRange());
+
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{}, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    const auto copyRegion = vk::BufferImageCopy()
+      .setBufferOffset(0)
+      .setBufferRowLength(0)
+      .setBufferImageHeight(0)
+      .setImageSubresource(
+        vk::ImageSubresourceLayers()
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1)
+        .setMipLevel(0)
+      )
+      .setImageOffset(vk::Offset3D{ 0,0,0 })
+      .setImageExtent(vk::Extent3D{ headless.size.width, headless.size.height, 1 });
+
+    cmd.copyImageToBuffer(backbuffer.GetImage(), vk::ImageLayout::eTransferSrcOptimal, fr.readbackBuffer.GetBuffer(), 1, &copyRegion);
+
+    const auto hostBarrier = vk::MemoryBarrier()
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eHostRead);
+
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags{}, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+    cmd.end();
+  }
+
+  std::vector<uint8_t> Core::ReadBackbuffer()
+  {
+    if (!headless.isReadbackEnabled || swapchain)
+      throw std::runtime_error("Core::ReadBackbuffer: readback is enabled only for the headless core");
+
+    FrameResources& fr = frameResources[currentVirtualFrame];
+
+    WaitFrame(fr.frameNumber);
+
+    const size_t size = static_cast<size_t>(vk::DeviceSize{ headless.size.width } * headless.size.height * GetTexelSize(headless.format));
+    const uint8_t* texels = reinterpret_cast<const uint8_t*>(fr.readbackBuffer.Map());
+
+    std::vector<uint8_t> result(texels, texels + size);
+    fr.readbackBuffer.Unmap();
+
+    return result;
+  }
+
+  DescriptorStatistics Core::GetDescriptorStatistics() const
+  {
+    DescriptorStatistics total;
+
+    auto add = [&](const DescriptorAllocator& allocator)
+    {
+      const DescriptorStatistics s = allocator.GetStatistics();
+      total.pagesCount += s.pagesCount;
+      total.setsCount += s.setsCount;
+      total.peakSetsCount += s.peakSetsCount;
+      total.pageOverflowsCount += s.pageOverflowsCount;
+      for (const auto& [type, count] : s.descriptorsCount)
+        total.descriptorsCount[type] += count;
     };
 
-    //in fact, we are only waiting when swapchain image will be free to use, it is not about the cmd buffer itself!
-    graphicsQueue.submit(1, submitInfo, fr.cmdBufferFreeToUse.get());
+    for (const FrameResources& fr : frameResources)
+    {
+      add(*fr.descriptorAllocator);
+      for (const ThreadFrameResources& tr : fr.threadResources)
+        add(*tr.descriptorAllocator);
+    }
 
-    swapchain->PresentImage(fr.renderingFinished.get());
+    return total;
   }
 
-  HostBuffer Core::AllocateHostBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage)
+  DescriptorCacheStatistics Core::GetDescriptorCacheStatistics() const
   {
-    auto [hostBuffer, bufferMemory, memSize] = AllocateBuffer(size, usage, graphicsFamilyIndex, hostVisibleMemoryIndex);
+    DescriptorCacheStatistics total;
 
-    return HostBuffer{ logicalDevice.get(), std::move(hostBuffer), std::move(bufferMemory), memSize };
+    auto add = [&](const DescriptorSetCache& cache)
+    {
+      const DescriptorCacheStatistics s = cache.GetStatistics();
+      total.setsCount += s.setsCount;
+      total.hitsCount += s.hitsCount;
+      total.missesCount += s.missesCount;
+      total.flushesCount += s.flushesCount;
+      total.releasedCount += s.releasedCount;
+    };
+
+    for (const FrameResources& fr : frameResources)
+    {
+      add(*fr.descriptorSetCache);
+      for (const ThreadFrameResources& tr : fr.threadResources)
+        add(*tr.descriptorSetCache);
+    }
+
+    return total;
   }
 
-  Buffer Core::AllocateDeviceBuffer(const void* src, vk::DeviceSize size, vk::BufferUsageFlags usage)
+  void Core::ReleaseDescriptorSets(vk::ImageView view)
+  {
+    //every virtual frame may have cached a set with the view
+    for (FrameResources& fr : frameResources)
+    {
+      fr.descriptorSetCache->Release(view);
+      for (ThreadFrameResources& tr : fr.threadResources)
+        tr.descriptorSetCache->Release(view);
+    }
+  }
+
+  void Core::ReleaseDescriptorSets(vk::Buffer buffer)
   {
-    HostBuffer hostBuffer = AllocateHostBuffer(size, usage | vk::BufferUsageFlagBits::eTransferSrc);
-    hostBuffer.UploadMemory(src, size, 0);
+    for (FrameResources& fr : frameResources)
+    {
+      fr.descriptorSetCache->Release(buffer);
+      for (ThreadFrameResources& tr : fr.threadResources)
+        tr.descriptorSetCache->Release(buffer);
+    }
+  }
 
-    auto [deviceBuffer, deviceBufferMemory, deviceBufferMemSize] = AllocateBuffer(size, usage | vk::BufferUsageFlagBits::eTransferDst, transferFamilyIndex, deviceLocalMemoryIndex);
+  uint64_t Core::GetCompletedFrameNumber() const
+  {
+    return logicalDevice->getSemaphoreCounterValue(frameTimeline.get());
+  }
 
-    const auto cmdBufferAllocateInfo = vk::CommandBufferAllocateInfo()
-      .setCommandPool(cmdPool.get())
-      .setCommandBufferCount(1)
-      .setLevel(vk::CommandBufferLevel::ePrimary);
+  void Core::WaitIdle()
+  {
+    WaitFrame(frameNumber);
+  }
 
-    vk::UniqueCommandBuffer cmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
-    cmdBuffer->begin(vk::CommandBufferBeginInfo());
+  void Core::WaitFrame(uint64_t frame)
+  {
+    const auto waitInfo = vk::SemaphoreWaitInfo()
+      .setSemaphoreCount(1)
+      .setPSemaphores(&frameTimeline.get())
+      .setPValues(&frame);
 
-    const auto copyRegion = vk::BufferCopy()
-      .setSize(size)
-      .setSrcOffset(0)
-      .setDstOffset(0);
+    logicalDevice->waitSemaphores(waitInfo, uint64_t(-1));
+  }
 
-    cmdBuffer->copyBuffer(hostBuffer.GetBuffer(), deviceBuffer.get(), 1, &copyRegion);
-    cmdBuffer->end();
+  HostBuffer Core::AllocateHostBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage)
+  {
+    auto [hostBuffer, bufferMemory] = AllocateBuffer(size, usage, graphicsFamilyIndex, hostVisibleMemoryIndex);
 
-    vk::UniqueFence bufferCopiedFence = logicalDevice->createFenceUnique(vk::FenceCreateInfo());
-    const auto submitInfo = vk::SubmitInfo()
-      .setCommandBufferCount(1)
-      .setPCommandBuffers(&cmdBuffer.get());
+    return HostBuffer{ logicalDevice.get(), std::move(hostBuffer), std::move(bufferMemory) };
+  }
 
-    transferQueue.submit(1, &submitInfo, bufferCopiedFence.get());
+  Buffer Core::AllocateDeviceBuffer(const void* src, vk::DeviceSize size, vk::BufferUsageFlags usage)
+  {
+    auto [deviceBuffer, deviceBufferMemory] = AllocateBuffer(size, usage | vk::BufferUsageFlagBits::eTransferDst, transferFamilyIndex, deviceLocalMemoryIndex);
 
-    const bool waitAll = true;
-    logicalDevice->waitForFences(1, &bufferCopiedFence.get(), waitAll, uint64_t(-1));
+    uploadContext->CopyToBuffer(src, size, deviceBuffer.get());
 
-    return Buffer{ logicalDevice.get(), std::move(deviceBuffer), std::move(deviceBufferMemory), deviceBufferMemSize };
+    return Buffer{ logicalDevice.get(), std::move(deviceBuffer), std::move(deviceBufferMemory) };
   }
 
-  std::tuple<vk::UniqueBuffer, vk::UniqueDeviceMemory, vk::DeviceSize> Core::AllocateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, uint32_t queueFamilyIndex, uint32_t memoryTypeIndex)
+  std::tuple<vk::UniqueBuffer, MemoryAllocation> Core::AllocateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, uint32_t queueFamilyIndex, uint32_t memoryTypeIndex)
   {
+    //buffers are touched by graphics, transfer and async compute queues without ownership transfers
+    const std::set<uint32_t> uniqueFamilies = { queueFamilyIndex, graphicsFamilyIndex, transferFamilyIndex, computeFamilyIndex };
+    const std::vector<uint32_t> families{ uniqueFamilies.begin(), uniqueFamilies.end() };
+
     const auto bufferCreateInfo = vk::BufferCreateInfo()
       //.setFlags()
       .setSize(size)
       .setUsage(usage)
-      .setSharingMode(vk::SharingMode::eExclusive)
-      .setQueueFamilyIndexCount(1)
-      .setPQueueFamilyIndices(&queueFamilyIndex);
+      .setSharingMode(families.size() > 1 ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive)
+      .setQueueFamilyIndexCount(static_cast<uint32_t>(families.size()))
+      .setPQueueFamilyIndices(families.data());
 
     vk::UniqueBuffer buf = logicalDevice->createBufferUnique(bufferCreateInfo);
 
     const vk::MemoryRequirements memRec = logicalDevice->getBufferMemoryRequirements(buf.get());
 
-    const auto memAllocateInfo = vk::MemoryAllocateInfo()
-      .setAllocationSize(memRec.size)
-      .setMemoryTypeIndex(memoryTypeIndex);
-
-    vk::UniqueDeviceMemory memory = logicalDevice->allocateMemoryUnique(memAllocateInfo);
+    MemoryAllocation memory = memoryAllocator->Allocate(memRec, memoryTypeIndex, ResourceTiling::Linear);
 
-    logicalDevice->bindBufferMemory(buf.get(), memory.get(), 0);
+    logicalDevice->bindBufferMemory(buf.get(), memory.GetMemory(), memory.GetOffset());
 
-    return { std::move(buf), std::move(memory), memRec.size };
+    return { std::move(buf), std::move(memory) };
   }
 
   Image Core::AllocateImage(vk::ImageType type, vk::Format format, const vk::Extent3D& extent, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectMask, vk::ImageCreateFlags createFlags, uint32_t arrayLayers, vk::ImageViewType viewType)
+  {
+    vk::UniqueImage img = CreateImage(type, format, extent, usage, createFlags, arrayLayers);
+
+    const vk::MemoryRequirements memRec = logicalDevice->getImageMemoryRequirements(img.get());
+
+    MemoryAllocation memory = memoryAllocator->Allocate(memRec, deviceLocalMemoryIndex, ResourceTiling::Optimal);
+
+    logicalDevice->bindImageMemory(img.get(), memory.GetMemory(), memory.GetOffset());
+
+    return CreateImageViews(std::move(img), std::move(memory), format, aspectMask, arrayLayers, viewType);
+  }
+
+  vk::UniqueImage Core::CreateImage(vk::ImageType type, vk::Format format, const vk::Extent3D& extent, vk::ImageUsageFlags usage, vk::ImageCreateFlags createFlags, uint32_t arrayLayers)
   {
     const auto imageCreateInfo = vk::ImageCreateInfo()
       .setFlags(createFlags)
@@ -361,18 +890,32 @@ namespace Vulkan
       .setSharingMode(vk::SharingMode::eExclusive)
       .setInitialLayout(vk::ImageLayout::eUndefined);
 
-    vk::UniqueImage img = logicalDevice->createImageUnique(imageCreateInfo);
+    return logicalDevice->createImageUnique(imageCreateInfo);
+  }
 
-    const vk::MemoryRequirements memRec = logicalDevice->getImageMemoryRequirements(img.get());
+  MemoryAllocation Core::AllocateDeviceLocalMemory(const vk::MemoryRequirements& requirements, ResourceTiling tiling)
+  {
+    return memoryAllocator->Allocate(requirements, deviceLocalMemoryIndex, tiling);
+  }
+
+  MemoryAllocation Core::AllocateTransientAttachmentMemory(const vk::MemoryRequirements& requirements)
+  {
+    //contents never leave the render pass, tile based devices don't have to back it with real memory
+    if ((lazilyAllocatedMemoryIndex != -1) && (requirements.memoryTypeBits & (1u << lazilyAllocatedMemoryIndex)))
+      return memoryAllocator->Allocate(requirements, lazilyAllocatedMemoryIndex, ResourceTiling::Optimal);
 
-    const auto memAllocateInfo = vk::MemoryAllocateInfo()
-      .setAllocationSize(memRec.size)
-      .setMemoryTypeIndex(deviceLocalMemoryIndex);
+    return memoryAllocator->Allocate(requirements, deviceLocalMemoryIndex, ResourceTiling::Optimal);
+  }
 
-    vk::UniqueDeviceMemory memory = logicalDevice->allocateMemoryUnique(memAllocateInfo);
+  Image Core::BindAliasedImage(vk::UniqueImage img, const MemoryAllocation& memory, vk::Format format, vk::ImageAspectFlags aspectMask)
+  {
+    logicalDevice->bindImageMemory(img.get(), memory.GetMemory(), memory.GetOffset());
 
-    logicalDevice->bindImageMemory(img.get(), memory.get(), 0);
+    return CreateImageViews(std::move(img), MemoryAllocation{}, format, aspectMask, 1, vk::ImageViewType::e2D);
+  }
 
+  Image Core::CreateImageViews(vk::UniqueImage img, MemoryAllocation memory, vk::Format format, vk::ImageAspectFlags aspectMask, uint32_t arrayLayers, vk::ImageViewType viewType)
+  {
     const auto subresourceRange = vk::ImageSubresourceRange()
       .setAspectMask(aspectMask)
       .setBaseMipLevel(0)
@@ -418,19 +961,8 @@ namespace Vulkan
 
   Image Core::Allocate2DImage(const void* src, vk::DeviceSize size, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage)
   {
-    HostBuffer hostBuffer = AllocateHostBuffer(size, vk::BufferUsageFlagBits::eTransferSrc);
-    hostBuffer.UploadMemory(src, size, 0);
-
     Image deviceImage = Allocate2DImage(format, extent, usage | vk::ImageUsageFlagBits::eTransferDst);
 
-    const auto cmdBufferAllocateInfo = vk::CommandBufferAllocateInfo()
-      .setCommandPool(cmdPool.get())
-      .setCommandBufferCount(1)
-      .setLevel(vk::CommandBufferLevel::ePrimary);
-
-    vk::UniqueCommandBuffer cmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
-    cmdBuffer->begin(vk::CommandBufferBeginInfo());
-
     const auto subresourceRange = vk::ImageSubresourceRange()
       .setAspectMask(vk::ImageAspectFlagBits::eColor)
       .setBaseMipLevel(0)
@@ -438,20 +970,6 @@ namespace Vulkan
       .setBaseArrayLayer(0)
       .setLayerCount(1);
 
-    auto imgMemoryBarrier = vk::ImageMemoryBarrier()
-      .setSrcAccessMask(vk::AccessFlagBits{})
-      .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
-      .setOldLayout(vk::ImageLayout::eUndefined)
-      .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-      .setImage(deviceImage.GetImage())
-      .setSubresourceRange(subresourceRange);
-
-    cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
-      vk::DependencyFlagBits{},
-      0, nullptr,
-      0, nullptr,
-      1, &imgMemoryBarrier);
-
     const auto copyRegion = vk::BufferImageCopy()
       .setBufferOffset(0)
       .setBufferRowLength(0)
@@ -466,100 +984,11 @@ namespace Vulkan
       .setImageOffset(vk::Offset3D{ 0,0,0 })
       .setImageExtent(vk::Extent3D{ extent.width, extent.height, 1 });
 
-    cmdBuffer->copyBufferToImage(hostBuffer.GetBuffer(), deviceImage.GetImage(), vk::ImageLayout::eTransferDstOptimal, 1, &copyRegion);
-
-    imgMemoryBarrier = vk::ImageMemoryBarrier()
-      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-      .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-      .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
-      .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-      .setImage(deviceImage.GetImage())
-      .setSubresourceRange(subresourceRange);
-
-    cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-      vk::DependencyFlagBits{},
-      0, nullptr,
-      0, nullptr,
-      1, &imgMemoryBarrier);
-
-    vk::UniqueFence bufferCopiedFence = logicalDevice->createFenceUnique(vk::FenceCreateInfo());
-    const auto submitInfo = vk::SubmitInfo()
-      .setCommandBufferCount(1)
-      .setPCommandBuffers(&cmdBuffer.get());
-
-    cmdBuffer->end();
-
-    transferQueue.submit(1, &submitInfo, bufferCopiedFence.get());
-
-    const bool waitAll = true;
-    logicalDevice->waitForFences(1, &bufferCopiedFence.get(), waitAll, uint64_t(-1));
+    uploadContext->CopyToImage(src, size, deviceImage.GetImage(), subresourceRange, { copyRegion });
 
     return std::move(deviceImage);
   }
 
-  void Core::TransferImageDataToDeviceMemory(const HostBuffer& srcBuffer, const Image& deviceImage, const std::vector<vk::BufferImageCopy>& copyRegions, uint32_t nLayers, vk::ImageLayout finalLayout)
-  {
-    const auto cmdBufferAllocateInfo = vk::CommandBufferAllocateInfo()
-      .setCommandPool(cmdPool.get())
-      .setCommandBufferCount(1)
-      .setLevel(vk::CommandBufferLevel::ePrimary);
-
-    vk::UniqueCommandBuffer cmdBuffer = std::move(logicalDevice->allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
-    cmdBuffer->begin(vk::CommandBufferBeginInfo());
-
-    const auto subresourceRange = vk::ImageSubresourceRange()
-      .setAspectMask(vk::ImageAspectFlagBits::eColor)
-      .setBaseMipLevel(0)
-      .setLevelCount(1)
-      .setBaseArrayLayer(0)
-      .setLayerCount(nLayers);
-
-    auto imgMemoryBarrier = vk::ImageMemoryBarrier()
-      .setSrcAccessMask(vk::AccessFlagBits{})
-      .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
-      .setOldLayout(vk::ImageLayout::eUndefined)
-      .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-      .setImage(deviceImage.GetImage())
-      .setSubresourceRange(subresourceRange);
-
-    cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
-      vk::DependencyFlagBits{},
-      0, nullptr,
-      0, nullptr,
-      1, &imgMemoryBarrier);
-
-    cmdBuffer->copyBufferToImage(srcBuffer.GetBuffer(), deviceImage.GetImage(), vk::ImageLayout::eTransferDstOptimal, copyRegions.size(), copyRegions.data());
-
-    imgMemoryBarrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-    imgMemoryBarrier.newLayout = finalLayout;
-
-    imgMemoryBarrier = vk::ImageMemoryBarrier()
-      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-      .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-      .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
-      .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-      .setImage(deviceImage.GetImage())
-      .setSubresourceRange(subresourceRange);
-
-    cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-      vk::DependencyFlagBits{},
-      0, nullptr,
-      0, nullptr,
-      1, &imgMemoryBarrier);
-
-    vk::UniqueFence bufferCopiedFence = logicalDevice->createFenceUnique(vk::FenceCreateInfo());
-    const auto submitInfo = vk::SubmitInfo()
-      .setCommandBufferCount(1)
-      .setPCommandBuffers(&cmdBuffer.get());
-
-    cmdBuffer->end();
-
-    transferQueue.submit(1, &submitInfo, bufferCopiedFence.get());
-
-    const bool waitAll = true;
-    logicalDevice->waitForFences(1, &bufferCopiedFence.get(), waitAll, uint64_t(-1));
-  }
-
   Image Core::AllocateDepthStencilImage(vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usageFlags, vk::ImageAspectFlags aspectFlags)
   {
     return AllocateImage(vk::ImageType::e2D, format, vk::Extent3D{ extent.width, extent.height, 1 }, usageFlags, aspectFlags, vk::ImageCreateFlags{}, 1, vk::ImageViewType::e2D);
@@ -567,9 +996,6 @@ namespace Vulkan
 
   Image Core::AllocateCubeMap(vk::Format format, void* src, vk::DeviceSize size, uint32_t baseWidth, uint32_t baseHeight, std::array<vk::DeviceSize, 6> offsets)
   {
-    HostBuffer hostBuffer = AllocateHostBuffer(size, vk::BufferUsageFlagBits::eTransferSrc);
-    hostBuffer.UploadMemory(src, size, 0);
-
     const int nlayers = 6;
 
     Image deviceImage = AllocateImage(vk::ImageType::e2D,
@@ -600,7 +1026,14 @@ namespace Vulkan
       );
     }
 
-    TransferImageDataToDeviceMemory(hostBuffer, deviceImage, copyRegions, nlayers);
+    const auto subresourceRange = vk::ImageSubresourceRange()
+      .setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setBaseMipLevel(0)
+      .setLevelCount(1)
+      .setBaseArrayLayer(0)
+      .setLayerCount(nlayers);
+
+    uploadContext->CopyToImage(src, size, deviceImage.GetImage(), subresourceRange, copyRegions);
 
     return std::move(deviceImage);
   }
@@ -619,6 +1052,11 @@ namespace Vulkan
         physicalDevice = device;
       }
     }
+
+    //integrated and software devices (e.g. lavapipe) are used when there is no discrete one
+    if (!physicalDevice && !physicalDevices.empty())
+      physicalDevice = physicalDevices[0];
+
     if (!physicalDevice)
       throw std::runtime_error("Failed to find physical device");
 
@@ -3,8 +3,17 @@
 #include "framegraph.h"
 #include "framebuffer_storage.h"
 #include "pipeline_storage.h"
+#include "pipeline_cache.h"
+#include "gpu_profiler.h"
 #include "renderpass_storage.h"
 #include "uniforms_accessor_storage.h"
+#include "transient_attachment_pool.h"
+#include "memory_allocator.h"
+#include "upload_context.h"
+#include "uniform_ring.h"
+#include "descriptor_allocator.h"
+#include "descriptor_set_cache.h"
+#include "worker_pool.h"
 
 #include "swapchain.h"
 #include "Shader.h"
@@ -14,32 +23,106 @@
 #include <stdint.h>
 #include <set>
 #include <array>
+#include <deque>
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
-#undef VK_USE_PLATFORM_WIN32_KHR
 
 struct GLFWwindow;
 
 namespace Vulkan
 {
+  constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+  //per worker resources of a virtual frame, used only by the worker with the same index
+  struct ThreadFrameResources
+  {
+    vk::UniqueCommandPool cmdPool;
+    std::vector<vk::UniqueCommandBuffer> secondaryCmdBuffers;
+    uint32_t usedSecondaryCmdBuffers = 0;
+    std::unique_ptr<DescriptorAllocator> descriptorAllocator;
+    std::unique_ptr<DescriptorSetCache> descriptorSetCache;
+    std::unique_ptr<UniformRing> uniformRing;
+    std::unique_ptr<UniformsAccessorStorage> uaStorage;
+
+    vk::CommandBuffer GetSecondaryCommandBuffer(vk::Device device);
+
+    void Reset(vk::Device device);
+  };
+
   struct FrameResources
   {
     ImageView swapchainImage;
-    vk::UniqueFence cmdBufferFreeToUse;
+    //frame which used these resources last, they are free when the frame timeline reaches it
+    uint64_t frameNumber = 0;
     vk::UniqueSemaphore swapchainImageAckquired;
     vk::UniqueSemaphore renderingFinished;
     vk::UniqueCommandBuffer cmdBuffer;
+    //ownership acquires of the images uploaded on another queue family, submitted before cmdBuffer
+    vk::UniqueCommandBuffer uploadAcquireCmdBuffer;
+    //async compute work and the graphics work waiting for it
+    vk::UniqueCommandBuffer computeCmdBuffer;
+    vk::UniqueCommandBuffer graphicsAfterComputeCmdBuffer;
+    vk::UniqueSemaphore computeFinished;
+    //passes from the backbuffer's first use, submitted after the swapchain image was acquired
+    vk::UniqueCommandBuffer backbufferCmdBuffer;
+    std::unique_ptr<DescriptorAllocator> descriptorAllocator;
+    std::unique_ptr<DescriptorSetCache> descriptorSetCache;
+    std::unique_ptr<UniformRing> uniformRing;
     std::unique_ptr<UniformsAccessorStorage> uaStorage;
     std::unique_ptr<RenderGraph> renderGraph;
+    std::vector<ThreadFrameResources> threadResources;
+    //headless core renders into its own image instead of the swapchain one
+    Image offscreenImage;
+    HostBuffer readbackBuffer;
+    vk::UniqueCommandBuffer readbackCmdBuffer;
+  };
 
+  //backbuffer of the core running without a window
+  struct HeadlessDescription
+  {
+    vk::Extent2D size;
+    vk::Format format = vk::Format::eR8G8B8A8Unorm;
+    //backbuffer is copied to the host memory at the end of each frame
+    bool isReadbackEnabled = false;
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+
+    HeadlessDescription& SetSize(const vk::Extent2D& s)
+    {
+      size = s;
+      return *this;
+    }
+
+    HeadlessDescription& SetFormat(vk::Format f)
+    {
+      format = f;
+      return *this;
+    }
+
+    HeadlessDescription& SetReadbackEnabled(bool enabled)
+    {
+      isReadbackEnabled = enabled;
+      return *this;
+    }
+
+    HeadlessDescription& SetFramesInFlight(uint32_t count)
+    {
+      framesInFlight = count;
+      return *this;
+    }
   };
 
   class Core
   {
   public:
 
-    Core(GLFWwindow* window, const char** instanceExtensions, uint32_t instanceExtensionsCount, vk::Extent2D windowSize);
+    //frames in flight don't depend on the swapchain length, cpu may run ahead of the presentation
+    Core(GLFWwindow* window, const char** instanceExtensions, uint32_t instanceExtensionsCount, vk::Extent2D windowSize, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+
+    //core without surface and swapchain, nothing is presented
+    Core(const HeadlessDescription& description);
+
+    //frames in flight on every queue are finished before their resources are destroyed
+    ~Core();
 
     FramebufferStorage& GetFramebufferStorage();
 
@@ -47,6 +130,16 @@ namespace Vulkan
 
     PipelineStorage& GetPipelineStorage();
 
+    PipelineCache& GetPipelineCache();
+
+    UploadContext& GetUploadContext();
+
+    WorkerPool& GetWorkerPool();
+
+    GpuProfiler& GetGpuProfiler();
+
+    TransientAttachmentPool& GetTransientAttachmentPool();
+
     vk::Device GetDebugDevice();
 
     vk::Format GetDebugSurfaceFormat();
@@ -57,6 +150,16 @@ namespace Vulkan
 
     void EndFrame();
 
+    //waits for the last ended frame and returns its backbuffer texels, rows are tightly packed
+    std::vector<uint8_t> ReadBackbuffer();
+
+    //resource is destroyed once the gpu finished the current frame, e.g. a buffer replaced in the middle of a run
+    template<class T>
+    void ReleaseAfterFrame(T resource)
+    {
+      releaseQueue.emplace_back(frameNumber, std::make_shared<T>(std::move(resource)));
+    }
+
     HostBuffer AllocateHostBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage);
 
     Buffer AllocateDeviceBuffer(const void* src, vk::DeviceSize size, vk::BufferUsageFlags usage);
@@ -67,49 +170,146 @@ namespace Vulkan
 
     Image Allocate2DImage(const void* src, vk::DeviceSize size, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage);
 
-    void TransferImageDataToDeviceMemory(const HostBuffer& buffer, const Image& deviceImage, const std::vector<vk::BufferImageCopy>& copyRegions, uint32_t nLayers, vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
-
     Image AllocateCubeMap(vk::Format format, void* src, vk::DeviceSize size, uint32_t baseWidth, uint32_t baseHeight, std::array<vk::DeviceSize, 6> offsets);
 
     Image AllocateDepthStencilImage(vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usageFlags, vk::ImageAspectFlags aspectFlags);
 
+    //image without memory, has to be bound by the caller
+    vk::UniqueImage CreateImage(vk::ImageType type, vk::Format format, const vk::Extent3D& extent, vk::ImageUsageFlags usage, vk::ImageCreateFlags createFlags, uint32_t arrayLayers);
+
+    MemoryAllocation AllocateDeviceLocalMemory(const vk::MemoryRequirements& requirements, ResourceTiling tiling);
+
+    //lazily allocated memory when the device has it, device local otherwise
+    MemoryAllocation AllocateTransientAttachmentMemory(const vk::MemoryRequirements& requirements);
+
+    //binds 2D image to a memory shared with other images, memory is owned by the caller
+    Image BindAliasedImage(vk::UniqueImage img, const MemoryAllocation& memory, vk::Format format, vk::ImageAspectFlags aspectMask);
+
     vk::PhysicalDevice GetPhysicalDevice(vk::Instance instance);
 
     vk::Device GetLogicalDevice() const;
 
     vk::ImageMemoryBarrier GetImageMemoryBarrier(const ImageView& view, ImageType imgType);
 
+    inline MemoryStatistics GetMemoryStatistics() const
+    {
+      return memoryAllocator->GetStatistics();
+    }
+
+    inline PipelineCacheStatistics GetPipelineCacheStatistics() const
+    {
+      return pipelineCache->GetStatistics();
+    }
+
+    //summed over the virtual frames and their workers
+    DescriptorStatistics GetDescriptorStatistics() const;
+
+    DescriptorCacheStatistics GetDescriptorCacheStatistics() const;
+
+    //has to be called before the view or buffer is destroyed, cached descriptor sets are keyed by the raw handles
+    void ReleaseDescriptorSets(vk::ImageView view);
+
+    void ReleaseDescriptorSets(vk::Buffer buffer);
+
     inline uint32_t GetSwapchainImagesCount() const
     {
-      return swapchain->GetImagesCount();
+      return swapchain ? swapchain->GetImagesCount() : 0;
+    }
+
+    //per frame resources outside of the core are indexed by GetFrameNumber() % GetFramesInFlightCount()
+    inline uint32_t GetFramesInFlightCount() const
+    {
+      return static_cast<uint32_t>(frameResources.size());
+    }
+
+    //number of the frame being recorded, the first frame is 1
+    inline uint64_t GetFrameNumber() const
+    {
+      return frameNumber;
+    }
+
+    //last frame whose work was finished by the gpu
+    uint64_t GetCompletedFrameNumber() const;
+
+    //blocks until the gpu finished every submitted frame
+    void WaitIdle();
+
+    inline bool IsHeadless() const
+    {
+      return swapchain == nullptr;
+    }
+
+    inline uint32_t GetGraphicsFamilyIndex() const
+    {
+      return graphicsFamilyIndex;
+    }
+
+    inline uint32_t GetComputeFamilyIndex() const
+    {
+      return computeFamilyIndex;
+    }
+
+    //device has a compute family separate from the graphics one
+    inline bool HasAsyncCompute() const
+    {
+      return computeFamilyIndex != graphicsFamilyIndex;
     }
 
   private:
-    std::tuple<vk::UniqueBuffer, vk::UniqueDeviceMemory, vk::DeviceSize> AllocateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, uint32_t queueFamilyIndex, uint32_t memoryTypeIndex);
+    void InitializeInstance(const char** instanceExtensions, uint32_t instanceExtensionsCount);
+
+    void InitializeDevice();
+
+    void InitializeFrames(uint32_t framesCount);
+
+    void RecordBackbufferReadback(FrameResources& fr);
+
+    void WaitFrame(uint64_t frame);
+
+    Image CreateImageViews(vk::UniqueImage img, MemoryAllocation memory, vk::Format format, vk::ImageAspectFlags aspectMask, uint32_t arrayLayers, vk::ImageViewType viewType);
+
+    std::tuple<vk::UniqueBuffer, MemoryAllocation> AllocateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, uint32_t queueFamilyIndex, uint32_t memoryTypeIndex);
 
   private:
     vk::UniqueInstance instance;
+    std::vector<const char*> validationLayers;
     vk::PhysicalDevice physicalDevice;
     vk::UniqueSurfaceKHR surface;
     uint32_t graphicsFamilyIndex;
     uint32_t presentFamilyIndex;
     uint32_t transferFamilyIndex;
+    uint32_t computeFamilyIndex;
     vk::UniqueDevice logicalDevice;
+    std::unique_ptr<MemoryAllocator> memoryAllocator;
+    std::unique_ptr<PipelineCache> pipelineCache;
+    std::unique_ptr<GpuProfiler> gpuProfiler;
+    bool isPipelineStatisticsQuerySupported;
+    uint32_t framesSincePipelineCacheSave;
     vk::Queue graphicsQueue;
     vk::Queue presentQueue;
     vk::Queue transferQueue;
+    vk::Queue computeQueue;
     vk::UniqueCommandPool cmdPool;
+    vk::UniqueCommandPool computeCmdPool;
+    std::unique_ptr<UploadContext> uploadContext;
     std::unique_ptr<Swapchain> swapchain;
-    vk::UniqueDescriptorPool descriptorPool;
+    HeadlessDescription headless;
 
+    //signaled with the frame number by the frame's last submission
+    vk::UniqueSemaphore frameTimeline;
+    uint64_t frameNumber;
     uint32_t currentVirtualFrame;
     std::vector<FrameResources> frameResources;
+    std::deque<std::pair<uint64_t, std::shared_ptr<void>>> releaseQueue;
 
     std::unique_ptr<FramebufferStorage> fbStorage;
     std::unique_ptr<RenderPassStorage> rpStorage;
     std::unique_ptr<PipelineStorage> ppStorage;
+    std::unique_ptr<TransientAttachmentPool> attachmentPool;
+    std::unique_ptr<WorkerPool> workerPool;
 
     uint32_t hostVisibleMemoryIndex;
     uint32_t deviceLocalMemoryIndex;
+    uint32_t lazilyAllocatedMemoryIndex;
   };
 }
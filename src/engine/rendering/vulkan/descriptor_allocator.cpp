@@ -0,0 +1,112 @@
+#include "descriptor_allocator.h"
+#include "shader.h"
+
+#include <algorithm>
+
+namespace Vulkan
+{
+  DescriptorAllocator::DescriptorAllocator(vk::Device device, uint32_t setsPerPage)
+    : device(device)
+    , setsPerPage(setsPerPage)
+    , currentPage(0)
+    , requestedSets(0)
+  {
+  }
+
+  vk::DescriptorSet DescriptorAllocator::Allocate(vk::DescriptorSetLayout layout, const UniformSetDescription& set)
+  {
+    std::map<vk::DescriptorType, uint32_t> setDescriptors;
+    for (const UniformBindingDescription& binding : set.bindings)
+      if (binding.type != UniformType::None)
+        ++setDescriptors[GetDescriptorType(binding.type)];
+
+    ++requestedSets;
+    for (const auto& [type, count] : setDescriptors)
+    {
+      requestedDescriptors[type] += count;
+      statistics.descriptorsCount[type] += count;
+    }
+
+    bool isNewPage = pages.empty();
+    if (isNewPage)
+      pages.push_back(CreatePage(setDescriptors));
+
+    auto allocInfo = vk::DescriptorSetAllocateInfo()
+      .setDescriptorSetCount(1)
+      .setPSetLayouts(&layout);
+
+    vk::DescriptorSet dscSet;
+
+    //pages kept from the previous frames may lack the set's types, a new page always has them
+    while (true)
+    {
+      allocInfo.setDescriptorPool(pages[currentPage].get());
+
+      const vk::Result result = device.allocateDescriptorSets(&allocInfo, &dscSet);
+      if (result == vk::Result::eSuccess)
+        break;
+
+      if ((result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool) || isNewPage)
+        throw std::runtime_error("DescriptorAllocator::Allocate: failed to allocate a descriptor set, " + vk::to_string(result));
+
+      ++currentPage;
+      ++statistics.pageOverflowsCount;
+
+      isNewPage = currentPage == pages.size();
+      if (isNewPage)
+        pages.push_back(CreatePage(setDescriptors));
+    }
+
+    ++statistics.setsCount;
+    statistics.peakSetsCount = std::max(statistics.peakSetsCount, statistics.setsCount);
+
+    return dscSet;
+  }
+
+  void DescriptorAllocator::Reset()
+  {
+    if (pages.empty())
+      return;
+
+    for (size_t i = 0; i <= currentPage; ++i)
+      device.resetDescriptorPool(pages[i].get(), vk::DescriptorPoolResetFlags());
+
+    currentPage = 0;
+    statistics.setsCount = 0;
+    statistics.descriptorsCount.clear();
+  }
+
+  DescriptorStatistics DescriptorAllocator::GetStatistics() const
+  {
+    DescriptorStatistics result = statistics;
+    result.pagesCount = static_cast<uint32_t>(pages.size());
+
+    return result;
+  }
+
+  vk::UniqueDescriptorPool DescriptorAllocator::CreatePage(const std::map<vk::DescriptorType, uint32_t>& setDescriptors) const
+  {
+    //average set of the program seen so far times the page's sets, the set being allocated always fits
+    std::vector<vk::DescriptorPoolSize> poolSizes;
+    for (const auto& [type, count] : requestedDescriptors)
+    {
+      const uint64_t pageCount = (count * setsPerPage + requestedSets - 1) / requestedSets;
+
+      const auto it = setDescriptors.find(type);
+      const uint32_t setCount = it != setDescriptors.end() ? it->second : 0;
+
+      poolSizes.push_back(
+        vk::DescriptorPoolSize()
+        .setType(type)
+        .setDescriptorCount(std::max(static_cast<uint32_t>(pageCount), setCount))
+      );
+    }
+
+    const auto poolCreateInfo = vk::DescriptorPoolCreateInfo()
+      .setMaxSets(setsPerPage)
+      .setPoolSizeCount(static_cast<uint32_t>(poolSizes.size()))
+      .setPPoolSizes(poolSizes.data());
+
+    return device.createDescriptorPoolUnique(poolCreateInfo);
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "shader_parsing.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <vector>
+
+namespace Vulkan
+{
+  struct DescriptorStatistics
+  {
+    uint32_t pagesCount = 0;
+    //sets allocated since the last reset
+    uint32_t setsCount = 0;
+    //most sets allocated between two resets
+    uint32_t peakSetsCount = 0;
+    //times a page ran out of sets or descriptors and the next one was taken
+    uint32_t pageOverflowsCount = 0;
+    std::map<vk::DescriptorType, uint32_t> descriptorsCount;
+  };
+
+  //linear allocator of a virtual frame's descriptor sets, pages are reset wholesale once the frame timeline passes their frame
+  //and the owner's DescriptorSetCache drops the sets living in them.
+  //new pages follow the proportion of descriptor types requested so far
+  class DescriptorAllocator
+  {
+  public:
+    DescriptorAllocator(vk::Device device, uint32_t setsPerPage);
+
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+    vk::DescriptorSet Allocate(vk::DescriptorSetLayout layout, const UniformSetDescription& set);
+
+    void Reset();
+
+    DescriptorStatistics GetStatistics() const;
+
+  private:
+    vk::UniqueDescriptorPool CreatePage(const std::map<vk::DescriptorType, uint32_t>& setDescriptors) const;
+
+  private:
+    vk::Device device;
+    uint32_t setsPerPage;
+
+    std::vector<vk::UniqueDescriptorPool> pages;
+    size_t currentPage;
+
+    //all the sets ever allocated, the ratio sizes the new pages
+    std::map<vk::DescriptorType, uint64_t> requestedDescriptors;
+    uint64_t requestedSets;
+
+    DescriptorStatistics statistics;
+  };
+}
@@ -0,0 +1,128 @@
+#include "descriptor_set_cache.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace
+{
+  inline uint64_t HashCombine(uint64_t hash, uint64_t value)
+  {
+    return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+  }
+
+  template<class T>
+  inline uint64_t GetHandleBits(T handle)
+  {
+    return reinterpret_cast<uint64_t>(static_cast<typename T::CType>(handle));
+  }
+}
+
+namespace Vulkan
+{
+  bool DescriptorBindingKey::operator==(const DescriptorBindingKey& r) const
+  {
+    return std::tie(binding, type, buffer, offset, range, imageView, sampler, imageLayout) ==
+           std::tie(r.binding, r.type, r.buffer, r.offset, r.range, r.imageView, r.sampler, r.imageLayout);
+  }
+
+  void DescriptorSetKey::ComputeHash()
+  {
+    uint64_t h = GetHandleBits(layout);
+
+    for (const DescriptorBindingKey& b : bindings)
+    {
+      h = HashCombine(h, (static_cast<uint64_t>(b.binding) << 32) | static_cast<uint32_t>(b.type));
+      h = HashCombine(h, GetHandleBits(b.buffer));
+      h = HashCombine(h, b.offset);
+      h = HashCombine(h, b.range);
+      h = HashCombine(h, GetHandleBits(b.imageView));
+      h = HashCombine(h, GetHandleBits(b.sampler));
+      h = HashCombine(h, static_cast<uint64_t>(b.imageLayout));
+    }
+
+    hash = h;
+  }
+
+  bool DescriptorSetKey::operator==(const DescriptorSetKey& r) const
+  {
+    return hash == r.hash && layout == r.layout && bindings == r.bindings;
+  }
+
+  DescriptorSetCache::DescriptorSetCache(vk::Device device, DescriptorAllocator* allocator, uint32_t maxSetsCount)
+    : device(device)
+    , allocator(allocator)
+    , maxSetsCount(maxSetsCount)
+  {
+  }
+
+  void DescriptorSetCache::BeginFrame()
+  {
+    if (sets.size() < maxSetsCount)
+      return;
+
+    sets.clear();
+    allocator->Reset();
+    ++statistics.flushesCount;
+  }
+
+  vk::DescriptorSet DescriptorSetCache::Find(const DescriptorSetKey& key)
+  {
+    const auto it = sets.find(key);
+    if (it == sets.end())
+      return vk::DescriptorSet{};
+
+    ++statistics.hitsCount;
+    return it->second;
+  }
+
+  vk::DescriptorSet DescriptorSetCache::Insert(const DescriptorSetKey& key, const UniformSetDescription& set, std::vector<vk::WriteDescriptorSet>& writes)
+  {
+    const vk::DescriptorSet dscSet = allocator->Allocate(key.layout, set);
+
+    for (vk::WriteDescriptorSet& write : writes)
+      write.setDstSet(dscSet);
+
+    if (!writes.empty())
+      device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    sets.emplace(key, dscSet);
+    ++statistics.missesCount;
+
+    return dscSet;
+  }
+
+  template<class Predicate>
+  void DescriptorSetCache::ReleaseIf(Predicate referencesObject)
+  {
+    for (auto it = sets.begin(); it != sets.end();)
+    {
+      const std::vector<DescriptorBindingKey>& bindings = it->first.bindings;
+
+      if (std::any_of(bindings.begin(), bindings.end(), referencesObject))
+      {
+        it = sets.erase(it);
+        ++statistics.releasedCount;
+      }
+      else
+        ++it;
+    }
+  }
+
+  void DescriptorSetCache::Release(vk::ImageView view)
+  {
+    ReleaseIf([view](const DescriptorBindingKey& b) { return b.imageView == view; });
+  }
+
+  void DescriptorSetCache::Release(vk::Buffer buffer)
+  {
+    ReleaseIf([buffer](const DescriptorBindingKey& b) { return b.buffer == buffer; });
+  }
+
+  DescriptorCacheStatistics DescriptorSetCache::GetStatistics() const
+  {
+    DescriptorCacheStatistics result = statistics;
+    result.setsCount = static_cast<uint32_t>(sets.size());
+
+    return result;
+  }
+}
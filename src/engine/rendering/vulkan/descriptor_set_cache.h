@@ -0,0 +1,100 @@
+#pragma once
+
+#include "descriptor_allocator.h"
+#include "shader_parsing.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace Vulkan
+{
+  //resource written into one binding, unused handles stay null
+  struct DescriptorBindingKey
+  {
+    uint32_t binding = 0;
+    vk::DescriptorType type = vk::DescriptorType::eSampler;
+    vk::Buffer buffer;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize range = 0;
+    vk::ImageView imageView;
+    vk::Sampler sampler;
+    vk::ImageLayout imageLayout = vk::ImageLayout::eUndefined;
+
+    bool operator==(const DescriptorBindingKey& r) const;
+  };
+
+  struct DescriptorSetKey
+  {
+    vk::DescriptorSetLayout layout;
+    std::vector<DescriptorBindingKey> bindings;
+
+    //computed once the bindings are set
+    uint64_t hash = 0;
+
+    void ComputeHash();
+
+    bool operator==(const DescriptorSetKey& r) const;
+  };
+
+  struct DescriptorCacheStatistics
+  {
+    uint32_t setsCount = 0;
+    uint64_t hitsCount = 0;
+    uint64_t missesCount = 0;
+    //times the cache was dropped for being over its budget
+    uint32_t flushesCount = 0;
+    //sets dropped because a resource they reference was destroyed
+    uint64_t releasedCount = 0;
+  };
+
+  //sets written once per set of resources and reused by the following frames, they are never updated.
+  //over the budget the whole cache is dropped with the allocator's pages in BeginFrame.
+  //keys hold raw handles, destroyed views and buffers have to be released,
+  //a new object with a reused handle would hit a set written for the old one
+  class DescriptorSetCache
+  {
+  public:
+    DescriptorSetCache(vk::Device device, DescriptorAllocator* allocator, uint32_t maxSetsCount);
+
+    DescriptorSetCache(const DescriptorSetCache&) = delete;
+    DescriptorSetCache& operator=(const DescriptorSetCache&) = delete;
+
+    void BeginFrame();
+
+    //null set when the key isn't cached
+    vk::DescriptorSet Find(const DescriptorSetKey& key);
+
+    //writes go into the new set, their destination set is overwritten
+    vk::DescriptorSet Insert(const DescriptorSetKey& key, const UniformSetDescription& set, std::vector<vk::WriteDescriptorSet>& writes);
+
+    //drops the sets referencing the object, they stay allocated until the allocator's reset but are never bound again
+    void Release(vk::ImageView view);
+
+    void Release(vk::Buffer buffer);
+
+    DescriptorCacheStatistics GetStatistics() const;
+
+  private:
+    template<class Predicate>
+    void ReleaseIf(Predicate referencesObject);
+
+    struct KeyHasher
+    {
+      size_t operator()(const DescriptorSetKey& key) const
+      {
+        return static_cast<size_t>(key.hash);
+      }
+    };
+
+  private:
+    vk::Device device;
+    DescriptorAllocator* allocator;
+    uint32_t maxSetsCount;
+
+    std::unordered_map<DescriptorSetKey, vk::DescriptorSet, KeyHasher> sets;
+
+    DescriptorCacheStatistics statistics;
+  };
+}
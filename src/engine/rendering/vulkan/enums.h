@@ -9,6 +9,7 @@ namespace Vulkan
     StencilOnlyAttachment,
     DepthStencilAttachment,
     SubpassInput,
-    OutputColorAttachment
+    OutputColorAttachment,
+    StorageImage
   };
 }
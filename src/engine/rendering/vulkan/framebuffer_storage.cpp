@@ -1,5 +1,7 @@
 #include "framebuffer_storage.h"
 
+#include <algorithm>
+
 namespace Vulkan
 {
   bool FramebufferKey::operator< (const FramebufferKey& r) const
@@ -69,4 +71,17 @@ namespace Vulkan
 
     return fb;
   }
+
+  void FramebufferStorage::ReleaseFramebuffers(vk::ImageView view)
+  {
+    for (auto it = storage.begin(); it != storage.end();)
+    {
+      const std::vector<vk::ImageView>& attachments = it->first.attachments;
+
+      if (std::find(attachments.begin(), attachments.end(), view) != attachments.end())
+        it = storage.erase(it);
+      else
+        ++it;
+    }
+  }
 }
@@ -1,6 +1,5 @@
 #pragma once
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
 
 #include <vector>
@@ -39,6 +38,9 @@ namespace Vulkan
 
     vk::Framebuffer AddNewFramebuffer(const FramebufferKey& key);
 
+    //destroys every framebuffer which has the view as an attachment
+    void ReleaseFramebuffers(vk::ImageView view);
+
   private:
     vk::Device logicalDevice;
     std::map<FramebufferKey, vk::UniqueFramebuffer> storage;
@@ -14,13 +14,33 @@ namespace Vulkan
     return renderGraph->GetImageView(id);
   }
 
+  vk::Buffer FrameContext::GetBuffer(const ResourceId& id) const
+  {
+    return renderGraph->GetBuffer(id);
+  }
+
   Pipeline* FrameContext::GetPipeline(const ShaderProgram& program, const VertexInputDeclaration& vertexInputDeclaration, vk::PrimitiveTopology topology, const DepthStencilSettings& depthStencilSettings, const RasterizationMode& rasterMode)
   {
     return pipelineStorage->GetPipeline(program, vertexInputDeclaration, topology, depthStencilSettings, rasterMode, *this);
   }
 
+  Pipeline* FrameContext::TryGetPipeline(const ShaderProgram& program, const VertexInputDeclaration& vertexInputDeclaration, vk::PrimitiveTopology topology, const DepthStencilSettings& depthStencilSettings, const RasterizationMode& rasterMode)
+  {
+    return pipelineStorage->TryGetPipeline(program, vertexInputDeclaration, topology, depthStencilSettings, rasterMode, *this);
+  }
+
   UniformsAccessor* FrameContext::GetUniformsAccessor(const ShaderProgram& program)
   {
     return uniformsAccessorStorage->GetUniformsAccessor(program);
   }
+
+  ComputePipeline* FrameContext::GetComputePipeline(const ComputeProgram& program)
+  {
+    return pipelineStorage->GetComputePipeline(program);
+  }
+
+  UniformsAccessor* FrameContext::GetUniformsAccessor(const ComputeProgram& program)
+  {
+    return uniformsAccessorStorage->GetUniformsAccessor(program);
+  }
 }
\ No newline at end of file
@@ -13,6 +13,8 @@ namespace Vulkan
   class ImageView;
   class Pipeline;
   class ShaderProgram;
+  class ComputeProgram;
+  class ComputePipeline;
   class VertexInputDeclaration;
 
   struct FrameContext
@@ -21,7 +23,12 @@ namespace Vulkan
 
     const ImageView& GetImageView(const ResourceId& id) const;
     Pipeline* GetPipeline(const ShaderProgram& program, const VertexInputDeclaration& vertexInputDeclaration, vk::PrimitiveTopology topology, const DepthStencilSettings& depthStencilSettings, const RasterizationMode& rasterMode);
+    //nullptr while the pipeline is compiled in the background, the draw can be skipped
+    Pipeline* TryGetPipeline(const ShaderProgram& program, const VertexInputDeclaration& vertexInputDeclaration, vk::PrimitiveTopology topology, const DepthStencilSettings& depthStencilSettings, const RasterizationMode& rasterMode);
     UniformsAccessor* GetUniformsAccessor(const ShaderProgram& program);
+    ComputePipeline* GetComputePipeline(const ComputeProgram& program);
+    UniformsAccessor* GetUniformsAccessor(const ComputeProgram& program);
+    vk::Buffer GetBuffer(const ResourceId& id) const;
 
     vk::Extent2D BackbufferSize;
     UniformsAccessorStorage* uniformsAccessorStorage;
@@ -31,6 +38,8 @@ namespace Vulkan
     vk::CommandBuffer commandBuffer;
     uint32_t subpassNumber;
     std::vector<vk::PipelineColorBlendAttachmentState> outputAttachmentBlendStates;
+    //interned by the pipeline storage, zero outside of render passes
+    uint32_t outputAttachmentBlendStatesId = 0;
 
   private:
     RenderGraph* renderGraph;
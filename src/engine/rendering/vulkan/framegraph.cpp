@@ -1,7 +1,155 @@
 #include "framegraph.h"
 #include "core.h"
 
+#include <engine/profiling/cpu_profiler.h>
+
+#include <algorithm>
 #include <iterator>
+#include <type_traits>
+
+namespace
+{
+  //evicted compiled graph isn't used for this many frames
+  constexpr uint64_t CompiledGraphEvictionDelay = 8;
+
+  //FNV-1a over the structural description of the graph,
+  //the description itself is kept to tell colliding graphs apart
+  class Fingerprint
+  {
+  public:
+    template<class T>
+    void Add(const T& value)
+    {
+      static_assert(std::is_trivially_copyable_v<T>);
+
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+      for (size_t i = 0; i < sizeof(T); ++i)
+      {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+      }
+
+      data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void Add(const std::string& str)
+    {
+      Add(str.size());
+      for (char c : str)
+        Add(c);
+    }
+
+    void Add(const Vulkan::ImageAttachment& attachment)
+    {
+      Add(attachment.id);
+      Add(attachment.format);
+      Add(attachment.type);
+      Add(attachment.initialLayout);
+      Add(attachment.finalLayout);
+      Add(attachment.loadOp);
+      Add(attachment.storeOp);
+      Add(static_cast<VkImageUsageFlags>(attachment.usageFlags));
+      Add(attachment.mayAlias);
+    }
+
+    inline Vulkan::RenderGraphKey Get()
+    {
+      return Vulkan::RenderGraphKey{ hash, std::move(data) };
+    }
+
+  private:
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<uint8_t> data;
+  };
+
+  //pipelines take viewport and scissor as dynamic state
+  void SetViewportAndScissor(vk::CommandBuffer cmd, const vk::Extent2D& extent)
+  {
+    const auto viewport = vk::Viewport()
+      .setX(0.0f)
+      .setY(0.0f)
+      .setWidth(static_cast<float>(extent.width))
+      .setHeight(static_cast<float>(extent.height))
+      .setMinDepth(0.0f)
+      .setMaxDepth(1.0f);
+
+    const auto scissor = vk::Rect2D()
+      .setOffset({ 0, 0 })
+      .setExtent(extent);
+
+    cmd.setViewport(0, 1, &viewport);
+    cmd.setScissor(0, 1, &scissor);
+  }
+
+  bool IsDepthStencil(Vulkan::ImageType type)
+  {
+    return type == Vulkan::ImageType::DepthOnlyAttachment || type == Vulkan::ImageType::DepthStencilAttachment || type == Vulkan::ImageType::StencilOnlyAttachment;
+  }
+
+  vk::ImageSubresourceRange GetAttachmentSubresourceRange(const Vulkan::ImageAttachment& attachment)
+  {
+    vk::ImageAspectFlags aspect;
+    switch (attachment.type)
+    {
+    case Vulkan::ImageType::DepthOnlyAttachment:
+      aspect = vk::ImageAspectFlagBits::eDepth;
+      break;
+
+    case Vulkan::ImageType::DepthStencilAttachment:
+      aspect = vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+      break;
+
+    case Vulkan::ImageType::StencilOnlyAttachment:
+      aspect = vk::ImageAspectFlagBits::eStencil;
+      break;
+
+    default:
+      aspect = vk::ImageAspectFlagBits::eColor;
+    }
+
+    return vk::ImageSubresourceRange()
+      .setAspectMask(aspect)
+      .setBaseMipLevel(0)
+      .setLevelCount(1)
+      .setBaseArrayLayer(0)
+      .setLayerCount(1);
+  }
+
+  vk::ClearValue GetClearValue(const Vulkan::ImageAttachment& attachment)
+  {
+    if (IsDepthStencil(attachment.type))
+      return vk::ClearDepthStencilValue(1.0f, 0.0f);
+    else
+      return vk::ClearColorValue{ std::array<float,4>{ 0.5529f, 0.6f, 0.6823f, 0.0f} };
+  }
+
+  bool HasWriteAccess(vk::AccessFlags access)
+  {
+    const vk::AccessFlags writeAccess = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+                                        vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eMemoryWrite;
+
+    return static_cast<bool>(access & writeAccess);
+  }
+
+  void AddDependency(std::map<std::pair<uint32_t, uint32_t>, vk::SubpassDependency>& deps, const vk::SubpassDependency& dep)
+  {
+    const auto key = std::make_pair(dep.srcSubpass, dep.dstSubpass);
+
+    auto it = deps.find(key);
+    if (it == deps.end())
+    {
+      deps[key] = dep;
+      return;
+    }
+
+    vk::SubpassDependency& merged = it->second;
+    merged.srcStageMask |= dep.srcStageMask;
+    merged.srcAccessMask |= dep.srcAccessMask;
+    merged.dstStageMask |= dep.dstStageMask;
+    merged.dstAccessMask |= dep.dstAccessMask;
+    merged.dependencyFlags &= dep.dependencyFlags;
+  }
+}
 
 namespace Vulkan
 {
@@ -13,7 +161,15 @@ namespace Vulkan
 
   RenderSubpass::RenderSubpass(unsigned int id)
     : id(id)
+    , name("subpass_" + std::to_string(id))
+    , parallelItemsCount(0)
+  {
+  }
+
+  RenderSubpass& RenderSubpass::SetName(const std::string& n)
   {
+    name = n;
+    return *this;
   }
 
   RenderSubpass& RenderSubpass::AddInputAttachment(const SubpassInput& desc)
@@ -30,8 +186,10 @@ namespace Vulkan
     return *this;
   }
 
-  RenderSubpass& RenderSubpass::AddInputBuffer()
+  RenderSubpass& RenderSubpass::AddInputBuffer(const ResourceId& id)
   {
+    inputBuffers.push_back(id);
+
     return *this;
   }
 
@@ -115,6 +273,110 @@ namespace Vulkan
     return *this;
   }
 
+  RenderSubpass& RenderSubpass::SetParallelRenderCallback(uint32_t itemsCount, ParallelRenderPassExecutionFunction callback)
+  {
+    parallelItemsCount = itemsCount;
+    parallelRenderCallback = callback;
+    return *this;
+  }
+
+  TransferNode::TransferNode(unsigned int id)
+    : id(id)
+    , name("transfer_" + std::to_string(id))
+  {
+  }
+
+  TransferNode& TransferNode::SetName(const std::string& n)
+  {
+    name = n;
+    return *this;
+  }
+
+  TransferNode& TransferNode::AddSource(const ResourceId& id)
+  {
+    sources.push_back(id);
+    return *this;
+  }
+
+  TransferNode& TransferNode::AddDestination(const ResourceId& id)
+  {
+    destinations.push_back(id);
+    return *this;
+  }
+
+  TransferNode& TransferNode::SetCallback(RenderPassExecutionFunction callback)
+  {
+    this->callback = callback;
+    return *this;
+  }
+
+  ComputeNode::ComputeNode(unsigned int id)
+    : id(id)
+    , name("compute_" + std::to_string(id))
+  {
+  }
+
+  ComputeNode& ComputeNode::SetName(const std::string& n)
+  {
+    name = n;
+    return *this;
+  }
+
+  ComputeNode& ComputeNode::AddInputSampler(const ResourceId& id)
+  {
+    inputSamplers.push_back(id);
+    return *this;
+  }
+
+  ComputeNode& ComputeNode::AddInputStorageImage(const ResourceId& id)
+  {
+    inputStorageImages.push_back(id);
+    return *this;
+  }
+
+  ComputeNode& ComputeNode::AddNewOutputStorageImage(const ResourceId& id, vk::Format format)
+  {
+    outputStorageImages.push_back(id);
+
+    ImageAttachment createInfo;
+    createInfo.id = id;
+    createInfo.format = format;
+    createInfo.type = ImageType::StorageImage;
+    createInfo.initialLayout = vk::ImageLayout::eUndefined;
+    createInfo.finalLayout = vk::ImageLayout::eGeneral;
+    createInfo.loadOp = vk::AttachmentLoadOp::eDontCare;
+    createInfo.storeOp = vk::AttachmentStoreOp::eStore;
+    createInfo.usageFlags = vk::ImageUsageFlagBits::eStorage;
+
+    imageCreateInfos.push_back(createInfo);
+
+    return *this;
+  }
+
+  ComputeNode& ComputeNode::AddExistOutputStorageImage(const ResourceId& id)
+  {
+    outputStorageImages.push_back(id);
+    return *this;
+  }
+
+  ComputeNode& ComputeNode::AddInputStorageBuffer(const ResourceId& id)
+  {
+    inputBuffers.push_back(id);
+    return *this;
+  }
+
+  ComputeNode& ComputeNode::AddOutputStorageBuffer(const ResourceId& id)
+  {
+    outputBuffers.push_back(id);
+    return *this;
+  }
+
+  ComputeNode& ComputeNode::SetCallback(RenderPassExecutionFunction callback)
+  {
+    this->callback = callback;
+    return *this;
+  }
+
   std::optional<SubpassResourceType> RenderSubpass::GetResourceTypeFromId(const ResourceId& resourceId) const
   {
     for (const ResourceId& id : outputColorAttachments)
@@ -126,6 +388,11 @@ namespace Vulkan
 
   RenderGraph::RenderGraph(Core& core)
     : core(core)
+    , threadResources(nullptr)
+    , isAfterComputeRecorded(false)
+    , frameProfilerScope(GPU_PROFILER_INVALID_QUERY)
+    , transientSet(nullptr)
+    , compiledGraph(nullptr)
   {
   }
 
@@ -133,276 +400,1484 @@ namespace Vulkan
   {
     const unsigned id = static_cast<unsigned int>(subpasses.size());
     subpasses.push_back(RenderSubpass{ id });
+    nodes.push_back(RenderGraphNode{ RenderGraphNodeType::RenderSubpass, id });
 
     return subpasses.back();
   }
 
-  void RenderGraph::Compile()
+  TransferNode& RenderGraph::AddTransferNode()
   {
-    AllocateSubpassesResources();
+    const unsigned id = static_cast<unsigned int>(transferNodes.size());
+    transferNodes.push_back(TransferNode{ id });
+    nodes.push_back(RenderGraphNode{ RenderGraphNodeType::Transfer, id });
 
-    this->renderPass = CreateRenderpass();
-    this->framebuffer = CreateFramebuffer();
+    return transferNodes.back();
   }
 
-  std::vector<vk::SubpassDependency> RenderGraph::GetSubpassDependencies() const
+  ComputeNode& RenderGraph::AddComputeNode()
   {
-    std::vector<vk::SubpassDependency> deps = GetAttachmentDependencies();
-    std::copy(m_ManualSetDependency.begin(), m_ManualSetDependency.end(), std::back_inserter(deps));
+    const unsigned id = static_cast<unsigned int>(computeNodes.size());
+    computeNodes.push_back(ComputeNode{ id });
+    nodes.push_back(RenderGraphNode{ RenderGraphNodeType::Compute, id });
 
-    return deps;
+    return computeNodes.back();
   }
 
-  std::vector<vk::SubpassDependency> RenderGraph::GetAttachmentDependencies() const
+  void RenderGraph::Compile()
   {
-    std::vector<vk::SubpassDependency> deps;
+    PROFILE_ZONE("RenderGraph::Compile");
 
-    std::map<ResourceId, SubpassId> ResourceIdToSubpassProducerMap;
+    const uint64_t frame = core.GetFrameNumber();
+    RenderGraphKey key = GetKey();
 
-    for (const RenderSubpass& subpass : subpasses)
+    //the hash only picks the entry, a colliding graph replaces it
+    CachedRenderGraph& cached = compiledGraphs[key.hash];
+    if (cached.key != key.data)
     {
-      for (const ResourceId& outputAttachmentId : subpass.outputColorAttachments)
-      {
-        ResourceIdToSubpassProducerMap[outputAttachmentId] = subpass.id;
-      }
+      cached.key = std::move(key.data);
+      cached.graph = CompileGraph();
     }
+    cached.lastUsedFrame = frame;
 
-    for (const RenderSubpass& subpass : subpasses)
+    for (auto it = compiledGraphs.begin(); it != compiledGraphs.end();)
     {
-      std::set<SubpassId> parents;
-      for (const SubpassInput& inputAttachment : subpass.inputAttachments)
-      {
-        parents.insert(ResourceIdToSubpassProducerMap[inputAttachment.id]);
-      }
-
-      for (SubpassId parentId : parents)
-      {
-        const SubpassId src = subpass.id < parentId ? subpass.id : parentId;
-        const SubpassId dst = subpass.id > parentId ? subpass.id : parentId;
-
-        const auto dep = vk::SubpassDependency()
-          .setSrcSubpass(src)
-          .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-          .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-          .setDstSubpass(dst)
-          .setDstAccessMask(vk::AccessFlagBits::eInputAttachmentRead)
-          .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader);
-
-        deps.push_back(dep);
-      }
+      if (frame - it->second.lastUsedFrame > CompiledGraphEvictionDelay)
+        it = compiledGraphs.erase(it);
+      else
+        ++it;
     }
 
-    return deps;
+    compiledGraph = &cached.graph;
+    AcquireAttachments(*compiledGraph);
+
+    //framebuffers with the backbuffer are created once it is acquired
+    framebuffers.assign(compiledGraph->passes.size(), vk::Framebuffer{});
+    CreateFramebuffers(0, compiledGraph->backbufferPass);
   }
 
-  void RenderGraph::AddAttachmentResource(const ImageAttachment& attachment)
+  RenderGraphKey RenderGraph::GetKey() const
   {
-    if (resourceIdToAttachmentIdMap.find(attachment.id) != resourceIdToAttachmentIdMap.end())
-      throw std::runtime_error("AddAttachmentResource: resource with such id already exist");
+    Fingerprint fp;
 
-    const AttachmentId attId = static_cast<AttachmentId>(imageAttachments.size());
-    imageAttachments.push_back(attachment);
-    resourceIdToAttachmentIdMap[attachment.id] = attId;
-  }
+    fp.Add(backbufferDescription.format);
+    fp.Add(backbufferDescription.size.width);
+    fp.Add(backbufferDescription.size.height);
 
-  void RenderGraph::SetBackbufferDescription(const BackbufferDescription& bfDescription)
-  {
-    backbufferDescription = bfDescription;
-  }
+    fp.Add(imageAttachments.size());
+    for (const ImageAttachment& attachment : imageAttachments)
+      fp.Add(attachment);
 
-  void RenderGraph::SetCommandBuffer(vk::CommandBuffer cmdBuf)
-  {
-    cmdBuffer = cmdBuf;
-  }
+    fp.Add(nodes.size());
+    for (const RenderGraphNode& node : nodes)
+    {
+      fp.Add(node.type);
+      fp.Add(node.index);
+    }
 
-  void RenderGraph::SetUniformsAccessorStorage(UniformsAccessorStorage* s)
-  {
-    uaStorage = s;
-  }
+    for (const RenderSubpass& subpass : subpasses)
+    {
+      fp.Add(subpass.inputAttachments.size());
+      for (const SubpassInput& input : subpass.inputAttachments)
+      {
+        fp.Add(input.id);
+        fp.Add(input.layout);
+      }
 
-  void RenderGraph::Reset()
-  {
-    subpasses.clear();
-    resourceIdToAttachmentIdMap.clear();
-    imageAttachments.clear();
-    ownedImages.clear();
-    m_ManualSetDependency.clear();
-  }
+      fp.Add(subpass.inputSamplers.size());
+      for (const ResourceId& id : subpass.inputSamplers)
+        fp.Add(id);
 
-  void RenderGraph::Execute()
-  {
-    std::vector<vk::ClearValue> clearColors = GetClearColorsForImageAttachments();
+      fp.Add(subpass.inputBuffers.size());
+      for (const ResourceId& id : subpass.inputBuffers)
+        fp.Add(id);
 
-    const auto rpBeginInfo = vk::RenderPassBeginInfo()
-      .setRenderPass(renderPass)
-      .setFramebuffer(framebuffer)
-      .setRenderArea(vk::Rect2D{ {0,0}, backbufferDescription.size })
-      .setClearValueCount(clearColors.size())
-      .setPClearValues(clearColors.data());
+      fp.Add(subpass.outputColorAttachments.size());
+      for (const ResourceId& id : subpass.outputColorAttachments)
+        fp.Add(id);
 
-    cmdBuffer.begin(vk::CommandBufferBeginInfo());
-    cmdBuffer.beginRenderPass(rpBeginInfo, vk::SubpassContents::eInline);
+      fp.Add(subpass.imageAttachmentCreateInfos.size());
+      for (const ImageAttachment& attachment : subpass.imageAttachmentCreateInfos)
+        fp.Add(attachment);
 
-    FrameContext context;
-    context.BackbufferSize = backbufferDescription.size;
-    context.uniformsAccessorStorage = uaStorage;
-    context.pipelineStorage = &core.GetPipelineStorage();
-    context.framebuffer = framebuffer;
-    context.renderPass = renderPass;
-    context.commandBuffer = cmdBuffer;
-    context.renderGraph = this;
+      fp.Add(subpass.depthStencilAttachment.has_value());
+      if (subpass.depthStencilAttachment.has_value())
+        fp.Add(subpass.depthStencilAttachment.value());
+    }
 
-    for (int i = 0; i < subpasses.size(); ++i)
+    for (const TransferNode& node : transferNodes)
     {
-      const RenderSubpass& subpass = subpasses[i];
+      fp.Add(node.sources.size());
+      for (const ResourceId& id : node.sources)
+        fp.Add(id);
 
-      context.subpassNumber = subpass.id;
-      context.outputAttachmentBlendStates = subpass.outputAttachmentBlendStates;
+      fp.Add(node.destinations.size());
+      for (const ResourceId& id : node.destinations)
+        fp.Add(id);
+    }
 
-      subpass.renderCallback(context);
+    for (const ComputeNode& node : computeNodes)
+    {
+      for (const std::vector<ResourceId>* ids : { &node.inputSamplers, &node.inputStorageImages, &node.outputStorageImages, &node.inputBuffers, &node.outputBuffers })
+      {
+        fp.Add(ids->size());
+        for (const ResourceId& id : *ids)
+          fp.Add(id);
+      }
 
-      if (i != (subpasses.size() - 1))
-        cmdBuffer.nextSubpass(vk::SubpassContents::eInline);
+      fp.Add(node.imageCreateInfos.size());
+      for (const ImageAttachment& attachment : node.imageCreateInfos)
+        fp.Add(attachment);
     }
 
-    cmdBuffer.endRenderPass();
-    cmdBuffer.end();
+    //handles change every frame, the structure depends on the names only
+    fp.Add(buffers.size());
+    for (const auto& [id, _] : buffers)
+      fp.Add(id);
+
+    fp.Add(m_ManualSetDependency.size());
+    for (const vk::SubpassDependency& dep : m_ManualSetDependency)
+      fp.Add(static_cast<const VkSubpassDependency&>(dep));
+
+    return fp.Get();
   }
 
-  std::vector<vk::ClearValue> RenderGraph::GetClearColorsForImageAttachments() const
+  CompiledRenderGraph RenderGraph::CompileGraph()
   {
-    std::vector<vk::ClearValue> clearColors;
-    for (const ImageAttachment& img : imageAttachments)
-    {
-      vk::ClearValue clearValue;
+    AddSubpassesResources();
 
-      if (img.type == ImageType::DepthOnlyAttachment || img.type == ImageType::DepthStencilAttachment || img.type == ImageType::StencilOnlyAttachment)
-        clearValue = vk::ClearDepthStencilValue(1.0f, 0.0f);
-      else
-        clearValue = vk::ClearColorValue{ std::array<float,4>{ 0.5529f, 0.6f, 0.6823f, 0.0f} };
+    const std::map<ResourceId, ResourceLifetime> lifetimes = GetResourceLifetimes();
+    InferAttachmentsUsage(lifetimes);
+    asyncNodes = ScheduleAsyncCompute();
+    AliasTransientAttachments(lifetimes);
+
+    CompiledRenderGraph compiled;
+    CompilePasses(lifetimes, compiled);
+    compiled.resourceIdToAttachmentIdMap = resourceIdToAttachmentIdMap;
+    compiled.imageAttachments = imageAttachments;
+    compiled.transientSetKey = transientSetKey;
+    compiled.transientSetIndices = transientSetIndices;
+
+    compiled.backbufferPass = static_cast<uint32_t>(compiled.passes.size());
 
-      clearColors.push_back(clearValue);
+    const auto backbufferLifetime = lifetimes.find(BACKBUFFER_RESOURCE_ID);
+    if (backbufferLifetime != lifetimes.end())
+    {
+      compiled.backbufferPass = nodePasses[backbufferLifetime->second.firstUse];
+
+      const AttachmentId backbufferId = resourceIdToAttachmentIdMap.at(BACKBUFFER_RESOURCE_ID);
+      for (const ResourceUsage& usage : GetNodeUsages(nodes[backbufferLifetime->second.firstUse]))
+        if (usage.attachment == backbufferId)
+          compiled.backbufferWaitStages |= usage.stages;
     }
 
-    return clearColors;
+    return compiled;
   }
 
-  vk::RenderPass RenderGraph::CreateRenderpass()
+  void RenderGraph::AcquireAttachments(const CompiledRenderGraph& compiled)
   {
-    //describe subbpasses and it's attachment references
-    std::vector<SubpassKey> subpassKeys;
-    for (const RenderSubpass& subpass : subpasses)
+    std::vector<ImageAttachment> attachments = compiled.imageAttachments;
+    transientSet = core.GetTransientAttachmentPool().Acquire(compiled.transientSetKey);
+
+    for (size_t i = 0; i < attachments.size(); ++i)
     {
-      SubpassKey subkey;
+      ImageAttachment& attachment = attachments[i];
+      const std::optional<uint32_t>& setIndex = compiled.transientSetIndices[i];
 
-      for (const SubpassInput& inputDesc : subpass.inputAttachments)
+      if (setIndex.has_value())
       {
-        AttachmentId attId = resourceIdToAttachmentIdMap[inputDesc.id];
-
-        subkey.inputAttachmentReferences.push_back(
-          vk::AttachmentReference()
-          .setAttachment(attId)
-          .setLayout(inputDesc.layout)
-        );
+        attachment.view = transientSet->views[setIndex.value()];
       }
-
-      for (const ResourceId& outputId : subpass.outputColorAttachments)
+      else
       {
-        AttachmentId attId = resourceIdToAttachmentIdMap[outputId];
-
-        subkey.outputColorAttachmentReferences.push_back(
-          vk::AttachmentReference()
-          .setAttachment(attId)
-          .setLayout(vk::ImageLayout::eColorAttachmentOptimal)
-        );
+        //external attachments are added before every compilation
+        attachment.view = imageAttachments[resourceIdToAttachmentIdMap.at(attachment.id)].view;
       }
+    }
 
-      if (subpass.depthStencilAttachment.has_value())
-      {
-        const ResourceId& id = subpass.depthStencilAttachment.value().id;
-        AttachmentId attId = resourceIdToAttachmentIdMap[id];
+    imageAttachments = std::move(attachments);
+    resourceIdToAttachmentIdMap = compiled.resourceIdToAttachmentIdMap;
+  }
 
-        subkey.depthStencilAttachmentReference = vk::AttachmentReference()
-          .setAttachment(attId)
-          .setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
-      }
+  void RenderGraph::CreateFramebuffers(uint32_t firstPass, uint32_t endPass)
+  {
+    for (uint32_t passIndex = firstPass; passIndex < endPass; ++passIndex)
+    {
+      const CompiledPass& pass = compiledGraph->passes[passIndex];
+      if (pass.type != CompiledPassType::Render)
+        continue;
 
-      subpassKeys.push_back(std::move(subkey));
-    }
+      std::vector<vk::ImageView> views;
+      views.reserve(pass.attachments.size());
 
-    std::vector<vk::SubpassDependency> deps = GetSubpassDependencies();
+      for (AttachmentId attId : pass.attachments)
+        views.push_back(imageAttachments[attId].view.Get());
 
-    const auto rpKey = RenderPassKey()
-      .SetBackbufferFormat(backbufferDescription.format)
-      .SetDependencies(deps)
-      .SetSubpassesDescriptions(subpassKeys)
-      .SetImageAttachments(imageAttachments);
+      const auto fbKey = FramebufferKey()
+        .SetAttachments(views)
+        .SetHeight(backbufferDescription.size.height)
+        .SetWidth(backbufferDescription.size.width)
+        .SetLayers(1)
+        .SetRenderPass(pass.renderPass);
 
-    return core.GetRenderPassStorage().GetRenderPass(rpKey);
+      framebuffers[passIndex] = core.GetFramebufferStorage().GetFramebuffer(fbKey);
+    }
   }
 
-  vk::Framebuffer RenderGraph::CreateFramebuffer()
+  std::vector<ResourceUsage> RenderGraph::GetNodeUsages(const RenderGraphNode& node) const
   {
-    std::vector<vk::ImageView> views;
-    views.reserve(imageAttachments.size());
-
-    for (const ImageAttachment& img : imageAttachments)
-      views.push_back(img.view.Get());
+    std::vector<ResourceUsage> usages;
 
-    const auto fbKey = FramebufferKey()
-      .SetAttachments(views)
-      .SetHeight(backbufferDescription.size.height)
-      .SetWidth(backbufferDescription.size.width)
-      .SetLayers(1)
-      .SetRenderPass(renderPass);
+    auto getAttachmentId = [&](const ResourceId& id)
+    {
+      const auto it = resourceIdToAttachmentIdMap.find(id);
+      if (it == resourceIdToAttachmentIdMap.end())
+        throw std::runtime_error("RenderGraph::GetNodeUsages: unknown resource " + id);
 
-    return core.GetFramebufferStorage().GetFramebuffer(fbKey);
-  }
+      return it->second;
+    };
 
-  void RenderGraph::AllocateSubpassesResources()
-  {
-    for (const RenderSubpass& subpass : subpasses)
+    if (node.type == RenderGraphNodeType::Transfer)
     {
-      for (ImageAttachment createInfo : subpass.imageAttachmentCreateInfos)
-      {
-        if (resourceIdToAttachmentIdMap.find(createInfo.id) != resourceIdToAttachmentIdMap.end())
-          throw std::runtime_error("AllocateSubpassesResources: can't add a new resource: index already in use.");
+      const TransferNode& transfer = transferNodes[node.index];
 
-        if (createInfo.format == vk::Format::eUndefined)
-          createInfo.format = backbufferDescription.format;
+      for (const ResourceId& id : transfer.sources)
+        usages.push_back({ getAttachmentId(id), vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead, false });
 
-        Image img = core.Allocate2DImage(createInfo.format, backbufferDescription.size, createInfo.usageFlags);
-        createInfo.view = img.GetView();
-        AddAttachmentResource(createInfo);
-        ownedImages.push_back(std::move(img));
-      }
+      for (const ResourceId& id : transfer.destinations)
+        usages.push_back({ getAttachmentId(id), vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, false });
 
-      if (subpass.depthStencilAttachment.has_value())
-      {
-        ImageAttachment createInfo = subpass.depthStencilAttachment.value();
-        assert(createInfo.type == ImageType::DepthOnlyAttachment || createInfo.type == ImageType::DepthStencilAttachment);
+      return usages;
+    }
 
-        if (resourceIdToAttachmentIdMap.find(createInfo.id) != resourceIdToAttachmentIdMap.end())
-          throw std::runtime_error("AllocateSubpassesResources: can't add a new depth|stencil resource: index already in use.");
+    if (node.type == RenderGraphNodeType::Compute)
+    {
+      const ComputeNode& compute = computeNodes[node.index];
 
-        const vk::ImageAspectFlags aspectFlags = (createInfo.type == ImageType::DepthOnlyAttachment)
-          ? vk::ImageAspectFlagBits::eDepth
-          : vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+      for (const ResourceId& id : compute.inputSamplers)
+        usages.push_back({ getAttachmentId(id), vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead, false });
 
-        Image img = core.AllocateDepthStencilImage(createInfo.format, backbufferDescription.size, createInfo.usageFlags, aspectFlags);
-        createInfo.view = img.GetView();
-        AddAttachmentResource(createInfo);
-        ownedImages.push_back(std::move(img));
-      }
+      for (const ResourceId& id : compute.inputStorageImages)
+        usages.push_back({ getAttachmentId(id), vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead, false });
+
+      for (const ResourceId& id : compute.outputStorageImages)
+        usages.push_back({ getAttachmentId(id), vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader,
+                           vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, false });
+
+      return usages;
     }
+
+    const RenderSubpass& subpass = subpasses[node.index];
+
+    //descriptors of graph attachments are written with a read only layout
+    for (const ResourceId& id : subpass.inputSamplers)
+      usages.push_back({ getAttachmentId(id), vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead, false });
+
+    for (const SubpassInput& input : subpass.inputAttachments)
+      usages.push_back({ getAttachmentId(input.id), input.layout, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eInputAttachmentRead, true });
+
+    for (const ResourceId& id : subpass.outputColorAttachments)
+      usages.push_back({ getAttachmentId(id), vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                         vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite, true });
+
+    if (subpass.depthStencilAttachment.has_value())
+      usages.push_back({ getAttachmentId(subpass.depthStencilAttachment->id), vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                         vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                         vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite, true });
+
+    return usages;
   }
 
-  const ImageView& RenderGraph::GetImageView(const ResourceId& id) const
+  std::vector<BufferUsage> RenderGraph::GetNodeBufferUsages(const RenderGraphNode& node) const
   {
-    const AttachmentId attId = resourceIdToAttachmentIdMap.at(id);
-    const ImageAttachment& attachment = imageAttachments[attId];
+    std::vector<BufferUsage> usages;
 
-    return attachment.view;
+    auto checkBuffer = [&](const ResourceId& id)
+    {
+      if (buffers.find(id) == buffers.end())
+        throw std::runtime_error("RenderGraph::GetNodeBufferUsages: unknown buffer " + id);
+
+      return id;
+    };
+
+    switch (node.type)
+    {
+    case RenderGraphNodeType::RenderSubpass:
+      for (const ResourceId& id : subpasses[node.index].inputBuffers)
+        usages.push_back({ checkBuffer(id), vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead });
+      break;
+
+    case RenderGraphNodeType::Compute:
+      for (const ResourceId& id : computeNodes[node.index].inputBuffers)
+        usages.push_back({ checkBuffer(id), vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead });
+
+      for (const ResourceId& id : computeNodes[node.index].outputBuffers)
+        usages.push_back({ checkBuffer(id), vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite });
+      break;
+
+    default:
+      break;
+    }
+
+    return usages;
+  }
+
+  std::vector<bool> RenderGraph::ScheduleAsyncCompute() const
+  {
+    std::vector<bool> isAsync(nodes.size(), false);
+
+    if (!core.HasAsyncCompute())
+      return isAsync;
+
+    //resources already touched by the graphics queue this frame
+    std::set<AttachmentId> graphicsImages;
+    std::set<ResourceId> graphicsBuffers;
+
+    for (uint32_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+    {
+      const RenderGraphNode& node = nodes[nodeIndex];
+      const std::vector<ResourceUsage> usages = GetNodeUsages(node);
+      const std::vector<BufferUsage> bufferUsages = GetNodeBufferUsages(node);
+
+      if (node.type == RenderGraphNodeType::Compute)
+      {
+        //external images are owned by the graphics queue
+        bool canRunAsync = true;
+        for (const ResourceUsage& usage : usages)
+          if (transientAttachmentKeys[usage.attachment].has_value() == false || graphicsImages.count(usage.attachment) != 0)
+            canRunAsync = false;
+
+        for (const BufferUsage& usage : bufferUsages)
+          if (graphicsBuffers.count(usage.buffer) != 0)
+            canRunAsync = false;
+
+        isAsync[nodeIndex] = canRunAsync;
+      }
+
+      if (isAsync[nodeIndex])
+        continue;
+
+      for (const ResourceUsage& usage : usages)
+        graphicsImages.insert(usage.attachment);
+
+      for (const BufferUsage& usage : bufferUsages)
+        graphicsBuffers.insert(usage.buffer);
+    }
+
+    return isAsync;
+  }
+
+  std::vector<std::vector<uint32_t>> RenderGraph::GroupNodesIntoPasses() const
+  {
+    std::vector<std::vector<uint32_t>> passes;
+
+    //resources of the render pass being gathered
+    std::set<AttachmentId> passAttachments;
+    std::set<AttachmentId> passSampled;
+    bool isRenderPassOpen = false;
+
+    for (uint32_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+    {
+      const RenderGraphNode& node = nodes[nodeIndex];
+
+      if (node.type != RenderGraphNodeType::RenderSubpass)
+      {
+        passes.push_back({ nodeIndex });
+        isRenderPassOpen = false;
+        continue;
+      }
+
+      const std::vector<ResourceUsage> usages = GetNodeUsages(node);
+
+      //an image can't be sampled and be an attachment of the same render pass
+      bool needsNewPass = !isRenderPassOpen;
+      for (const ResourceUsage& usage : usages)
+      {
+        if (usage.isAttachment && passSampled.count(usage.attachment) != 0)
+          needsNewPass = true;
+
+        if (!usage.isAttachment && passAttachments.count(usage.attachment) != 0)
+          needsNewPass = true;
+      }
+
+      if (needsNewPass)
+      {
+        passes.push_back({});
+        passAttachments.clear();
+        passSampled.clear();
+        isRenderPassOpen = true;
+      }
+
+      passes.back().push_back(nodeIndex);
+      for (const ResourceUsage& usage : usages)
+      {
+        if (usage.isAttachment)
+          passAttachments.insert(usage.attachment);
+        else
+          passSampled.insert(usage.attachment);
+      }
+    }
+
+    return passes;
+  }
+
+  std::map<ResourceId, ResourceLifetime> RenderGraph::GetResourceLifetimes() const
+  {
+    std::map<ResourceId, ResourceLifetime> lifetimes;
+
+    for (uint32_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+    {
+      for (const ResourceUsage& usage : GetNodeUsages(nodes[nodeIndex]))
+      {
+        ResourceLifetime& lifetime = lifetimes[imageAttachments[usage.attachment].id];
+        lifetime.firstUse = std::min(lifetime.firstUse, nodeIndex);
+        lifetime.lastUse = std::max(lifetime.lastUse, nodeIndex);
+      }
+    }
+
+    return lifetimes;
+  }
+
+  void RenderGraph::InferAttachmentsUsage(const std::map<ResourceId, ResourceLifetime>& lifetimes)
+  {
+    const std::vector<std::vector<uint32_t>> passes = GroupNodesIntoPasses();
+
+    nodePasses.assign(nodes.size(), 0);
+    for (uint32_t passIndex = 0; passIndex < passes.size(); ++passIndex)
+      for (uint32_t nodeIndex : passes[passIndex])
+        nodePasses[nodeIndex] = passIndex;
+
+    std::vector<vk::ImageUsageFlags> extraUsage(imageAttachments.size());
+    for (const RenderGraphNode& node : nodes)
+    {
+      for (const ResourceUsage& usage : GetNodeUsages(node))
+      {
+        if (usage.layout == vk::ImageLayout::eTransferSrcOptimal)
+          extraUsage[usage.attachment] |= vk::ImageUsageFlagBits::eTransferSrc;
+        else if (usage.layout == vk::ImageLayout::eTransferDstOptimal)
+          extraUsage[usage.attachment] |= vk::ImageUsageFlagBits::eTransferDst;
+        else if (usage.layout == vk::ImageLayout::eGeneral)
+          extraUsage[usage.attachment] |= vk::ImageUsageFlagBits::eStorage;
+        else if (!usage.isAttachment)
+          extraUsage[usage.attachment] |= vk::ImageUsageFlagBits::eSampled;
+      }
+    }
+
+    for (AttachmentId attId = 0; attId < imageAttachments.size(); ++attId)
+    {
+      //external attachments are consumed outside of the graph, keep what the owner asked for
+      if (transientAttachmentKeys[attId].has_value() == false)
+        continue;
+
+      ImageAttachment& attachment = imageAttachments[attId];
+      TransientAttachmentKey& key = transientAttachmentKeys[attId].value();
+
+      const auto lifetime = lifetimes.find(attachment.id);
+      if (lifetime == lifetimes.end())
+        throw std::runtime_error("RenderGraph::InferAttachmentsUsage: attachment isn't used by any subpass.");
+
+      //contents never leave a single render pass
+      const bool isTransient = extraUsage[attId] == vk::ImageUsageFlags{} &&
+                               nodePasses[lifetime->second.firstUse] == nodePasses[lifetime->second.lastUse];
+
+      attachment.usageFlags |= extraUsage[attId];
+      if (isTransient)
+        attachment.usageFlags |= vk::ImageUsageFlagBits::eTransientAttachment;
+      else
+        attachment.usageFlags &= ~vk::ImageUsageFlags(vk::ImageUsageFlagBits::eTransientAttachment);
+
+      key.usage = attachment.usageFlags;
+    }
+  }
+
+  void RenderGraph::AliasTransientAttachments(const std::map<ResourceId, ResourceLifetime>& lifetimes)
+  {
+    //async compute runs next to the graphics work recorded before it, node order says nothing about its lifetime
+    std::set<AttachmentId> asyncAttachments;
+    for (uint32_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+      if (asyncNodes[nodeIndex])
+        for (const ResourceUsage& usage : GetNodeUsages(nodes[nodeIndex]))
+          asyncAttachments.insert(usage.attachment);
+
+    std::vector<AttachmentId> transientIds;
+    for (AttachmentId attId = 0; attId < imageAttachments.size(); ++attId)
+      if (transientAttachmentKeys[attId].has_value())
+        transientIds.push_back(attId);
+
+    std::sort(transientIds.begin(), transientIds.end(), [&](AttachmentId l, AttachmentId r) {
+      return lifetimes.at(imageAttachments[l].id).firstUse < lifetimes.at(imageAttachments[r].id).firstUse;
+    });
+
+    //first fit: attachment goes to the first memory whose previous owner is already dead
+    std::vector<std::vector<AttachmentId>> groups;
+    for (AttachmentId attId : transientIds)
+    {
+      const ResourceLifetime& lifetime = lifetimes.at(imageAttachments[attId].id);
+
+      auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<AttachmentId>& g) {
+        return lifetimes.at(imageAttachments[g.back()].id).lastUse < lifetime.firstUse && asyncAttachments.count(g.back()) == 0;
+      });
+
+      if (asyncAttachments.count(attId) != 0)
+        group = groups.end();
+
+      if (group == groups.end())
+        groups.push_back({ attId });
+      else
+        group->push_back(attId);
+    }
+
+    transientSetKey = TransientAttachmentSetKey{};
+    transientSetIndices.assign(imageAttachments.size(), std::nullopt);
+    aliasPredecessors.assign(imageAttachments.size(), std::nullopt);
+
+    for (uint32_t groupIndex = 0; groupIndex < groups.size(); ++groupIndex)
+    {
+      const std::vector<AttachmentId>& group = groups[groupIndex];
+
+      for (size_t i = 0; i < group.size(); ++i)
+      {
+        const AttachmentId attId = group[i];
+
+        transientSetIndices[attId] = static_cast<uint32_t>(transientSetKey.attachments.size());
+        transientSetKey.attachments.push_back(transientAttachmentKeys[attId].value());
+        transientSetKey.memoryGroups.push_back(groupIndex);
+
+        if (i > 0)
+          aliasPredecessors[attId] = group[i - 1];
+      }
+    }
+  }
+
+  void RenderGraph::CompilePasses(const std::map<ResourceId, ResourceLifetime>& lifetimes, CompiledRenderGraph& compiled)
+  {
+    struct ResourceState
+    {
+      vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+      vk::PipelineStageFlags stages;
+      vk::AccessFlags access;
+      bool used = false;
+    };
+
+    //global subpass id -> [pass, subpass inside of the pass]
+    std::map<SubpassId, std::pair<uint32_t, uint32_t>> subpassLocations;
+
+    std::vector<ResourceState> states(imageAttachments.size());
+    for (AttachmentId attId = 0; attId < imageAttachments.size(); ++attId)
+      if (transientAttachmentKeys[attId].has_value() == false)
+        states[attId].layout = imageAttachments[attId].initialLayout;
+
+    auto transition = [&](CompiledBarrier& barrier, AttachmentId attId, vk::ImageLayout layout, vk::PipelineStageFlags stages, vk::AccessFlags access)
+    {
+      ResourceState& state = states[attId];
+
+      //reading what was read before in the same layout doesn't need anything
+      const bool isHazard = HasWriteAccess(state.access) || (HasWriteAccess(access) && state.stages);
+      if (state.layout == layout && (!isHazard || !state.used))
+        return false;
+
+      //first use of an external image chains with the semaphore waited at the same stages
+      if (state.used)
+        barrier.srcStages |= state.stages;
+      else
+        barrier.srcStages |= stages;
+
+      barrier.dstStages |= stages;
+      barrier.imageBarriers.push_back({ attId, state.layout, layout, state.access, access });
+      return true;
+    };
+
+    auto handOverAliasedMemory = [&](CompiledBarrier& barrier, AttachmentId attId, vk::PipelineStageFlags stages, vk::AccessFlags access)
+    {
+      if (aliasPredecessors[attId].has_value() == false)
+        return;
+
+      const ResourceState& predecessor = states[aliasPredecessors[attId].value()];
+
+      barrier.hasMemoryBarrier = true;
+      barrier.srcStages |= predecessor.stages;
+      barrier.memorySrcAccess |= predecessor.access;
+      barrier.dstStages |= stages;
+      barrier.memoryDstAccess |= access;
+    };
+
+    struct BufferState
+    {
+      vk::PipelineStageFlags stages;
+      vk::AccessFlags access;
+    };
+
+    std::map<ResourceId, BufferState> bufferStates;
+
+    auto accessBuffer = [&](CompiledBarrier& barrier, const BufferUsage& usage)
+    {
+      BufferState& state = bufferStates[usage.buffer];
+
+      const bool isHazard = HasWriteAccess(state.access) || (HasWriteAccess(usage.access) && state.stages);
+      if (!isHazard)
+      {
+        state.stages |= usage.stages;
+        state.access |= usage.access;
+        return;
+      }
+
+      barrier.hasMemoryBarrier = true;
+      barrier.srcStages |= state.stages;
+      barrier.memorySrcAccess |= state.access;
+      barrier.dstStages |= usage.stages;
+      barrier.memoryDstAccess |= usage.access;
+
+      state = BufferState{ usage.stages, usage.access };
+    };
+
+    const std::vector<std::vector<uint32_t>> passes = GroupNodesIntoPasses();
+    std::vector<CompiledPass>& compiledPasses = compiled.passes;
+
+    //resources of the async compute, graphics passes using them wait for its semaphore
+    const uint32_t graphicsFamily = core.GetGraphicsFamilyIndex();
+    const uint32_t computeFamily = core.GetComputeFamilyIndex();
+    std::set<AttachmentId> asyncImages;
+    std::set<ResourceId> asyncBuffers;
+    std::set<AttachmentId> handedOverImages;
+    std::set<ResourceId> handedOverBuffers;
+    compiled.asyncSplitPass = static_cast<uint32_t>(passes.size());
+
+    auto acquireFromAsyncCompute = [&](uint32_t passIndex, AttachmentId attId, vk::ImageLayout layout, vk::PipelineStageFlags stages)
+    {
+      if (asyncImages.count(attId) == 0)
+        return;
+
+      compiled.asyncSplitPass = std::min(compiled.asyncSplitPass, passIndex);
+      compiled.asyncWaitStages |= stages;
+
+      if (handedOverImages.insert(attId).second == false)
+        return;
+
+      ResourceState& state = states[attId];
+
+      compiled.releaseBarrier.srcStages |= state.stages;
+      compiled.releaseBarrier.dstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+      compiled.releaseBarrier.imageBarriers.push_back({ attId, state.layout, layout, state.access, vk::AccessFlags{}, computeFamily, graphicsFamily });
+
+      compiled.acquireBarrier.imageBarriers.push_back({ attId, state.layout, layout, vk::AccessFlags{},
+                                                        vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite, computeFamily, graphicsFamily });
+
+      //acquire barrier already orders it after the compute writes
+      state = ResourceState{ layout, vk::PipelineStageFlags{}, vk::AccessFlags{}, true };
+    };
+
+    auto acquireBufferFromAsyncCompute = [&](uint32_t passIndex, const BufferUsage& usage)
+    {
+      if (asyncBuffers.count(usage.buffer) == 0)
+        return;
+
+      compiled.asyncSplitPass = std::min(compiled.asyncSplitPass, passIndex);
+      compiled.asyncWaitStages |= usage.stages;
+
+      //buffers are shared by the queues, the semaphore alone makes the writes visible
+      if (handedOverBuffers.insert(usage.buffer).second)
+        bufferStates[usage.buffer] = BufferState{};
+    };
+
+    for (uint32_t passIndex = 0; passIndex < passes.size(); ++passIndex)
+    {
+      const std::vector<uint32_t>& passNodes = passes[passIndex];
+      const uint32_t lastPassNode = passNodes.back();
+
+      CompiledPass pass;
+
+      const RenderGraphNode& frontNode = nodes[passNodes.front()];
+      if (frontNode.type != RenderGraphNodeType::RenderSubpass)
+      {
+        pass.isAsync = asyncNodes[passNodes.front()];
+
+        if (frontNode.type == RenderGraphNodeType::Transfer)
+        {
+          pass.type = CompiledPassType::Transfer;
+          pass.transferNode = frontNode.index;
+        }
+        else
+        {
+          pass.type = CompiledPassType::Compute;
+          pass.computeNode = frontNode.index;
+        }
+
+        for (const ResourceUsage& usage : GetNodeUsages(frontNode))
+        {
+          ResourceState& state = states[usage.attachment];
+
+          if (pass.isAsync)
+            asyncImages.insert(usage.attachment);
+          else
+            acquireFromAsyncCompute(passIndex, usage.attachment, usage.layout, usage.stages);
+
+          if (!state.used)
+            handOverAliasedMemory(pass.barrier, usage.attachment, usage.stages, usage.access);
+
+          transition(pass.barrier, usage.attachment, usage.layout, usage.stages, usage.access);
+          state = ResourceState{ usage.layout, usage.stages, usage.access, true };
+        }
+
+        for (const BufferUsage& usage : GetNodeBufferUsages(frontNode))
+        {
+          if (pass.isAsync)
+            asyncBuffers.insert(usage.buffer);
+          else
+            acquireBufferFromAsyncCompute(passIndex, usage);
+
+          accessBuffer(pass.barrier, usage);
+        }
+
+        compiledPasses.push_back(std::move(pass));
+        continue;
+      }
+
+      pass.type = CompiledPassType::Render;
+
+      struct PassAttachment
+      {
+        uint32_t localId;
+        vk::ImageLayout firstLayout;
+        vk::ImageLayout lastLayout;
+        vk::PipelineStageFlags firstStages;
+        vk::AccessFlags firstAccess;
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        uint32_t firstSubpass;
+        //last subpass touching the attachment and how it did it
+        uint32_t lastSubpass;
+        vk::PipelineStageFlags lastStages;
+        vk::AccessFlags lastAccess;
+      };
+
+      std::map<AttachmentId, PassAttachment> passAttachments;
+      std::map<std::pair<uint32_t, uint32_t>, vk::SubpassDependency> deps;
+      std::vector<SubpassKey> subpassKeys;
+
+      for (uint32_t localSubpass = 0; localSubpass < passNodes.size(); ++localSubpass)
+      {
+        const RenderGraphNode& node = nodes[passNodes[localSubpass]];
+        const RenderSubpass& subpass = subpasses[node.index];
+
+        pass.subpasses.push_back(subpass.id);
+        subpassLocations[subpass.id] = { passIndex, localSubpass };
+
+        SubpassKey subkey;
+
+        //buffers are read inside of the render pass, synchronized before it begins
+        for (const BufferUsage& usage : GetNodeBufferUsages(node))
+        {
+          acquireBufferFromAsyncCompute(passIndex, usage);
+          accessBuffer(pass.barrier, usage);
+        }
+
+        for (const ResourceUsage& usage : GetNodeUsages(node))
+        {
+          //sampled images are prepared before the render pass begins
+          if (!usage.isAttachment)
+          {
+            acquireFromAsyncCompute(passIndex, usage.attachment, usage.layout, usage.stages);
+
+            ResourceState& state = states[usage.attachment];
+            if (transition(pass.barrier, usage.attachment, usage.layout, usage.stages, usage.access))
+              state = ResourceState{ usage.layout, usage.stages, usage.access, true };
+            else
+              state = ResourceState{ usage.layout, state.stages | usage.stages, state.access | usage.access, true };
+            continue;
+          }
+
+          auto it = passAttachments.find(usage.attachment);
+          if (it == passAttachments.end())
+          {
+            PassAttachment att;
+            att.localId = static_cast<uint32_t>(pass.attachments.size());
+            att.firstLayout = usage.layout;
+            att.firstStages = usage.stages;
+            att.firstAccess = usage.access;
+            att.firstSubpass = localSubpass;
+            att.lastSubpass = localSubpass;
+            att.lastStages = usage.stages;
+            att.lastAccess = usage.access;
+
+            pass.attachments.push_back(usage.attachment);
+            it = passAttachments.emplace(usage.attachment, att).first;
+          }
+          else if (it->second.lastSubpass != localSubpass)
+          {
+            PassAttachment& att = it->second;
+
+            const auto dep = vk::SubpassDependency()
+              .setSrcSubpass(att.lastSubpass)
+              .setSrcStageMask(att.lastStages)
+              .setSrcAccessMask(att.lastAccess)
+              .setDstSubpass(localSubpass)
+              .setDstStageMask(usage.stages)
+              .setDstAccessMask(usage.access)
+              .setDependencyFlags(vk::DependencyFlagBits::eByRegion);
+
+            AddDependency(deps, dep);
+
+            att.lastSubpass = localSubpass;
+            att.lastStages = usage.stages;
+            att.lastAccess = usage.access;
+          }
+          else
+          {
+            it->second.lastStages |= usage.stages;
+            it->second.lastAccess |= usage.access;
+          }
+
+          PassAttachment& att = it->second;
+          att.lastLayout = usage.layout;
+          att.stages |= usage.stages;
+          att.access |= usage.access;
+
+          const auto ref = vk::AttachmentReference()
+            .setAttachment(att.localId)
+            .setLayout(usage.layout);
+
+          if (usage.access & vk::AccessFlagBits::eInputAttachmentRead)
+            subkey.inputAttachmentReferences.push_back(ref);
+          else if (usage.layout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
+            subkey.depthStencilAttachmentReference = ref;
+          else
+            subkey.outputColorAttachmentReferences.push_back(ref);
+        }
+
+        subpassKeys.push_back(std::move(subkey));
+      }
+
+      //describe attachments of the pass
+      std::vector<ImageAttachment> descriptions;
+      for (AttachmentId attId : pass.attachments)
+      {
+        const PassAttachment& att = passAttachments.at(attId);
+        const ResourceLifetime& lifetime = lifetimes.at(imageAttachments[attId].id);
+        const bool isExternal = transientAttachmentKeys[attId].has_value() == false;
+        const bool isUsedLater = lifetime.lastUse > lastPassNode;
+        ResourceState& state = states[attId];
+
+        ImageAttachment desc = imageAttachments[attId];
+        desc.view = ImageView{};
+
+        if (!state.used)
+        {
+          //graph owned attachment is always created by the render pass, there is nothing to load
+          if (!isExternal)
+            desc.loadOp = vk::AttachmentLoadOp::eClear;
+
+          //render pass does the first transition from whatever the owner left
+          desc.initialLayout = state.layout;
+
+          //previous owner of the memory can be in the same render pass
+          const std::optional<AttachmentId>& predecessor = aliasPredecessors[attId];
+          if (predecessor.has_value() && passAttachments.find(predecessor.value()) != passAttachments.end())
+          {
+            const PassAttachment& predecessorAtt = passAttachments.at(predecessor.value());
+
+            const auto dep = vk::SubpassDependency()
+              .setSrcSubpass(predecessorAtt.lastSubpass)
+              .setSrcStageMask(predecessorAtt.stages)
+              .setSrcAccessMask(predecessorAtt.access)
+              .setDstSubpass(att.firstSubpass)
+              .setDstStageMask(att.firstStages)
+              .setDstAccessMask(att.firstAccess);
+
+            AddDependency(deps, dep);
+          }
+          else
+          {
+            handOverAliasedMemory(pass.barrier, attId, att.firstStages, att.firstAccess);
+          }
+
+          //layout transition of the first use waits for the same stages as the attachment writes
+          const auto externalDep = vk::SubpassDependency()
+            .setSrcSubpass(VK_SUBPASS_EXTERNAL)
+            .setSrcStageMask(att.firstStages)
+            .setDstSubpass(att.firstSubpass)
+            .setDstStageMask(att.firstStages)
+            .setDstAccessMask(att.firstAccess);
+
+          AddDependency(deps, externalDep);
+        }
+        else
+        {
+          acquireFromAsyncCompute(passIndex, attId, att.firstLayout, att.stages);
+
+          desc.loadOp = vk::AttachmentLoadOp::eLoad;
+          desc.initialLayout = att.firstLayout;
+          transition(pass.barrier, attId, att.firstLayout, att.firstStages, att.firstAccess);
+        }
+
+        desc.finalLayout = att.lastLayout;
+
+        if (isUsedLater)
+          desc.storeOp = vk::AttachmentStoreOp::eStore;
+        else if (!isExternal)
+          desc.storeOp = vk::AttachmentStoreOp::eDontCare;
+        else
+          //last use of an external attachment, hand it over in the layout the owner expects
+          desc.finalLayout = imageAttachments[attId].finalLayout;
+
+        state = ResourceState{ desc.finalLayout, att.stages, att.access, true };
+
+        pass.clearValues.push_back(GetClearValue(desc));
+        descriptions.push_back(std::move(desc));
+      }
+
+      //memory of an attachment aliased inside of the pass is shared by both descriptions
+      for (AttachmentId attId : pass.attachments)
+      {
+        const std::optional<AttachmentId>& predecessor = aliasPredecessors[attId];
+        if (predecessor.has_value() && passAttachments.find(predecessor.value()) != passAttachments.end())
+        {
+          descriptions[passAttachments.at(attId).localId].mayAlias = true;
+          descriptions[passAttachments.at(predecessor.value()).localId].mayAlias = true;
+        }
+      }
+
+      for (const vk::SubpassDependency& manualDep : m_ManualSetDependency)
+      {
+        const auto src = subpassLocations.find(manualDep.srcSubpass);
+        const auto dst = subpassLocations.find(manualDep.dstSubpass);
+
+        if (src == subpassLocations.end() || dst == subpassLocations.end())
+          continue;
+
+        if (src->second.first != passIndex || dst->second.first != passIndex)
+          continue;
+
+        vk::SubpassDependency dep = manualDep;
+        dep.srcSubpass = src->second.second;
+        dep.dstSubpass = dst->second.second;
+        AddDependency(deps, dep);
+      }
+
+      std::vector<vk::SubpassDependency> dependencies;
+      for (const auto& [_, dep] : deps)
+        dependencies.push_back(dep);
+
+      const auto rpKey = RenderPassKey()
+        .SetBackbufferFormat(backbufferDescription.format)
+        .SetDependencies(dependencies)
+        .SetSubpassesDescriptions(subpassKeys)
+        .SetImageAttachments(descriptions);
+
+      pass.renderPass = core.GetRenderPassStorage().GetRenderPass(rpKey);
+
+      compiledPasses.push_back(std::move(pass));
+    }
+
+    //external attachments leave the graph in the layout their owner expects
+    for (AttachmentId attId = 0; attId < imageAttachments.size(); ++attId)
+    {
+      const ResourceState& state = states[attId];
+      const ImageAttachment& attachment = imageAttachments[attId];
+
+      if (transientAttachmentKeys[attId].has_value() || !state.used || state.layout == attachment.finalLayout)
+        continue;
+
+      compiled.finalBarrier.srcStages |= state.stages;
+      compiled.finalBarrier.dstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+      compiled.finalBarrier.imageBarriers.push_back({ attId, state.layout, attachment.finalLayout, state.access, vk::AccessFlags{} });
+    }
+
+    compiled.usesAsyncCompute = std::find(asyncNodes.begin(), asyncNodes.end(), true) != asyncNodes.end();
+
+    //nothing consumes the results this frame, the frame timeline still has to cover the compute work
+    if (compiled.asyncWaitStages == vk::PipelineStageFlags{})
+      compiled.asyncWaitStages = vk::PipelineStageFlagBits::eAllCommands;
+
+    compiled.acquireBarrier.srcStages = compiled.asyncWaitStages;
+    compiled.acquireBarrier.dstStages = compiled.asyncWaitStages;
+  }
+
+  void RenderGraph::RecordBarrier(vk::CommandBuffer cmd, const CompiledBarrier& barrier)
+  {
+    if (barrier.IsEmpty())
+      return;
+
+    std::vector<vk::ImageMemoryBarrier> imageBarriers;
+    imageBarriers.reserve(barrier.imageBarriers.size());
+
+    for (const CompiledImageBarrier& b : barrier.imageBarriers)
+    {
+      const ImageAttachment& attachment = imageAttachments[b.attachment];
+
+      imageBarriers.push_back(
+        vk::ImageMemoryBarrier()
+        .setSrcAccessMask(b.srcAccess)
+        .setDstAccessMask(b.dstAccess)
+        .setOldLayout(b.oldLayout)
+        .setNewLayout(b.newLayout)
+        .setSrcQueueFamilyIndex(b.srcQueueFamily)
+        .setDstQueueFamilyIndex(b.dstQueueFamily)
+        .setImage(attachment.view.GetImage())
+        .setSubresourceRange(GetAttachmentSubresourceRange(attachment))
+      );
+    }
+
+    const auto memoryBarrier = vk::MemoryBarrier()
+      .setSrcAccessMask(barrier.memorySrcAccess)
+      .setDstAccessMask(barrier.memoryDstAccess);
+
+    const vk::PipelineStageFlags srcStages = barrier.srcStages ? barrier.srcStages : vk::PipelineStageFlagBits::eTopOfPipe;
+    const vk::PipelineStageFlags dstStages = barrier.dstStages ? barrier.dstStages : vk::PipelineStageFlagBits::eBottomOfPipe;
+
+    cmd.pipelineBarrier(srcStages, dstStages,
+      vk::DependencyFlagBits{},
+      barrier.hasMemoryBarrier ? 1 : 0, &memoryBarrier,
+      0, nullptr,
+      static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+  }
+
+  TransientMemoryStatistics RenderGraph::GetTransientMemoryStatistics() const
+  {
+    if (transientSet == nullptr)
+      return TransientMemoryStatistics{};
+
+    return transientSet->statistics;
+  }
+
+  bool RenderGraph::UsesAsyncCompute() const
+  {
+    return compiledGraph != nullptr && compiledGraph->usesAsyncCompute;
+  }
+
+  bool RenderGraph::UsesGraphicsAfterCompute() const
+  {
+    return UsesAsyncCompute() && compiledGraph->asyncSplitPass < compiledGraph->backbufferPass;
+  }
+
+  vk::PipelineStageFlags RenderGraph::GetAsyncComputeWaitStages() const
+  {
+    return compiledGraph != nullptr ? compiledGraph->asyncWaitStages : vk::PipelineStageFlags{};
+  }
+
+  vk::PipelineStageFlags RenderGraph::GetBackbufferWaitStages() const
+  {
+    return compiledGraph != nullptr ? compiledGraph->backbufferWaitStages : vk::PipelineStageFlags{};
+  }
+
+  void RenderGraph::AddAttachmentResource(const ImageAttachment& attachment)
+  {
+    if (resourceIdToAttachmentIdMap.find(attachment.id) != resourceIdToAttachmentIdMap.end())
+      throw std::runtime_error("AddAttachmentResource: resource with such id already exist");
+
+    const AttachmentId attId = static_cast<AttachmentId>(imageAttachments.size());
+    imageAttachments.push_back(attachment);
+    transientAttachmentKeys.push_back(std::nullopt);
+    resourceIdToAttachmentIdMap[attachment.id] = attId;
+  }
+
+  void RenderGraph::AddBufferResource(const ResourceId& id, vk::Buffer buffer)
+  {
+    if (buffers.find(id) != buffers.end())
+      throw std::runtime_error("AddBufferResource: resource with such id already exist");
+
+    buffers[id] = buffer;
+  }
+
+  void RenderGraph::SetBackbufferDescription(const BackbufferDescription& bfDescription)
+  {
+    backbufferDescription = bfDescription;
+  }
+
+  void RenderGraph::SetCommandBuffer(vk::CommandBuffer cmdBuf)
+  {
+    cmdBuffer = cmdBuf;
+  }
+
+  void RenderGraph::SetAsyncComputeCommandBuffers(vk::CommandBuffer computeCmdBuf, vk::CommandBuffer graphicsAfterComputeCmdBuf)
+  {
+    computeCmdBuffer = computeCmdBuf;
+    graphicsAfterComputeCmdBuffer = graphicsAfterComputeCmdBuf;
+  }
+
+  void RenderGraph::SetBackbufferCommandBuffer(vk::CommandBuffer cmdBuf)
+  {
+    backbufferCmdBuffer = cmdBuf;
+  }
+
+  void RenderGraph::SetUniformsAccessorStorage(UniformsAccessorStorage* s)
+  {
+    uaStorage = s;
+  }
+
+  void RenderGraph::SetThreadResources(std::vector<ThreadFrameResources>* resources)
+  {
+    threadResources = resources;
+  }
+
+  void RenderGraph::Reset()
+  {
+    subpasses.clear();
+    transferNodes.clear();
+    computeNodes.clear();
+    nodes.clear();
+    resourceIdToAttachmentIdMap.clear();
+    imageAttachments.clear();
+    transientAttachmentKeys.clear();
+    buffers.clear();
+    aliasPredecessors.clear();
+    nodePasses.clear();
+    asyncNodes.clear();
+    m_ManualSetDependency.clear();
+    framebuffers.clear();
+    compiledGraph = nullptr;
+    isAfterComputeRecorded = false;
+    frameProfilerScope = GPU_PROFILER_INVALID_QUERY;
+
+    if (transientSet != nullptr)
+      core.GetTransientAttachmentPool().Release(transientSet);
+    transientSet = nullptr;
+  }
+
+  FrameContext RenderGraph::CreateFrameContext(vk::CommandBuffer cmd)
+  {
+    FrameContext context;
+    context.BackbufferSize = backbufferDescription.size;
+    context.uniformsAccessorStorage = uaStorage;
+    context.pipelineStorage = &core.GetPipelineStorage();
+    context.commandBuffer = cmd;
+    context.renderGraph = this;
+
+    return context;
+  }
+
+  void RenderGraph::Execute()
+  {
+    PROFILE_ZONE("RenderGraph::Execute");
+
+    const bool usesAsyncCompute = compiledGraph->usesAsyncCompute;
+    const uint32_t backbufferPass = compiledGraph->backbufferPass;
+
+    GpuProfiler& profiler = core.GetGpuProfiler();
+
+    cmdBuffer.begin(vk::CommandBufferBeginInfo());
+    if (usesAsyncCompute)
+      computeCmdBuffer.begin(vk::CommandBufferBeginInfo());
+
+    profiler.ResetQueries(cmdBuffer, usesAsyncCompute ? computeCmdBuffer : vk::CommandBuffer{});
+
+    frameProfilerScope = profiler.AddScope(GPU_PROFILER_FRAME_SCOPE, false);
+    profiler.WriteBeginTimestamp(cmdBuffer, frameProfilerScope);
+
+    FrameContext context = CreateFrameContext(cmdBuffer);
+
+    for (uint32_t passIndex = 0; passIndex < compiledGraph->passes.size(); ++passIndex)
+    {
+      const CompiledPass& pass = compiledGraph->passes[passIndex];
+
+      //async passes never touch external images, all of them are recorded before the backbuffer is acquired
+      vk::CommandBuffer cmd = cmdBuffer;
+      if (pass.isAsync)
+      {
+        cmd = computeCmdBuffer;
+      }
+      else if (passIndex >= backbufferPass)
+      {
+        continue;
+      }
+      else if (usesAsyncCompute && passIndex >= compiledGraph->asyncSplitPass)
+      {
+        //graphics work after the split waits for the async compute in a separate submission
+        if (!isAfterComputeRecorded)
+        {
+          graphicsAfterComputeCmdBuffer.begin(vk::CommandBufferBeginInfo());
+          RecordBarrier(graphicsAfterComputeCmdBuffer, compiledGraph->acquireBarrier);
+          isAfterComputeRecorded = true;
+        }
+
+        cmd = graphicsAfterComputeCmdBuffer;
+      }
+
+      RecordPass(cmd, context, passIndex);
+    }
+
+    if (usesAsyncCompute)
+    {
+      RecordBarrier(computeCmdBuffer, compiledGraph->releaseBarrier);
+      computeCmdBuffer.end();
+    }
+
+    if (isAfterComputeRecorded)
+      graphicsAfterComputeCmdBuffer.end();
+
+    cmdBuffer.end();
+  }
+
+  void RenderGraph::SetBackbufferView(const ImageView& view)
+  {
+    imageAttachments[resourceIdToAttachmentIdMap.at(BACKBUFFER_RESOURCE_ID)].view = view;
+
+    CreateFramebuffers(compiledGraph->backbufferPass, static_cast<uint32_t>(compiledGraph->passes.size()));
+  }
+
+  void RenderGraph::ExecuteBackbufferPasses()
+  {
+    PROFILE_ZONE("RenderGraph::ExecuteBackbufferPasses");
+
+    backbufferCmdBuffer.begin(vk::CommandBufferBeginInfo());
+
+    //nothing waited for the async compute yet
+    if (compiledGraph->usesAsyncCompute && !isAfterComputeRecorded)
+      RecordBarrier(backbufferCmdBuffer, compiledGraph->acquireBarrier);
+
+    FrameContext context = CreateFrameContext(backbufferCmdBuffer);
+
+    for (uint32_t passIndex = compiledGraph->backbufferPass; passIndex < compiledGraph->passes.size(); ++passIndex)
+      if (!compiledGraph->passes[passIndex].isAsync)
+        RecordPass(backbufferCmdBuffer, context, passIndex);
+
+    RecordBarrier(backbufferCmdBuffer, compiledGraph->finalBarrier);
+    core.GetGpuProfiler().WriteEndTimestamp(backbufferCmdBuffer, frameProfilerScope);
+
+    backbufferCmdBuffer.end();
+  }
+
+  void RenderGraph::RecordPass(vk::CommandBuffer cmd, FrameContext& context, uint32_t passIndex)
+  {
+    const CompiledPass& pass = compiledGraph->passes[passIndex];
+
+    GpuProfiler& profiler = core.GetGpuProfiler();
+
+    context.commandBuffer = cmd;
+
+    RecordBarrier(cmd, pass.barrier);
+
+    if (pass.type != CompiledPassType::Render)
+    {
+      context.renderPass = vk::RenderPass{};
+      context.framebuffer = vk::Framebuffer{};
+      context.subpassNumber = 0;
+      context.outputAttachmentBlendStates.clear();
+      context.outputAttachmentBlendStatesId = 0;
+
+      const std::string& name = (pass.type == CompiledPassType::Transfer)
+        ? transferNodes[pass.transferNode].name
+        : computeNodes[pass.computeNode].name;
+
+      const uint32_t scope = profiler.AddScope(name, pass.isAsync);
+      profiler.WriteBeginTimestamp(cmd, scope);
+
+      if (pass.type == CompiledPassType::Transfer)
+        transferNodes[pass.transferNode].callback(context);
+      else
+        computeNodes[pass.computeNode].callback(context);
+
+      profiler.WriteEndTimestamp(cmd, scope);
+
+      return;
+    }
+
+    const auto rpBeginInfo = vk::RenderPassBeginInfo()
+      .setRenderPass(pass.renderPass)
+      .setFramebuffer(framebuffers[passIndex])
+      .setRenderArea(vk::Rect2D{ {0,0}, backbufferDescription.size })
+      .setClearValueCount(static_cast<uint32_t>(pass.clearValues.size()))
+      .setPClearValues(pass.clearValues.data());
+
+    auto getSubpassContents = [&](uint32_t i)
+    {
+      return subpasses[pass.subpasses[i]].parallelRenderCallback ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline;
+    };
+
+    cmd.beginRenderPass(rpBeginInfo, getSubpassContents(0));
+
+    context.renderPass = pass.renderPass;
+    context.framebuffer = framebuffers[passIndex];
+
+    for (uint32_t i = 0; i < pass.subpasses.size(); ++i)
+    {
+      const RenderSubpass& subpass = subpasses[pass.subpasses[i]];
+
+      context.subpassNumber = i;
+      context.outputAttachmentBlendStates = subpass.outputAttachmentBlendStates;
+      context.outputAttachmentBlendStatesId = core.GetPipelineStorage().InternBlendStates(subpass.outputAttachmentBlendStates);
+
+      const uint32_t scope = profiler.AddScope(subpass.name, false);
+
+      if (subpass.parallelRenderCallback)
+      {
+        //primary buffer can only execute secondary ones in this subpass, queries go into them
+        RecordParallelSubpass(cmd, context, subpass, scope);
+      }
+      else
+      {
+        const uint32_t statisticsQuery = profiler.ReserveStatisticsQueries(scope, 1);
+
+        profiler.WriteBeginTimestamp(cmd, scope);
+        profiler.BeginStatisticsQuery(cmd, statisticsQuery);
+
+        SetViewportAndScissor(cmd, backbufferDescription.size);
+        subpass.renderCallback(context);
+
+        profiler.EndStatisticsQuery(cmd, statisticsQuery);
+        profiler.WriteEndTimestamp(cmd, scope);
+      }
+
+      if (i != (pass.subpasses.size() - 1))
+        cmd.nextSubpass(getSubpassContents(i + 1));
+    }
+
+    cmd.endRenderPass();
+  }
+
+  void RenderGraph::RecordParallelSubpass(vk::CommandBuffer cmd, const FrameContext& context, const RenderSubpass& subpass, uint32_t profilerScope)
+  {
+    const uint32_t itemsCount = subpass.parallelItemsCount;
+    if (itemsCount == 0)
+      return;
+
+    WorkerPool& workerPool = core.GetWorkerPool();
+    const uint32_t chunkSize = (itemsCount + workerPool.GetWorkersCount() - 1) / workerPool.GetWorkersCount();
+    const uint32_t chunksCount = (itemsCount + chunkSize - 1) / chunkSize;
+
+    //first and last chunks are executed first and last, they hold the subpass's timestamps
+    GpuProfiler& profiler = core.GetGpuProfiler();
+    const uint32_t firstStatisticsQuery = profiler.ReserveStatisticsQueries(profilerScope, chunksCount);
+
+    const auto inheritanceInfo = vk::CommandBufferInheritanceInfo()
+      .setRenderPass(context.renderPass)
+      .setSubpass(context.subpassNumber)
+      .setFramebuffer(context.framebuffer);
+
+    const auto beginInfo = vk::CommandBufferBeginInfo()
+      .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+      .setPInheritanceInfo(&inheritanceInfo);
+
+    const vk::Device device = core.GetLogicalDevice();
+
+    //every chunk has its own slot, the order of execution doesn't depend on the workers
+    std::vector<vk::CommandBuffer> secondaryCmdBuffers(chunksCount);
+
+    for (uint32_t chunk = 0; chunk < chunksCount; ++chunk)
+    {
+      workerPool.Submit([&, chunk](uint32_t workerIndex)
+      {
+        ThreadFrameResources& tr = (*threadResources)[workerIndex];
+
+        const vk::CommandBuffer secondaryCmd = tr.GetSecondaryCommandBuffer(device);
+        secondaryCmd.begin(beginInfo);
+
+        const uint32_t statisticsQuery = (firstStatisticsQuery != GPU_PROFILER_INVALID_QUERY) ? firstStatisticsQuery + chunk : GPU_PROFILER_INVALID_QUERY;
+
+        if (chunk == 0)
+          profiler.WriteBeginTimestamp(secondaryCmd, profilerScope);
+        profiler.BeginStatisticsQuery(secondaryCmd, statisticsQuery);
+
+        //dynamic state isn't inherited from the primary buffer
+        SetViewportAndScissor(secondaryCmd, context.BackbufferSize);
+
+        FrameContext workerContext = context;
+        workerContext.commandBuffer = secondaryCmd;
+        workerContext.uniformsAccessorStorage = tr.uaStorage.get();
+
+        const uint32_t firstItem = chunk * chunkSize;
+        subpass.parallelRenderCallback(workerContext, firstItem, std::min(chunkSize, itemsCount - firstItem));
+
+        profiler.EndStatisticsQuery(secondaryCmd, statisticsQuery);
+        if (chunk == (chunksCount - 1))
+          profiler.WriteEndTimestamp(secondaryCmd, profilerScope);
+
+        secondaryCmd.end();
+        secondaryCmdBuffers[chunk] = secondaryCmd;
+      });
+    }
+
+    workerPool.Wait();
+
+    cmd.executeCommands(static_cast<uint32_t>(secondaryCmdBuffers.size()), secondaryCmdBuffers.data());
+  }
+
+  std::vector<vk::ClearValue> RenderGraph::GetClearColorsForImageAttachments() const
+  {
+    std::vector<vk::ClearValue> clearColors;
+    for (const ImageAttachment& img : imageAttachments)
+      clearColors.push_back(GetClearValue(img));
+
+    return clearColors;
+  }
+
+  void RenderGraph::AddSubpassesResources()
+  {
+    for (const RenderSubpass& subpass : subpasses)
+    {
+      for (ImageAttachment createInfo : subpass.imageAttachmentCreateInfos)
+      {
+        if (resourceIdToAttachmentIdMap.find(createInfo.id) != resourceIdToAttachmentIdMap.end())
+          throw std::runtime_error("AddSubpassesResources: can't add a new resource: index already in use.");
+
+        if (createInfo.format == vk::Format::eUndefined)
+          createInfo.format = backbufferDescription.format;
+
+        const auto key = TransientAttachmentKey()
+          .SetFormat(createInfo.format)
+          .SetExtent(backbufferDescription.size)
+          .SetUsage(createInfo.usageFlags)
+          .SetAspect(vk::ImageAspectFlagBits::eColor);
+
+        AddAttachmentResource(createInfo);
+        transientAttachmentKeys.back() = key;
+      }
+
+      if (subpass.depthStencilAttachment.has_value())
+      {
+        ImageAttachment createInfo = subpass.depthStencilAttachment.value();
+        assert(createInfo.type == ImageType::DepthOnlyAttachment || createInfo.type == ImageType::DepthStencilAttachment);
+
+        if (resourceIdToAttachmentIdMap.find(createInfo.id) != resourceIdToAttachmentIdMap.end())
+          throw std::runtime_error("AddSubpassesResources: can't add a new depth|stencil resource: index already in use.");
+
+        const vk::ImageAspectFlags aspectFlags = (createInfo.type == ImageType::DepthOnlyAttachment)
+          ? vk::ImageAspectFlagBits::eDepth
+          : vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+
+        const auto key = TransientAttachmentKey()
+          .SetFormat(createInfo.format)
+          .SetExtent(backbufferDescription.size)
+          .SetUsage(createInfo.usageFlags)
+          .SetAspect(aspectFlags);
+
+        AddAttachmentResource(createInfo);
+        transientAttachmentKeys.back() = key;
+      }
+    }
+
+    for (const ComputeNode& node : computeNodes)
+    {
+      for (const ImageAttachment& createInfo : node.imageCreateInfos)
+      {
+        if (resourceIdToAttachmentIdMap.find(createInfo.id) != resourceIdToAttachmentIdMap.end())
+          throw std::runtime_error("AddSubpassesResources: can't add a new storage image: index already in use.");
+
+        //backbuffer formats usually can't be stored to, there is no sensible default
+        if (createInfo.format == vk::Format::eUndefined)
+          throw std::runtime_error("AddSubpassesResources: storage image requires a format.");
+
+        const auto key = TransientAttachmentKey()
+          .SetFormat(createInfo.format)
+          .SetExtent(backbufferDescription.size)
+          .SetUsage(createInfo.usageFlags)
+          .SetAspect(vk::ImageAspectFlagBits::eColor);
+
+        AddAttachmentResource(createInfo);
+        transientAttachmentKeys.back() = key;
+      }
+    }
+  }
+
+  const ImageView& RenderGraph::GetImageView(const ResourceId& id) const
+  {
+    const AttachmentId attId = resourceIdToAttachmentIdMap.at(id);
+    const ImageAttachment& attachment = imageAttachments[attId];
+
+    return attachment.view;
+  }
+
+  vk::Buffer RenderGraph::GetBuffer(const ResourceId& id) const
+  {
+    return buffers.at(id);
   }
 
   void RenderGraph::AddDependencyFromOutputResource(const unsigned int srcId, const unsigned int dstId, const ResourceId& resourceId, SubpassDependencyType dependencyType)
@@ -4,8 +4,8 @@
 #include "image.h"
 #include "enums.h"
 #include "framecontext.h"
+#include "transient_attachment_pool.h"
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
 
 #include <vector>
@@ -13,6 +13,7 @@
 #include <map>
 #include <set>
 #include <optional>
+#include <string>
 
 namespace Vulkan
 {
@@ -21,6 +22,7 @@ namespace Vulkan
   class FramebufferStorage;
   class RenderPassStorage;
   class UniformsAccessorStorage;
+  struct ThreadFrameResources;
 
   typedef unsigned int SubpassId;
   typedef unsigned int AttachmentId;
@@ -55,6 +57,9 @@ namespace Vulkan
 
   typedef std::function<void(FrameContext&)> RenderPassExecutionFunction;
 
+  //records items [firstItem, firstItem + itemsCount) of a subpass's draw list
+  typedef std::function<void(FrameContext&, uint32_t firstItem, uint32_t itemsCount)> ParallelRenderPassExecutionFunction;
+
   enum class SubpassDependencyType
   {
     //write to the same output resource 
@@ -74,11 +79,14 @@ namespace Vulkan
   public:
     RenderSubpass(unsigned int id);
 
+    //shown by the gpu profiler
+    RenderSubpass& SetName(const std::string& name);
+
     RenderSubpass& AddInputAttachment(const SubpassInput& desc);
 
     RenderSubpass& AddInputSampler(const ResourceId& id);
 
-    RenderSubpass& AddInputBuffer();
+    RenderSubpass& AddInputBuffer(const ResourceId& id);
 
     RenderSubpass& AddNewOutputColorAttachment(const ResourceId& id, vk::Format format = vk::Format::eUndefined, 
                                                const vk::PipelineColorBlendAttachmentState& blendState = vk::PipelineColorBlendAttachmentState{}
@@ -100,6 +108,10 @@ namespace Vulkan
 
     RenderSubpass& SetRenderCallback(RenderPassExecutionFunction callback);
 
+    //draw list is split between the workers, every chunk is recorded into a secondary command buffer.
+    //callback is called concurrently, context's uniforms accessors are per worker
+    RenderSubpass& SetParallelRenderCallback(uint32_t itemsCount, ParallelRenderPassExecutionFunction callback);
+
     inline unsigned int GetId() const
     {
       return id;
@@ -109,9 +121,13 @@ namespace Vulkan
 
   private:
     const unsigned int id;
+    std::string name;
     RenderPassExecutionFunction renderCallback;
+    ParallelRenderPassExecutionFunction parallelRenderCallback;
+    uint32_t parallelItemsCount;
     
     std::vector<ResourceId> inputSamplers;
+    std::vector<ResourceId> inputBuffers;
     std::vector<SubpassInput> inputAttachments;
     std::vector<ResourceId> outputColorAttachments;
     std::vector<vk::PipelineColorBlendAttachmentState> outputAttachmentBlendStates;
@@ -138,6 +154,207 @@ namespace Vulkan
     }
   };
 
+  //copies recorded outside of render passes
+  class TransferNode
+  {
+    friend class RenderGraph;
+  public:
+    TransferNode(unsigned int id);
+
+    TransferNode& SetName(const std::string& name);
+
+    TransferNode& AddSource(const ResourceId& id);
+
+    TransferNode& AddDestination(const ResourceId& id);
+
+    TransferNode& SetCallback(RenderPassExecutionFunction callback);
+
+    inline unsigned int GetId() const
+    {
+      return id;
+    }
+
+  private:
+    const unsigned int id;
+    std::string name;
+    RenderPassExecutionFunction callback;
+
+    std::vector<ResourceId> sources;
+    std::vector<ResourceId> destinations;
+  };
+
+  //compute dispatches, they go to the async compute queue when the device has one
+  //and nothing recorded earlier on the graphics queue touches their resources
+  class ComputeNode
+  {
+    friend class RenderGraph;
+  public:
+    ComputeNode(unsigned int id);
+
+    ComputeNode& SetName(const std::string& name);
+
+    ComputeNode& AddInputSampler(const ResourceId& id);
+
+    ComputeNode& AddInputStorageImage(const ResourceId& id);
+
+    ComputeNode& AddNewOutputStorageImage(const ResourceId& id, vk::Format format);
+
+    ComputeNode& AddExistOutputStorageImage(const ResourceId& id);
+
+    ComputeNode& AddInputStorageBuffer(const ResourceId& id);
+
+    ComputeNode& AddOutputStorageBuffer(const ResourceId& id);
+
+    ComputeNode& SetCallback(RenderPassExecutionFunction callback);
+
+    inline unsigned int GetId() const
+    {
+      return id;
+    }
+
+  private:
+    const unsigned int id;
+    std::string name;
+    RenderPassExecutionFunction callback;
+
+    std::vector<ResourceId> inputSamplers;
+    std::vector<ResourceId> inputStorageImages;
+    std::vector<ResourceId> outputStorageImages;
+    std::vector<ResourceId> inputBuffers;
+    std::vector<ResourceId> outputBuffers;
+
+    std::vector<ImageAttachment> imageCreateInfos;
+  };
+
+  enum class RenderGraphNodeType
+  {
+    RenderSubpass,
+    Transfer,
+    Compute
+  };
+
+  struct RenderGraphNode
+  {
+    RenderGraphNodeType type;
+    unsigned int index;
+  };
+
+  //nodes range where a resource is read or written
+  struct ResourceLifetime
+  {
+    uint32_t firstUse = ~0u;
+    uint32_t lastUse = 0;
+  };
+
+  //how a node accesses a resource
+  struct ResourceUsage
+  {
+    AttachmentId attachment;
+    vk::ImageLayout layout;
+    vk::PipelineStageFlags stages;
+    vk::AccessFlags access;
+    bool isAttachment;
+  };
+
+  //buffers have no layouts, only accesses are tracked
+  struct BufferUsage
+  {
+    ResourceId buffer;
+    vk::PipelineStageFlags stages;
+    vk::AccessFlags access;
+  };
+
+  struct CompiledImageBarrier
+  {
+    AttachmentId attachment;
+    vk::ImageLayout oldLayout;
+    vk::ImageLayout newLayout;
+    vk::AccessFlags srcAccess;
+    vk::AccessFlags dstAccess;
+    //queue ownership transfer, ignored within a queue
+    uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+  };
+
+  //all the synchronization recorded before a pass as a single pipelineBarrier
+  struct CompiledBarrier
+  {
+    vk::PipelineStageFlags srcStages;
+    vk::PipelineStageFlags dstStages;
+    std::vector<CompiledImageBarrier> imageBarriers;
+    //memory handed over between aliased attachments and buffer hazards
+    vk::AccessFlags memorySrcAccess;
+    vk::AccessFlags memoryDstAccess;
+    bool hasMemoryBarrier = false;
+
+    inline bool IsEmpty() const
+    {
+      return imageBarriers.empty() && !hasMemoryBarrier;
+    }
+  };
+
+  enum class CompiledPassType
+  {
+    Render,
+    Transfer,
+    Compute
+  };
+
+  struct CompiledPass
+  {
+    CompiledPassType type;
+    CompiledBarrier barrier;
+    //recorded on the async compute queue
+    bool isAsync = false;
+
+    vk::RenderPass renderPass;
+    std::vector<AttachmentId> attachments;
+    std::vector<vk::ClearValue> clearValues;
+    std::vector<SubpassId> subpasses;
+
+    unsigned int transferNode = 0;
+    unsigned int computeNode = 0;
+  };
+
+  //everything Compile derives from the graph declaration, reused while the declaration's key doesn't change
+  struct CompiledRenderGraph
+  {
+    std::map<ResourceId, AttachmentId> resourceIdToAttachmentIdMap;
+    std::vector<ImageAttachment> imageAttachments;
+    //attachments owned by the graph, external attachments don't have an index in the set
+    TransientAttachmentSetKey transientSetKey;
+    std::vector<std::optional<uint32_t>> transientSetIndices;
+    std::vector<CompiledPass> passes;
+    //external attachments to their final layouts
+    CompiledBarrier finalBarrier;
+    //stages of the backbuffer's first use, presentation engine's image is waited only there
+    vk::PipelineStageFlags backbufferWaitStages;
+    //graphics passes starting from this one are recorded after the backbuffer was acquired
+    uint32_t backbufferPass = 0;
+
+    bool usesAsyncCompute = false;
+    //graphics passes starting from this one wait for the async compute
+    uint32_t asyncSplitPass = 0;
+    vk::PipelineStageFlags asyncWaitStages;
+    //ownership of images written by the async compute goes to the graphics queue
+    CompiledBarrier releaseBarrier;
+    CompiledBarrier acquireBarrier;
+  };
+
+  //structural description of the graph declaration, the hash only picks the cache entry
+  struct RenderGraphKey
+  {
+    uint64_t hash = 0;
+    std::vector<uint8_t> data;
+  };
+
+  struct CachedRenderGraph
+  {
+    std::vector<uint8_t> key;
+    CompiledRenderGraph graph;
+    uint64_t lastUsedFrame = 0;
+  };
+
   class RenderGraph
   {
   public:
@@ -145,52 +362,133 @@ namespace Vulkan
 
     RenderSubpass& AddRenderSubpass();
 
+    TransferNode& AddTransferNode();
+
+    ComputeNode& AddComputeNode();
+
     void Compile();
 
     void AddAttachmentResource(const ImageAttachment& attachment);
 
+    //buffers written by the async compute should be per frame, previous frame may still read them
+    void AddBufferResource(const ResourceId& id, vk::Buffer buffer);
+
     void SetBackbufferDescription(const BackbufferDescription& bfDescription);
 
     void SetCommandBuffer(vk::CommandBuffer cmdBuf);
 
+    void SetAsyncComputeCommandBuffers(vk::CommandBuffer computeCmdBuf, vk::CommandBuffer graphicsAfterComputeCmdBuf);
+
+    void SetBackbufferCommandBuffer(vk::CommandBuffer cmdBuf);
+
     void SetUniformsAccessorStorage(UniformsAccessorStorage* s);
 
+    void SetThreadResources(std::vector<ThreadFrameResources>* resources);
+
     void Reset();
 
+    //records the work which doesn't need the backbuffer, it can be submitted before the backbuffer is acquired
     void Execute();
 
+    void SetBackbufferView(const ImageView& view);
+
+    //records passes starting from the backbuffer's first use into the backbuffer command buffer
+    void ExecuteBackbufferPasses();
+
+    TransientMemoryStatistics GetTransientMemoryStatistics() const;
+
+    //compiled graph put work on the async compute queue, both compute command buffers have to be submitted
+    bool UsesAsyncCompute() const;
+
+    vk::PipelineStageFlags GetAsyncComputeWaitStages() const;
+
+    //graphics work waiting for the async compute is in its own buffer,
+    //otherwise the backbuffer command buffer waits for the compute
+    bool UsesGraphicsAfterCompute() const;
+
+    vk::PipelineStageFlags GetBackbufferWaitStages() const;
+
     std::vector<vk::ClearValue> GetClearColorsForImageAttachments() const;
 
     const ImageView& GetImageView(const ResourceId& id) const;
 
+    vk::Buffer GetBuffer(const ResourceId& id) const;
+
     void AddDependencyFromOutputResource(const unsigned int srcId, const unsigned int dstId, const ResourceId& resourceId, SubpassDependencyType dependencyType);
 
   private:
-    std::vector<vk::SubpassDependency> GetSubpassDependencies() const;
-    std::vector<vk::SubpassDependency> GetAttachmentDependencies() const;
+    void AddSubpassesResources();
+
+    RenderGraphKey GetKey() const;
+
+    CompiledRenderGraph CompileGraph();
 
-    vk::RenderPass CreateRenderpass();
+    void AcquireAttachments(const CompiledRenderGraph& compiled);
 
-    vk::Framebuffer CreateFramebuffer();
+    void CreateFramebuffers(uint32_t firstPass, uint32_t endPass);
 
-    void AllocateSubpassesResources();
+    std::vector<ResourceUsage> GetNodeUsages(const RenderGraphNode& node) const;
+
+    std::vector<BufferUsage> GetNodeBufferUsages(const RenderGraphNode& node) const;
+
+    std::vector<bool> ScheduleAsyncCompute() const;
+
+    std::vector<std::vector<uint32_t>> GroupNodesIntoPasses() const;
+
+    std::map<ResourceId, ResourceLifetime> GetResourceLifetimes() const;
+
+    void InferAttachmentsUsage(const std::map<ResourceId, ResourceLifetime>& lifetimes);
+
+    void AliasTransientAttachments(const std::map<ResourceId, ResourceLifetime>& lifetimes);
+
+    void CompilePasses(const std::map<ResourceId, ResourceLifetime>& lifetimes, CompiledRenderGraph& compiled);
+
+    void RecordBarrier(vk::CommandBuffer cmd, const CompiledBarrier& barrier);
+
+    void RecordPass(vk::CommandBuffer cmd, FrameContext& context, uint32_t passIndex);
+
+    FrameContext CreateFrameContext(vk::CommandBuffer cmd);
+
+    void RecordParallelSubpass(vk::CommandBuffer cmd, const FrameContext& context, const RenderSubpass& subpass, uint32_t profilerScope);
 
   private:
     Core& core;
 
     UniformsAccessorStorage* uaStorage;
+    std::vector<ThreadFrameResources>* threadResources;
     vk::CommandBuffer cmdBuffer;
+    vk::CommandBuffer computeCmdBuffer;
+    vk::CommandBuffer graphicsAfterComputeCmdBuffer;
+    vk::CommandBuffer backbufferCmdBuffer;
+    bool isAfterComputeRecorded;
+    uint32_t frameProfilerScope;
     BackbufferDescription backbufferDescription;
     std::vector<RenderSubpass> subpasses;
+    std::vector<TransferNode> transferNodes;
+    std::vector<ComputeNode> computeNodes;
+    std::vector<RenderGraphNode> nodes;
 
     std::map<ResourceId, AttachmentId> resourceIdToAttachmentIdMap;
     std::vector<ImageAttachment> imageAttachments;
-
-    std::vector<Image> ownedImages;
+    std::vector<std::optional<TransientAttachmentKey>> transientAttachmentKeys;
+    std::map<ResourceId, vk::Buffer> buffers;
+    TransientAttachmentSetKey transientSetKey;
+    std::vector<std::optional<uint32_t>> transientSetIndices;
+    //previous owner of the attachment's memory
+    std::vector<std::optional<AttachmentId>> aliasPredecessors;
+    //pass of every node
+    std::vector<uint32_t> nodePasses;
+    //node runs on the async compute queue
+    std::vector<bool> asyncNodes;
+
+    const TransientAttachmentSet* transientSet;
     std::vector<vk::SubpassDependency> m_ManualSetDependency;
 
-    vk::RenderPass renderPass;
-    vk::Framebuffer framebuffer;
+    //unused entries are evicted a few frames later
+    std::map<uint64_t, CachedRenderGraph> compiledGraphs;
+    const CompiledRenderGraph* compiledGraph;
+
+    std::vector<vk::Framebuffer> framebuffers;
   };
 
 
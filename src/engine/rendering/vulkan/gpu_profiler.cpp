@@ -0,0 +1,300 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  constexpr uint32_t MAX_TIMESTAMPS = 512;
+  constexpr uint32_t MAX_STATISTICS_QUERIES = 256;
+
+  constexpr vk::QueryPipelineStatisticFlags STATISTICS_FLAGS = vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives | vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+  constexpr uint32_t STATISTICS_VALUES_COUNT = 2;
+
+  uint64_t GetTimestampMask(uint32_t validBits)
+  {
+    if (validBits == 0)
+      return 0;
+
+    return validBits >= 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << validBits) - 1;
+  }
+
+  vk::UniqueQueryPool CreateTimestampPool(vk::Device device)
+  {
+    const auto createInfo = vk::QueryPoolCreateInfo()
+      .setQueryType(vk::QueryType::eTimestamp)
+      .setQueryCount(MAX_TIMESTAMPS);
+
+    return device.createQueryPoolUnique(createInfo);
+  }
+
+  //every query is followed by its availability
+  std::vector<uint64_t> ReadQueries(vk::Device device, vk::QueryPool pool, uint32_t queriesCount, uint32_t valuesPerQuery)
+  {
+    const uint32_t stride = valuesPerQuery + 1;
+    std::vector<uint64_t> values(queriesCount * stride, 0);
+
+    if (queriesCount == 0)
+      return values;
+
+    //frame timeline was waited, eNotReady only leaves some availabilities at zero
+    const vk::Result result = device.getQueryPoolResults(pool, 0, queriesCount,
+      values.size() * sizeof(uint64_t), values.data(), stride * sizeof(uint64_t),
+      vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+
+    if (result != vk::Result::eSuccess && result != vk::Result::eNotReady)
+      throw std::runtime_error("GpuProfiler::Resolve: failed to read query results");
+
+    return values;
+  }
+}
+
+namespace Vulkan
+{
+  GpuProfiler::GpuProfiler(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t graphicsFamilyIndex, uint32_t computeFamilyIndex, uint32_t framesCount, bool isPipelineStatisticsSupported)
+    : device(device)
+    , isPipelineStatisticsSupported(isPipelineStatisticsSupported)
+    , isPipelineStatisticsEnabled(false)
+    , currentFrame(0)
+  {
+    const std::vector<vk::QueueFamilyProperties> families = physicalDevice.getQueueFamilyProperties();
+
+    timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+    graphicsTimestampMask = GetTimestampMask(families[graphicsFamilyIndex].timestampValidBits);
+    computeTimestampMask = GetTimestampMask(families[computeFamilyIndex].timestampValidBits);
+
+    frames.resize(framesCount);
+    for (FrameQueries& frame : frames)
+    {
+      if (graphicsTimestampMask != 0)
+        frame.graphicsTimestamps = CreateTimestampPool(device);
+
+      if (computeTimestampMask != 0)
+        frame.computeTimestamps = CreateTimestampPool(device);
+    }
+  }
+
+  void GpuProfiler::BeginFrame(uint32_t virtualFrame)
+  {
+    currentFrame = virtualFrame;
+    FrameQueries& frame = frames[currentFrame];
+
+    Resolve(frame);
+
+    frame.graphicsTimestampsCount = 0;
+    frame.computeTimestampsCount = 0;
+    frame.statisticsQueriesCount = 0;
+    frame.hasStatistics = false;
+    frame.scopes.clear();
+  }
+
+  void GpuProfiler::ResetQueries(vk::CommandBuffer graphicsCmd, vk::CommandBuffer computeCmd)
+  {
+    FrameQueries& frame = frames[currentFrame];
+
+    if (frame.graphicsTimestamps)
+      graphicsCmd.resetQueryPool(frame.graphicsTimestamps.get(), 0, MAX_TIMESTAMPS);
+
+    //enabling statistics in the middle of a frame takes effect from the next one
+    frame.hasStatistics = frame.pipelineStatistics && isPipelineStatisticsEnabled;
+    if (frame.hasStatistics)
+      graphicsCmd.resetQueryPool(frame.pipelineStatistics.get(), 0, MAX_STATISTICS_QUERIES);
+
+    if (frame.computeTimestamps && computeCmd)
+      computeCmd.resetQueryPool(frame.computeTimestamps.get(), 0, MAX_TIMESTAMPS);
+  }
+
+  uint32_t GpuProfiler::AddScope(const std::string& name, bool isAsync)
+  {
+    FrameQueries& frame = frames[currentFrame];
+
+    const bool hasTimestamps = isAsync ? static_cast<bool>(frame.computeTimestamps) : static_cast<bool>(frame.graphicsTimestamps);
+    uint32_t& timestampsCount = isAsync ? frame.computeTimestampsCount : frame.graphicsTimestampsCount;
+
+    if (!hasTimestamps || (timestampsCount + 2) > MAX_TIMESTAMPS)
+      return GPU_PROFILER_INVALID_QUERY;
+
+    frame.scopes.push_back(Scope{ name, isAsync, timestampsCount, GPU_PROFILER_INVALID_QUERY, 0 });
+    timestampsCount += 2;
+
+    return static_cast<uint32_t>(frame.scopes.size() - 1);
+  }
+
+  void GpuProfiler::WriteBeginTimestamp(vk::CommandBuffer cmd, uint32_t scope) const
+  {
+    if (scope == GPU_PROFILER_INVALID_QUERY)
+      return;
+
+    const FrameQueries& frame = frames[currentFrame];
+    const Scope& s = frame.scopes[scope];
+    const vk::QueryPool pool = s.isAsync ? frame.computeTimestamps.get() : frame.graphicsTimestamps.get();
+
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, pool, s.firstTimestamp);
+  }
+
+  void GpuProfiler::WriteEndTimestamp(vk::CommandBuffer cmd, uint32_t scope) const
+  {
+    if (scope == GPU_PROFILER_INVALID_QUERY)
+      return;
+
+    const FrameQueries& frame = frames[currentFrame];
+    const Scope& s = frame.scopes[scope];
+    const vk::QueryPool pool = s.isAsync ? frame.computeTimestamps.get() : frame.graphicsTimestamps.get();
+
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, pool, s.firstTimestamp + 1);
+  }
+
+  uint32_t GpuProfiler::ReserveStatisticsQueries(uint32_t scope, uint32_t count)
+  {
+    FrameQueries& frame = frames[currentFrame];
+
+    if (!frame.hasStatistics || scope == GPU_PROFILER_INVALID_QUERY || frame.scopes[scope].isAsync)
+      return GPU_PROFILER_INVALID_QUERY;
+
+    if ((frame.statisticsQueriesCount + count) > MAX_STATISTICS_QUERIES)
+      return GPU_PROFILER_INVALID_QUERY;
+
+    Scope& s = frame.scopes[scope];
+    if (s.statisticsQueriesCount == 0)
+      s.firstStatisticsQuery = frame.statisticsQueriesCount;
+    else if ((s.firstStatisticsQuery + s.statisticsQueriesCount) != frame.statisticsQueriesCount)
+      throw std::runtime_error("GpuProfiler::ReserveStatisticsQueries: queries of a scope have to be reserved one after another");
+
+    const uint32_t firstQuery = frame.statisticsQueriesCount;
+    s.statisticsQueriesCount += count;
+    frame.statisticsQueriesCount += count;
+
+    return firstQuery;
+  }
+
+  void GpuProfiler::BeginStatisticsQuery(vk::CommandBuffer cmd, uint32_t query) const
+  {
+    if (query == GPU_PROFILER_INVALID_QUERY)
+      return;
+
+    cmd.beginQuery(frames[currentFrame].pipelineStatistics.get(), query, vk::QueryControlFlags{});
+  }
+
+  void GpuProfiler::EndStatisticsQuery(vk::CommandBuffer cmd, uint32_t query) const
+  {
+    if (query == GPU_PROFILER_INVALID_QUERY)
+      return;
+
+    cmd.endQuery(frames[currentFrame].pipelineStatistics.get(), query);
+  }
+
+  void GpuProfiler::SetPipelineStatisticsEnabled(bool enabled)
+  {
+    if (enabled && !isPipelineStatisticsSupported)
+      throw std::runtime_error("GpuProfiler::SetPipelineStatisticsEnabled: device doesn't support pipeline statistics queries");
+
+    //pools stay alive, frames in flight may still have queries in them
+    if (enabled)
+      for (FrameQueries& frame : frames)
+        if (!frame.pipelineStatistics)
+          frame.pipelineStatistics = CreateStatisticsPool();
+
+    isPipelineStatisticsEnabled = enabled;
+  }
+
+  vk::UniqueQueryPool GpuProfiler::CreateStatisticsPool() const
+  {
+    const auto createInfo = vk::QueryPoolCreateInfo()
+      .setQueryType(vk::QueryType::ePipelineStatistics)
+      .setQueryCount(MAX_STATISTICS_QUERIES)
+      .setPipelineStatistics(STATISTICS_FLAGS);
+
+    return device.createQueryPoolUnique(createInfo);
+  }
+
+  void GpuProfiler::Resolve(FrameQueries& frame)
+  {
+    if (frame.scopes.empty())
+      return;
+
+    const std::vector<uint64_t> graphicsTimestamps = frame.graphicsTimestamps
+      ? ReadQueries(device, frame.graphicsTimestamps.get(), frame.graphicsTimestampsCount, 1)
+      : std::vector<uint64_t>{};
+
+    const std::vector<uint64_t> computeTimestamps = frame.computeTimestamps
+      ? ReadQueries(device, frame.computeTimestamps.get(), frame.computeTimestampsCount, 1)
+      : std::vector<uint64_t>{};
+
+    const std::vector<uint64_t> statistics = frame.pipelineStatistics
+      ? ReadQueries(device, frame.pipelineStatistics.get(), frame.statisticsQueriesCount, STATISTICS_VALUES_COUNT)
+      : std::vector<uint64_t>{};
+
+    for (const Scope& scope : frame.scopes)
+    {
+      const std::vector<uint64_t>& timestamps = scope.isAsync ? computeTimestamps : graphicsTimestamps;
+      const uint64_t mask = scope.isAsync ? computeTimestampMask : graphicsTimestampMask;
+
+      const uint64_t* begin = &timestamps[scope.firstTimestamp * 2];
+      const uint64_t* end = &timestamps[(scope.firstTimestamp + 1) * 2];
+
+      //timestamps that didn't land (e.g. the scope's work was skipped) give no sample
+      if (begin[1] == 0 || end[1] == 0)
+        continue;
+
+      auto it = history.find(scope.name);
+      if (it == history.end())
+      {
+        ScopeHistory h;
+        h.order = static_cast<uint32_t>(history.size());
+        it = history.emplace(scope.name, h).first;
+      }
+
+      ScopeHistory& h = it->second;
+
+      const uint64_t ticks = (end[0] - begin[0]) & mask;
+      h.milliseconds[h.nextSample] = static_cast<float>(static_cast<double>(ticks) * timestampPeriod / 1000000.0);
+      h.nextSample = (h.nextSample + 1) % HISTORY_SIZE;
+      h.samplesCount = std::min(h.samplesCount + 1, HISTORY_SIZE);
+
+      h.inputAssemblyPrimitives = 0;
+      h.fragmentShaderInvocations = 0;
+      for (uint32_t q = 0; q < scope.statisticsQueriesCount; ++q)
+      {
+        const uint64_t* values = &statistics[(scope.firstStatisticsQuery + q) * (STATISTICS_VALUES_COUNT + 1)];
+        if (values[STATISTICS_VALUES_COUNT] == 0)
+          continue;
+
+        //values go in the order of the flag bits
+        h.inputAssemblyPrimitives += values[0];
+        h.fragmentShaderInvocations += values[1];
+      }
+    }
+  }
+
+  std::vector<GpuScopeStatistics> GpuProfiler::GetStatistics() const
+  {
+    std::vector<GpuScopeStatistics> result(history.size());
+
+    for (const auto& [name, h] : history)
+    {
+      GpuScopeStatistics& stats = result[h.order];
+      stats.name = name;
+      stats.samplesCount = h.samplesCount;
+      stats.inputAssemblyPrimitives = h.inputAssemblyPrimitives;
+      stats.fragmentShaderInvocations = h.fragmentShaderInvocations;
+
+      if (h.samplesCount == 0)
+        continue;
+
+      std::vector<float> samples{ h.milliseconds.begin(), h.milliseconds.begin() + h.samplesCount };
+      std::sort(samples.begin(), samples.end());
+
+      float sum = 0.0f;
+      for (const float ms : samples)
+        sum += ms;
+
+      const size_t p99Index = static_cast<size_t>(std::ceil(0.99 * samples.size())) - 1;
+
+      stats.minMilliseconds = samples.front();
+      stats.avgMilliseconds = sum / samples.size();
+      stats.p99Milliseconds = samples[p99Index];
+    }
+
+    return result;
+  }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace Vulkan
+{
+  constexpr uint32_t GPU_PROFILER_INVALID_QUERY = ~0u;
+
+  //whole graphics work of a frame, written by the render graph
+  constexpr const char* GPU_PROFILER_FRAME_SCOPE = "frame";
+
+  struct GpuScopeStatistics
+  {
+    std::string name;
+    //rolling over the last resolved frames
+    float minMilliseconds = 0.0f;
+    float avgMilliseconds = 0.0f;
+    float p99Milliseconds = 0.0f;
+    uint32_t samplesCount = 0;
+
+    //last resolved frame, zero when pipeline statistics are disabled
+    uint64_t inputAssemblyPrimitives = 0;
+    uint64_t fragmentShaderInvocations = 0;
+  };
+
+  //timestamps around named pieces of the frame's work. every virtual frame has its own query pools,
+  //they are resolved in BeginFrame after the frame timeline passed them, reading results never stalls
+  class GpuProfiler
+  {
+  public:
+    GpuProfiler(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t graphicsFamilyIndex, uint32_t computeFamilyIndex, uint32_t framesCount, bool isPipelineStatisticsSupported);
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    //collects results of the previous use of the virtual frame and starts a new one
+    void BeginFrame(uint32_t virtualFrame);
+
+    //has to be recorded before any other query of the frame, outside of a render pass
+    void ResetQueries(vk::CommandBuffer graphicsCmd, vk::CommandBuffer computeCmd);
+
+    //returns GPU_PROFILER_INVALID_QUERY scope when the queue has no timestamps or the pools are full
+    uint32_t AddScope(const std::string& name, bool isAsync);
+
+    void WriteBeginTimestamp(vk::CommandBuffer cmd, uint32_t scope) const;
+
+    void WriteEndTimestamp(vk::CommandBuffer cmd, uint32_t scope) const;
+
+    //statistics of a scope recorded into several command buffers are summed,
+    //queries are reserved on the recording thread and used by the workers
+    uint32_t ReserveStatisticsQueries(uint32_t scope, uint32_t count);
+
+    void BeginStatisticsQuery(vk::CommandBuffer cmd, uint32_t query) const;
+
+    void EndStatisticsQuery(vk::CommandBuffer cmd, uint32_t query) const;
+
+    //graphics scopes additionally count primitives and fragment invocations
+    void SetPipelineStatisticsEnabled(bool enabled);
+
+    inline bool IsPipelineStatisticsEnabled() const
+    {
+      return isPipelineStatisticsEnabled;
+    }
+
+    //scopes in the order they were first seen
+    std::vector<GpuScopeStatistics> GetStatistics() const;
+
+  private:
+    struct Scope
+    {
+      std::string name;
+      bool isAsync;
+      uint32_t firstTimestamp;
+      uint32_t firstStatisticsQuery;
+      uint32_t statisticsQueriesCount;
+    };
+
+    struct FrameQueries
+    {
+      vk::UniqueQueryPool graphicsTimestamps;
+      vk::UniqueQueryPool computeTimestamps;
+      vk::UniqueQueryPool pipelineStatistics;
+      uint32_t graphicsTimestampsCount = 0;
+      uint32_t computeTimestampsCount = 0;
+      uint32_t statisticsQueriesCount = 0;
+      bool hasStatistics = false;
+      std::vector<Scope> scopes;
+    };
+
+    static constexpr uint32_t HISTORY_SIZE = 128;
+
+    struct ScopeHistory
+    {
+      uint32_t order;
+      std::array<float, HISTORY_SIZE> milliseconds;
+      uint32_t samplesCount = 0;
+      uint32_t nextSample = 0;
+      uint64_t inputAssemblyPrimitives = 0;
+      uint64_t fragmentShaderInvocations = 0;
+    };
+
+    void Resolve(FrameQueries& frame);
+
+    vk::UniqueQueryPool CreateStatisticsPool() const;
+
+  private:
+    vk::Device device;
+    float timestampPeriod;
+    uint64_t graphicsTimestampMask;
+    uint64_t computeTimestampMask;
+    bool isPipelineStatisticsSupported;
+    bool isPipelineStatisticsEnabled;
+
+    std::vector<FrameQueries> frames;
+    uint32_t currentFrame;
+
+    std::map<std::string, ScopeHistory> history;
+  };
+}
@@ -1,8 +1,9 @@
 #pragma once
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
 
+#include "memory_allocator.h"
+
 #include <tuple>
 
 namespace Vulkan
@@ -79,10 +80,10 @@ namespace Vulkan
       view = logicalDevice.createImageViewUnique(viewCreateInfo);
     }
 
-    Image(vk::UniqueImage img, vk::UniqueImageView view, vk::UniqueDeviceMemory memory, vk::UniqueSampler sampler)
-      : image(std::move(img))
+    Image(vk::UniqueImage img, vk::UniqueImageView view, MemoryAllocation memory, vk::UniqueSampler sampler)
+      : memory(std::move(memory))
+      , image(std::move(img))
       , view(std::move(view))
-      , memory(std::move(memory))
       , sampler(std::move(sampler))
     {
       descriptorImageInfo
@@ -93,7 +94,9 @@ namespace Vulkan
 
     inline ImageView GetView() const
     {
-      return ImageView(image.get(), view.get(), descriptorImageInfo, subresourceRange);
+      //swapchain images aren't owned, barriers still need the handle
+      const vk::Image img = image ? image.get() : swapchainImage;
+      return ImageView(img, view.get(), descriptorImageInfo, subresourceRange);
     }
 
     inline vk::Image GetImage() const
@@ -103,7 +106,7 @@ namespace Vulkan
 
     inline vk::DeviceMemory GetMemory() const
     {
-      return memory.get();
+      return memory.GetMemory();
     }
 
     inline vk::Sampler GetSampler() const
@@ -118,9 +121,9 @@ namespace Vulkan
 
   private:
     vk::Image swapchainImage;
+    MemoryAllocation memory;
     vk::UniqueImage image;
     vk::UniqueImageView view;
-    vk::UniqueDeviceMemory memory;
     vk::UniqueSampler sampler;
     vk::DescriptorImageInfo descriptorImageInfo;
     vk::ImageSubresourceRange subresourceRange;
@@ -0,0 +1,487 @@
+#include "memory_allocator.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+  constexpr vk::DeviceSize MinSizeClass = 256;
+  constexpr uint32_t SizeClassesCount = 9; // 256 .. 64KB
+  constexpr vk::DeviceSize MaxSizeClass = MinSizeClass << (SizeClassesCount - 1);
+  constexpr vk::DeviceSize SizeClassPageSize = 1024 * 1024;
+
+  constexpr vk::DeviceSize BuddyLeafSize = MaxSizeClass;
+  constexpr vk::DeviceSize PreferredBuddyBlockSize = 64 * 1024 * 1024;
+
+  constexpr uint32_t TilingsCount = 2;
+
+  uint32_t GetSizeClass(vk::DeviceSize size)
+  {
+    uint32_t sizeClass = 0;
+    while ((MinSizeClass << sizeClass) < size)
+      ++sizeClass;
+
+    return sizeClass;
+  }
+
+  uint32_t GetBuddyOrder(vk::DeviceSize size)
+  {
+    uint32_t order = 0;
+    while ((BuddyLeafSize << order) < size)
+      ++order;
+
+    return order;
+  }
+
+  vk::DeviceSize GetBuddyBlockSize(vk::DeviceSize heapSize)
+  {
+    vk::DeviceSize blockSize = PreferredBuddyBlockSize;
+    while (blockSize > BuddyLeafSize && blockSize > heapSize / 8)
+      blockSize >>= 1;
+
+    return blockSize;
+  }
+}
+
+namespace Vulkan
+{
+  MemoryAllocation::MemoryAllocation(MemoryAllocator* allocator, const MemoryRegion& region)
+    : allocator(allocator)
+    , region(region)
+  {
+  }
+
+  MemoryAllocation::MemoryAllocation(MemoryAllocation&& r) noexcept
+    : allocator(r.allocator)
+    , region(r.region)
+  {
+    r.allocator = nullptr;
+    r.region = MemoryRegion{};
+  }
+
+  MemoryAllocation& MemoryAllocation::operator=(MemoryAllocation&& r) noexcept
+  {
+    if (this != &r)
+    {
+      Release();
+
+      allocator = r.allocator;
+      region = r.region;
+
+      r.allocator = nullptr;
+      r.region = MemoryRegion{};
+    }
+
+    return *this;
+  }
+
+  MemoryAllocation::~MemoryAllocation()
+  {
+    Release();
+  }
+
+  void MemoryAllocation::Release()
+  {
+    if (allocator != nullptr)
+      allocator->Free(region);
+
+    allocator = nullptr;
+    region = MemoryRegion{};
+  }
+
+  MemoryAllocator::MemoryAllocator(vk::PhysicalDevice physicalDevice, vk::Device logicalDevice)
+    : logicalDevice(logicalDevice)
+    , memoryProperties(physicalDevice.getMemoryProperties())
+  {
+    pools.resize(memoryProperties.memoryTypeCount * TilingsCount);
+
+    for (uint32_t typeIndex = 0; typeIndex < memoryProperties.memoryTypeCount; ++typeIndex)
+    {
+      const vk::MemoryType& memType = memoryProperties.memoryTypes[typeIndex];
+      const vk::DeviceSize heapSize = memoryProperties.memoryHeaps[memType.heapIndex].size;
+
+      for (uint32_t tiling = 0; tiling < TilingsCount; ++tiling)
+      {
+        MemoryPool& pool = pools[typeIndex * TilingsCount + tiling];
+        pool.memoryTypeIndex = typeIndex;
+        pool.tiling = static_cast<ResourceTiling>(tiling);
+        pool.hostVisible = static_cast<bool>(memType.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible);
+        pool.buddyBlockSize = GetBuddyBlockSize(heapSize);
+        pool.buddyOrdersCount = GetBuddyOrder(pool.buddyBlockSize) + 1;
+        pool.sizeClasses.resize(SizeClassesCount);
+      }
+    }
+  }
+
+  MemoryAllocator::~MemoryAllocator()
+  {
+    for (MemoryPool& pool : pools)
+    {
+      for (SizeClassPool& sizeClass : pool.sizeClasses)
+        for (SizeClassPage& page : sizeClass.pages)
+          FreeDeviceMemory(page.memory, page.mappedMemory);
+
+      for (std::unique_ptr<BuddyBlock>& block : pool.buddyBlocks)
+        if (block)
+          FreeDeviceMemory(block->memory, block->mappedMemory);
+    }
+  }
+
+  MemoryAllocation MemoryAllocator::Allocate(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceTiling tiling)
+  {
+    if ((requirements.memoryTypeBits & (1u << memoryTypeIndex)) == 0)
+      throw std::runtime_error("MemoryAllocator::Allocate: resource can't be placed in the requested memory type.");
+
+    const uint32_t poolIndex = memoryTypeIndex * TilingsCount + static_cast<uint32_t>(tiling);
+    MemoryPool& pool = pools.at(poolIndex);
+
+    //every slot and buddy node is aligned to its own power of two size
+    const vk::DeviceSize size = std::max(requirements.size, requirements.alignment);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryRegion region;
+    if (size <= MaxSizeClass)
+      region = AllocateFromSizeClass(pool, poolIndex, size);
+    else if (size <= pool.buddyBlockSize)
+      region = AllocateFromBuddy(pool, poolIndex, size);
+    else
+      region = AllocateDedicated(pool, poolIndex, size);
+
+    region.requestedSize = requirements.size;
+
+    ++pool.allocationsCount;
+    pool.allocatedBytes += region.size;
+    pool.requestedBytes += region.requestedSize;
+
+    return MemoryAllocation{ this, region };
+  }
+
+  void MemoryAllocator::Free(const MemoryRegion& region)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryPool& pool = pools.at(region.poolIndex);
+
+    --pool.allocationsCount;
+    pool.allocatedBytes -= region.size;
+    pool.requestedBytes -= region.requestedSize;
+
+    switch (region.scheme)
+    {
+    case MemoryAllocationScheme::SizeClass:
+      FreeSizeClass(pool, region);
+      break;
+
+    case MemoryAllocationScheme::Buddy:
+      FreeBuddy(pool, region);
+      break;
+
+    case MemoryAllocationScheme::Dedicated:
+      --pool.dedicatedAllocationsCount;
+      pool.dedicatedBytes -= region.size;
+      FreeDeviceMemory(region.memory, region.mappedMemory);
+      break;
+    }
+  }
+
+  MemoryRegion MemoryAllocator::AllocateFromSizeClass(MemoryPool& pool, uint32_t poolIndex, vk::DeviceSize size)
+  {
+    const uint32_t sizeClass = GetSizeClass(size);
+    const vk::DeviceSize slotSize = MinSizeClass << sizeClass;
+    SizeClassPool& classPool = pool.sizeClasses[sizeClass];
+
+    uint32_t pageIndex = uint32_t(-1);
+    for (uint32_t i = 0; i < classPool.pages.size(); ++i)
+    {
+      if (classPool.pages[i].memory && !classPool.pages[i].freeSlots.empty())
+      {
+        pageIndex = i;
+        break;
+      }
+    }
+
+    if (pageIndex == uint32_t(-1))
+    {
+      //reuse a released page entry so indices of live allocations stay valid
+      const auto it = std::find_if(classPool.pages.begin(), classPool.pages.end(), [](const SizeClassPage& p) { return !p.memory; });
+      pageIndex = static_cast<uint32_t>(std::distance(classPool.pages.begin(), it));
+      if (it == classPool.pages.end())
+        classPool.pages.emplace_back();
+
+      SizeClassPage& page = classPool.pages[pageIndex];
+      std::tie(page.memory, page.mappedMemory) = AllocateDeviceMemory(pool, SizeClassPageSize);
+
+      const uint32_t slotsCount = static_cast<uint32_t>(SizeClassPageSize / slotSize);
+      page.freeSlots.resize(slotsCount);
+      for (uint32_t slot = 0; slot < slotsCount; ++slot)
+        page.freeSlots[slot] = slotsCount - slot - 1;
+    }
+
+    SizeClassPage& page = classPool.pages[pageIndex];
+    const uint32_t slot = page.freeSlots.back();
+    page.freeSlots.pop_back();
+
+    MemoryRegion region;
+    region.memory = page.memory;
+    region.offset = slot * slotSize;
+    region.size = slotSize;
+    region.mappedMemory = page.mappedMemory ? static_cast<char*>(page.mappedMemory) + region.offset : nullptr;
+    region.scheme = MemoryAllocationScheme::SizeClass;
+    region.poolIndex = poolIndex;
+    region.sizeClass = sizeClass;
+    region.blockIndex = pageIndex;
+
+    return region;
+  }
+
+  void MemoryAllocator::FreeSizeClass(MemoryPool& pool, const MemoryRegion& region)
+  {
+    SizeClassPool& classPool = pool.sizeClasses[region.sizeClass];
+    SizeClassPage& page = classPool.pages[region.blockIndex];
+
+    page.freeSlots.push_back(static_cast<uint32_t>(region.offset / region.size));
+
+    const uint32_t slotsCount = static_cast<uint32_t>(SizeClassPageSize / region.size);
+    if (page.freeSlots.size() < slotsCount)
+      return;
+
+    //keep one empty page alive to avoid allocate/free ping-pong on every draw
+    const size_t livePages = std::count_if(classPool.pages.begin(), classPool.pages.end(), [](const SizeClassPage& p) { return static_cast<bool>(p.memory); });
+    if (livePages <= 1)
+      return;
+
+    FreeDeviceMemory(page.memory, page.mappedMemory);
+    page = SizeClassPage{};
+  }
+
+  MemoryRegion MemoryAllocator::AllocateFromBuddy(MemoryPool& pool, uint32_t poolIndex, vk::DeviceSize size)
+  {
+    const uint32_t order = GetBuddyOrder(size);
+
+    auto findFreeOrder = [&](const BuddyBlock& block)
+    {
+      uint32_t freeOrder = order;
+      while (freeOrder < pool.buddyOrdersCount && block.freeLists[freeOrder].empty())
+        ++freeOrder;
+
+      return freeOrder;
+    };
+
+    //every live block is tried before a new one is allocated from the device
+    uint32_t blockIndex = 0;
+    uint32_t freeOrder = pool.buddyOrdersCount;
+    for (; blockIndex < pool.buddyBlocks.size(); ++blockIndex)
+    {
+      if (!pool.buddyBlocks[blockIndex])
+        continue;
+
+      freeOrder = findFreeOrder(*pool.buddyBlocks[blockIndex]);
+      if (freeOrder < pool.buddyOrdersCount)
+        break;
+    }
+
+    if (freeOrder == pool.buddyOrdersCount)
+    {
+      //released block entries are reused so indices of live allocations stay valid
+      const auto it = std::find_if(pool.buddyBlocks.begin(), pool.buddyBlocks.end(), [](const std::unique_ptr<BuddyBlock>& b) { return !b; });
+      blockIndex = static_cast<uint32_t>(std::distance(pool.buddyBlocks.begin(), it));
+      if (it == pool.buddyBlocks.end())
+        pool.buddyBlocks.emplace_back();
+
+      auto block = std::make_unique<BuddyBlock>();
+      std::tie(block->memory, block->mappedMemory) = AllocateDeviceMemory(pool, pool.buddyBlockSize);
+      block->freeLists.resize(pool.buddyOrdersCount);
+      block->freeLists.back().insert(0);
+      pool.buddyBlocks[blockIndex] = std::move(block);
+
+      freeOrder = findFreeOrder(*pool.buddyBlocks[blockIndex]);
+      if (freeOrder == pool.buddyOrdersCount)
+        throw std::runtime_error("MemoryAllocator::AllocateFromBuddy: failed to find free buddy block.");
+    }
+
+    BuddyBlock& block = *pool.buddyBlocks[blockIndex];
+
+    const vk::DeviceSize offset = *block.freeLists[freeOrder].begin();
+    block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+
+    while (freeOrder > order)
+    {
+      --freeOrder;
+      block.freeLists[freeOrder].insert(offset + (BuddyLeafSize << freeOrder));
+    }
+
+    block.allocatedOrders[offset] = order;
+    block.usedBytes += BuddyLeafSize << order;
+
+    MemoryRegion region;
+    region.memory = block.memory;
+    region.offset = offset;
+    region.size = BuddyLeafSize << order;
+    region.mappedMemory = block.mappedMemory ? static_cast<char*>(block.mappedMemory) + offset : nullptr;
+    region.scheme = MemoryAllocationScheme::Buddy;
+    region.poolIndex = poolIndex;
+    region.blockIndex = blockIndex;
+
+    return region;
+  }
+
+  void MemoryAllocator::FreeBuddy(MemoryPool& pool, const MemoryRegion& region)
+  {
+    BuddyBlock& block = *pool.buddyBlocks[region.blockIndex];
+
+    const auto it = block.allocatedOrders.find(region.offset);
+    if (it == block.allocatedOrders.end())
+      throw std::runtime_error("MemoryAllocator::FreeBuddy: region is not allocated.");
+
+    uint32_t order = it->second;
+    vk::DeviceSize offset = region.offset;
+    block.allocatedOrders.erase(it);
+    block.usedBytes -= BuddyLeafSize << order;
+
+    while (order + 1 < pool.buddyOrdersCount)
+    {
+      const vk::DeviceSize buddy = offset ^ (BuddyLeafSize << order);
+      const auto buddyIt = block.freeLists[order].find(buddy);
+      if (buddyIt == block.freeLists[order].end())
+        break;
+
+      block.freeLists[order].erase(buddyIt);
+      offset = std::min(offset, buddy);
+      ++order;
+    }
+
+    block.freeLists[order].insert(offset);
+
+    if (block.usedBytes != 0)
+      return;
+
+    const size_t liveBlocks = std::count_if(pool.buddyBlocks.begin(), pool.buddyBlocks.end(), [](const std::unique_ptr<BuddyBlock>& b) { return static_cast<bool>(b); });
+    if (liveBlocks <= 1)
+      return;
+
+    FreeDeviceMemory(block.memory, block.mappedMemory);
+    pool.buddyBlocks[region.blockIndex].reset();
+  }
+
+  MemoryRegion MemoryAllocator::AllocateDedicated(MemoryPool& pool, uint32_t poolIndex, vk::DeviceSize size)
+  {
+    MemoryRegion region;
+    std::tie(region.memory, region.mappedMemory) = AllocateDeviceMemory(pool, size);
+    region.offset = 0;
+    region.size = size;
+    region.scheme = MemoryAllocationScheme::Dedicated;
+    region.poolIndex = poolIndex;
+
+    ++pool.dedicatedAllocationsCount;
+    pool.dedicatedBytes += size;
+
+    return region;
+  }
+
+  std::tuple<vk::DeviceMemory, void*> MemoryAllocator::AllocateDeviceMemory(const MemoryPool& pool, vk::DeviceSize size)
+  {
+    const auto memAllocateInfo = vk::MemoryAllocateInfo()
+      .setAllocationSize(size)
+      .setMemoryTypeIndex(pool.memoryTypeIndex);
+
+    vk::DeviceMemory memory = logicalDevice.allocateMemory(memAllocateInfo);
+
+    void* mappedMemory = pool.hostVisible
+      ? logicalDevice.mapMemory(memory, 0, VK_WHOLE_SIZE)
+      : nullptr;
+
+    return { memory, mappedMemory };
+  }
+
+  void MemoryAllocator::FreeDeviceMemory(vk::DeviceMemory memory, void* mappedMemory)
+  {
+    if (!memory)
+      return;
+
+    if (mappedMemory != nullptr)
+      logicalDevice.unmapMemory(memory);
+
+    logicalDevice.freeMemory(memory);
+  }
+
+  MemoryStatistics MemoryAllocator::GetStatistics() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryStatistics stats;
+    stats.memoryTypes.resize(memoryProperties.memoryTypeCount);
+
+    for (const MemoryPool& pool : pools)
+    {
+      MemoryTypeStatistics& typeStats = stats.memoryTypes[pool.memoryTypeIndex];
+      typeStats.memoryTypeIndex = pool.memoryTypeIndex;
+      typeStats.allocationsCount += pool.allocationsCount;
+      typeStats.dedicatedAllocationsCount += pool.dedicatedAllocationsCount;
+      typeStats.deviceMemoryCount += pool.dedicatedAllocationsCount;
+      typeStats.reservedBytes += pool.dedicatedBytes;
+      typeStats.allocatedBytes += pool.allocatedBytes;
+      typeStats.requestedBytes += pool.requestedBytes;
+
+      for (uint32_t sizeClass = 0; sizeClass < pool.sizeClasses.size(); ++sizeClass)
+      {
+        const vk::DeviceSize slotSize = MinSizeClass << sizeClass;
+
+        for (const SizeClassPage& page : pool.sizeClasses[sizeClass].pages)
+        {
+          if (!page.memory)
+            continue;
+
+          ++typeStats.deviceMemoryCount;
+          typeStats.reservedBytes += SizeClassPageSize;
+          typeStats.freeBytes += page.freeSlots.size() * slotSize;
+
+          if (!page.freeSlots.empty())
+            typeStats.largestFreeRegion = std::max(typeStats.largestFreeRegion, slotSize);
+        }
+      }
+
+      for (const std::unique_ptr<BuddyBlock>& block : pool.buddyBlocks)
+      {
+        if (!block)
+          continue;
+
+        ++typeStats.deviceMemoryCount;
+        typeStats.reservedBytes += pool.buddyBlockSize;
+        typeStats.freeBytes += pool.buddyBlockSize - block->usedBytes;
+
+        for (uint32_t order = 0; order < block->freeLists.size(); ++order)
+          if (!block->freeLists[order].empty())
+            typeStats.largestFreeRegion = std::max(typeStats.largestFreeRegion, BuddyLeafSize << order);
+      }
+    }
+
+    auto computeFragmentation = [](MemoryTypeStatistics& s)
+    {
+      s.internalFragmentation = s.allocatedBytes > 0
+        ? 1.0f - static_cast<float>(s.requestedBytes) / static_cast<float>(s.allocatedBytes)
+        : 0.0f;
+
+      s.externalFragmentation = s.freeBytes > 0
+        ? 1.0f - static_cast<float>(s.largestFreeRegion) / static_cast<float>(s.freeBytes)
+        : 0.0f;
+    };
+
+    for (MemoryTypeStatistics& typeStats : stats.memoryTypes)
+    {
+      computeFragmentation(typeStats);
+
+      stats.total.deviceMemoryCount += typeStats.deviceMemoryCount;
+      stats.total.allocationsCount += typeStats.allocationsCount;
+      stats.total.dedicatedAllocationsCount += typeStats.dedicatedAllocationsCount;
+      stats.total.reservedBytes += typeStats.reservedBytes;
+      stats.total.allocatedBytes += typeStats.allocatedBytes;
+      stats.total.requestedBytes += typeStats.requestedBytes;
+      stats.total.freeBytes += typeStats.freeBytes;
+      stats.total.largestFreeRegion = std::max(stats.total.largestFreeRegion, typeStats.largestFreeRegion);
+    }
+    computeFragmentation(stats.total);
+
+    return stats;
+  }
+}
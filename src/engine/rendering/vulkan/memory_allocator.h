@@ -0,0 +1,201 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace Vulkan
+{
+  class MemoryAllocator;
+
+  enum class MemoryAllocationScheme
+  {
+    SizeClass,
+    Buddy,
+    Dedicated
+  };
+
+  //buffers and optimal images are kept in different pools
+  //so bufferImageGranularity never has to be taken into account
+  enum class ResourceTiling
+  {
+    Linear,
+    Optimal
+  };
+
+  struct MemoryRegion
+  {
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    vk::DeviceSize requestedSize = 0;
+    void* mappedMemory = nullptr;
+
+    MemoryAllocationScheme scheme = MemoryAllocationScheme::Dedicated;
+    uint32_t poolIndex = 0;
+    uint32_t sizeClass = 0;
+    uint32_t blockIndex = 0;
+  };
+
+  class MemoryAllocation
+  {
+  public:
+    MemoryAllocation() = default;
+
+    MemoryAllocation(MemoryAllocator* allocator, const MemoryRegion& region);
+
+    MemoryAllocation(MemoryAllocation&& r) noexcept;
+
+    MemoryAllocation& operator=(MemoryAllocation&& r) noexcept;
+
+    MemoryAllocation(const MemoryAllocation&) = delete;
+
+    MemoryAllocation& operator=(const MemoryAllocation&) = delete;
+
+    ~MemoryAllocation();
+
+    inline vk::DeviceMemory GetMemory() const
+    {
+      return region.memory;
+    }
+
+    inline vk::DeviceSize GetOffset() const
+    {
+      return region.offset;
+    }
+
+    inline vk::DeviceSize GetSize() const
+    {
+      return region.requestedSize;
+    }
+
+    //host visible memory is mapped once for the whole block lifetime
+    inline void* GetMappedMemory() const
+    {
+      return region.mappedMemory;
+    }
+
+    inline const MemoryRegion& GetRegion() const
+    {
+      return region;
+    }
+
+  private:
+    void Release();
+
+  private:
+    MemoryAllocator* allocator = nullptr;
+    MemoryRegion region;
+  };
+
+  struct MemoryTypeStatistics
+  {
+    uint32_t memoryTypeIndex = 0;
+    uint32_t deviceMemoryCount = 0;
+    uint32_t allocationsCount = 0;
+    uint32_t dedicatedAllocationsCount = 0;
+
+    vk::DeviceSize reservedBytes = 0;
+    vk::DeviceSize allocatedBytes = 0;
+    vk::DeviceSize requestedBytes = 0;
+    vk::DeviceSize freeBytes = 0;
+    vk::DeviceSize largestFreeRegion = 0;
+
+    //1 - requested/allocated: memory lost on size rounding
+    float internalFragmentation = 0.0f;
+    //1 - largestFree/free: how scattered the free space of the buddy blocks is
+    float externalFragmentation = 0.0f;
+  };
+
+  struct MemoryStatistics
+  {
+    std::vector<MemoryTypeStatistics> memoryTypes;
+    MemoryTypeStatistics total;
+  };
+
+  class MemoryAllocator
+  {
+    friend class MemoryAllocation;
+
+    struct SizeClassPage
+    {
+      vk::DeviceMemory memory;
+      void* mappedMemory = nullptr;
+      std::vector<uint32_t> freeSlots;
+    };
+
+    struct SizeClassPool
+    {
+      std::vector<SizeClassPage> pages;
+    };
+
+    struct BuddyBlock
+    {
+      vk::DeviceMemory memory;
+      void* mappedMemory = nullptr;
+      //free offsets per order, order 0 is the smallest buddy leaf
+      std::vector<std::set<vk::DeviceSize>> freeLists;
+      std::map<vk::DeviceSize, uint32_t> allocatedOrders;
+      vk::DeviceSize usedBytes = 0;
+    };
+
+    struct MemoryPool
+    {
+      uint32_t memoryTypeIndex = 0;
+      ResourceTiling tiling = ResourceTiling::Linear;
+      bool hostVisible = false;
+      vk::DeviceSize buddyBlockSize = 0;
+      uint32_t buddyOrdersCount = 0;
+
+      std::vector<SizeClassPool> sizeClasses;
+      std::vector<std::unique_ptr<BuddyBlock>> buddyBlocks;
+
+      uint32_t dedicatedAllocationsCount = 0;
+      vk::DeviceSize dedicatedBytes = 0;
+      uint32_t allocationsCount = 0;
+      vk::DeviceSize allocatedBytes = 0;
+      vk::DeviceSize requestedBytes = 0;
+    };
+
+  public:
+    MemoryAllocator(vk::PhysicalDevice physicalDevice, vk::Device logicalDevice);
+
+    ~MemoryAllocator();
+
+    //thread safe, recording workers grow their uniform rings concurrently
+    MemoryAllocation Allocate(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceTiling tiling);
+
+    MemoryStatistics GetStatistics() const;
+
+  private:
+    void Free(const MemoryRegion& region);
+
+    MemoryRegion AllocateFromSizeClass(MemoryPool& pool, uint32_t poolIndex, vk::DeviceSize size);
+
+    MemoryRegion AllocateFromBuddy(MemoryPool& pool, uint32_t poolIndex, vk::DeviceSize size);
+
+    MemoryRegion AllocateDedicated(MemoryPool& pool, uint32_t poolIndex, vk::DeviceSize size);
+
+    void FreeSizeClass(MemoryPool& pool, const MemoryRegion& region);
+
+    void FreeBuddy(MemoryPool& pool, const MemoryRegion& region);
+
+    std::tuple<vk::DeviceMemory, void*> AllocateDeviceMemory(const MemoryPool& pool, vk::DeviceSize size);
+
+    void FreeDeviceMemory(vk::DeviceMemory memory, void* mappedMemory);
+
+  private:
+    vk::Device logicalDevice;
+    vk::PhysicalDeviceMemoryProperties memoryProperties;
+
+    std::vector<MemoryPool> pools;
+
+    //guards the pools, their pages and free lists
+    mutable std::mutex mutex;
+  };
+}
@@ -1,30 +1,54 @@
 #include "pipeline.h"
 #include "vertex_input_declaration.h"
 
+namespace
+{
+  vk::UniquePipelineLayout CreatePipelineLayout(vk::Device logicalDevice, const std::vector<vk::DescriptorSetLayout>& layouts, const Vulkan::PushConstantDescription& pushConstants)
+  {
+    const auto pushConstantRange = vk::PushConstantRange()
+      .setStageFlags(Vulkan::GetShaderStageFlags(pushConstants.stages))
+      .setOffset(pushConstants.offset)
+      .setSize(pushConstants.size);
+
+    const auto pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
+      .setSetLayoutCount(layouts.size())
+      .setPSetLayouts(layouts.data())
+      .setPushConstantRangeCount(pushConstants.size != 0 ? 1 : 0)
+      .setPPushConstantRanges(&pushConstantRange);
+
+    return logicalDevice.createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+  }
+}
+
 namespace Vulkan
 {
 
   Pipeline::Pipeline(vk::Device logicalDevice,
+    vk::PipelineCache pipelineCache,
     const ShaderProgram& program,
     const VertexInputDeclaration& vertexInputDeclaration,
     const std::vector<vk::DescriptorSetLayout> layouts,
     const vk::PrimitiveTopology topology,
     const DepthStencilSettings& depthStencilSettings,
     const RasterizationMode& rasterMode,
-    const vk::Extent2D viewportExtent,
     const vk::RenderPass renderpass,
     const uint32_t subpass,
     const std::vector<vk::PipelineColorBlendAttachmentState>& colorAttachmentBlendStates)
   {
+    //map entries of constants a stage doesn't declare are ignored by it
+    const vk::SpecializationInfo specializationInfo = program.GetSpecialization().GetInfo();
+
     const auto vertexStageCreateInfo = vk::PipelineShaderStageCreateInfo()
       .setStage(vk::ShaderStageFlagBits::eVertex)
       .setModule(program.GetVertexShader().GetModule())
-      .setPName("main");
+      .setPName("main")
+      .setPSpecializationInfo(&specializationInfo);
 
     const auto fragmentStageCreateInfo = vk::PipelineShaderStageCreateInfo()
       .setStage(vk::ShaderStageFlagBits::eFragment)
       .setModule(program.GetFragmentShader().GetModule())
-      .setPName("main");
+      .setPName("main")
+      .setPSpecializationInfo(&specializationInfo);
 
     vk::PipelineShaderStageCreateInfo stageCreateInfos[]{
       fragmentStageCreateInfo,
@@ -41,28 +65,20 @@ namespace Vulkan
       .setTopology(topology)
       .setPrimitiveRestartEnable(false);
 
-    const vk::Viewport viewports[]{
-      vk::Viewport()
-      .setHeight((float)viewportExtent.height)
-      .setWidth((float)viewportExtent.width)
-      .setX(0.0f)
-      .setY(0.0f)
-      .setMinDepth(0.0f)
-      .setMaxDepth(1.0f)
-    };
-
-    const vk::Rect2D scissors[]{
-      vk::Rect2D()
-      .setExtent(viewportExtent)
-      .setOffset({0, 0})
-    };
-
+    //viewport and scissor are set by the render graph, pipelines don't depend on the target's size
     const auto viewportState = vk::PipelineViewportStateCreateInfo()
-      .setPScissors(scissors)
       .setScissorCount(1)
-      .setPViewports(viewports)
       .setViewportCount(1);
 
+    const vk::DynamicState dynamicStates[]{
+      vk::DynamicState::eViewport,
+      vk::DynamicState::eScissor
+    };
+
+    const auto dynamicStateCreateInfo = vk::PipelineDynamicStateCreateInfo()
+      .setDynamicStateCount(2)
+      .setPDynamicStates(dynamicStates);
+
     const auto rasterizationStateCreateInfo = vk::PipelineRasterizationStateCreateInfo()
       .setDepthClampEnable(rasterMode.depthClampEnable)
       .setRasterizerDiscardEnable(rasterMode.rasterizerDiscardEnable)
@@ -88,11 +104,7 @@ namespace Vulkan
       .setDepthBoundsTestEnable(false)
       .setStencilTestEnable(false);
 
-    const auto pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
-      .setSetLayoutCount(layouts.size())
-      .setPSetLayouts(layouts.data());
-
-    layout = logicalDevice.createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+    layout = CreatePipelineLayout(logicalDevice, layouts, program.GetCombinedUniformsInformation().pushConstants);
 
     const auto pipelineCreateInfo = vk::GraphicsPipelineCreateInfo()
       .setStageCount(2)
@@ -105,12 +117,27 @@ namespace Vulkan
       .setPMultisampleState(&multisampleStateCreateInfo)
       .setPDepthStencilState(&depthStencilStateCreateInfo)
       .setPColorBlendState(&colorBlendStateCreateInfo)
-      .setPDynamicState(nullptr)
+      .setPDynamicState(&dynamicStateCreateInfo)
       .setLayout(layout.get())
       .setRenderPass(renderpass)
       .setSubpass(subpass);
 
-    pipeline = logicalDevice.createGraphicsPipelineUnique(nullptr, pipelineCreateInfo);
+    pipeline = logicalDevice.createGraphicsPipelineUnique(pipelineCache, pipelineCreateInfo);
   }
 
+  ComputePipeline::ComputePipeline(vk::Device logicalDevice, vk::PipelineCache pipelineCache, const ComputeProgram& program, const std::vector<vk::DescriptorSetLayout> layouts)
+  {
+    const auto computeStageCreateInfo = vk::PipelineShaderStageCreateInfo()
+      .setStage(vk::ShaderStageFlagBits::eCompute)
+      .setModule(program.GetComputeShader().GetModule())
+      .setPName("main");
+
+    layout = CreatePipelineLayout(logicalDevice, layouts, program.GetCombinedUniformsInformation().pushConstants);
+
+    const auto pipelineCreateInfo = vk::ComputePipelineCreateInfo()
+      .setStage(computeStageCreateInfo)
+      .setLayout(layout.get());
+
+    pipeline = logicalDevice.createComputePipelineUnique(pipelineCache, pipelineCreateInfo);
+  }
 }
\ No newline at end of file
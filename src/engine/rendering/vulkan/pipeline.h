@@ -14,13 +14,13 @@ namespace Vulkan
   {
   public:
     Pipeline(vk::Device logicalDevice,
+      vk::PipelineCache pipelineCache,
       const ShaderProgram& program,
       const VertexInputDeclaration& vertexInputDeclaration,
       const std::vector<vk::DescriptorSetLayout> layouts,
       const vk::PrimitiveTopology topology,
       const DepthStencilSettings& depthStencilSettings,
       const RasterizationMode& rasterMode,
-      const vk::Extent2D viewportExtent,
       const vk::RenderPass renderpass,
       const uint32_t subpass,
       const std::vector<vk::PipelineColorBlendAttachmentState>& colorAttachmentBlendStates);
@@ -45,4 +45,24 @@ namespace Vulkan
     vk::UniquePipelineLayout layout;
     PipelineUniforms uniformsDescriptions;
   };
+
+  class ComputePipeline
+  {
+  public:
+    ComputePipeline(vk::Device logicalDevice, vk::PipelineCache pipelineCache, const ComputeProgram& program, const std::vector<vk::DescriptorSetLayout> layouts);
+
+    inline vk::Pipeline GetPipeline() const
+    {
+      return pipeline.get();
+    }
+
+    inline vk::PipelineLayout GetLayout() const
+    {
+      return layout.get();
+    }
+
+  private:
+    vk::UniquePipeline pipeline;
+    vk::UniquePipelineLayout layout;
+  };
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "pipeline_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+  constexpr uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x43505341; //"ASPC"
+  constexpr uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+  struct PipelineCacheFileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorId;
+    uint32_t deviceId;
+    uint32_t driverVersion;
+    uint8_t deviceUUID[VK_UUID_SIZE];
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+  };
+}
+
+namespace Vulkan
+{
+  PipelineCache::PipelineCache(vk::PhysicalDevice physicalDevice, vk::Device device, const std::string& path)
+    : device(device)
+    , path(path)
+    , hits(0)
+    , misses(0)
+    , isChanged(false)
+  {
+    const auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+    const vk::PhysicalDeviceProperties& deviceProperties = properties.get<vk::PhysicalDeviceProperties2>().properties;
+    const vk::PhysicalDeviceIDProperties& idProperties = properties.get<vk::PhysicalDeviceIDProperties>();
+
+    vendorId = deviceProperties.vendorID;
+    deviceId = deviceProperties.deviceID;
+    driverVersion = deviceProperties.driverVersion;
+    std::copy(std::begin(idProperties.deviceUUID), std::end(idProperties.deviceUUID), deviceUUID.begin());
+    std::copy(std::begin(deviceProperties.pipelineCacheUUID), std::end(deviceProperties.pipelineCacheUUID), pipelineCacheUUID.begin());
+
+    const std::vector<char> data = LoadData();
+
+    const auto cacheCreateInfo = vk::PipelineCacheCreateInfo()
+      .setInitialDataSize(data.size())
+      .setPInitialData(data.empty() ? nullptr : data.data());
+
+    cache = device.createPipelineCacheUnique(cacheCreateInfo);
+
+    statistics.isLoadedFromDisk = !data.empty();
+    statistics.loadedBytes = data.size();
+  }
+
+  PipelineCache::~PipelineCache()
+  {
+    SaveIfChanged();
+  }
+
+  std::vector<char> PipelineCache::LoadData() const
+  {
+    std::ifstream file{ path, std::ios::binary };
+    if (file.is_open() == false)
+      return {};
+
+    PipelineCacheFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+      return {};
+
+    const bool isSameDevice = header.magic == PIPELINE_CACHE_FILE_MAGIC &&
+                              header.version == PIPELINE_CACHE_FILE_VERSION &&
+                              header.vendorId == vendorId &&
+                              header.deviceId == deviceId &&
+                              header.driverVersion == driverVersion &&
+                              std::memcmp(header.deviceUUID, deviceUUID.data(), VK_UUID_SIZE) == 0 &&
+                              std::memcmp(header.pipelineCacheUUID, pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+
+    if (!isSameDevice)
+      return {};
+
+    //truncated or corrupted file, the size isn't trusted before allocating
+    const std::streampos dataBegin = file.tellg();
+    if (!file.seekg(0, std::ios::end))
+      return {};
+
+    const std::streamoff remainingSize = file.tellg() - dataBegin;
+    if (remainingSize < 0 || header.dataSize != static_cast<uint64_t>(remainingSize))
+      return {};
+
+    file.seekg(dataBegin);
+
+    std::vector<char> data(header.dataSize);
+    if (!file.read(data.data(), data.size()))
+      return {};
+
+    return data;
+  }
+
+  void PipelineCache::Save()
+  {
+    const std::vector<uint8_t> data = device.getPipelineCacheData(cache.get());
+
+    PipelineCacheFileHeader header;
+    header.magic = PIPELINE_CACHE_FILE_MAGIC;
+    header.version = PIPELINE_CACHE_FILE_VERSION;
+    header.vendorId = vendorId;
+    header.deviceId = deviceId;
+    header.driverVersion = driverVersion;
+    std::memcpy(header.deviceUUID, deviceUUID.data(), VK_UUID_SIZE);
+    std::memcpy(header.pipelineCacheUUID, pipelineCacheUUID.data(), VK_UUID_SIZE);
+    header.dataSize = data.size();
+
+    //written next to the old file and swapped, interrupted save doesn't leave a broken cache
+    const std::string tmpPath = path + ".tmp";
+    {
+      std::ofstream file{ tmpPath, std::ios::binary | std::ios::trunc };
+      if (file.is_open() == false)
+        throw std::runtime_error("PipelineCache::Save: can't open " + tmpPath);
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+      if (!file)
+        throw std::runtime_error("PipelineCache::Save: failed to write " + tmpPath);
+    }
+
+    std::filesystem::rename(tmpPath, path);
+
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    statistics.savedBytes = data.size();
+    isChanged = false;
+  }
+
+  void PipelineCache::SaveIfChanged()
+  {
+    {
+      std::lock_guard<std::mutex> lock(statisticsMutex);
+      if (!isChanged)
+        return;
+    }
+
+    //failing to persist the cache only costs the next startup
+    try
+    {
+      Save();
+    }
+    catch (const std::exception&)
+    {
+    }
+  }
+
+  void PipelineCache::OnPipelineHit()
+  {
+    hits.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void PipelineCache::OnPipelineCreated(double milliseconds)
+  {
+    misses.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    statistics.creationMilliseconds += milliseconds;
+    statistics.maxCreationMilliseconds = std::max(statistics.maxCreationMilliseconds, milliseconds);
+    isChanged = true;
+  }
+
+  PipelineCacheStatistics PipelineCache::GetStatistics() const
+  {
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+
+    PipelineCacheStatistics result = statistics;
+    result.hits = hits.load(std::memory_order_relaxed);
+    result.misses = misses.load(std::memory_order_relaxed);
+
+    return result;
+  }
+}
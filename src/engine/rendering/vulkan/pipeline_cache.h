@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+namespace Vulkan
+{
+  struct PipelineCacheStatistics
+  {
+    //pipeline was already in the storage
+    uint32_t hits = 0;
+    //pipeline had to be created by the driver
+    uint32_t misses = 0;
+    double creationMilliseconds = 0.0;
+    double maxCreationMilliseconds = 0.0;
+
+    //disk data was accepted for this device and driver
+    bool isLoadedFromDisk = false;
+    size_t loadedBytes = 0;
+    size_t savedBytes = 0;
+  };
+
+  //vk::PipelineCache persisted between runs, data of another device or driver is dropped
+  class PipelineCache
+  {
+  public:
+    PipelineCache(vk::PhysicalDevice physicalDevice, vk::Device device, const std::string& path);
+
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    inline vk::PipelineCache Get() const
+    {
+      return cache.get();
+    }
+
+    void Save();
+
+    //saves only when pipelines were created after the last save, errors are ignored
+    void SaveIfChanged();
+
+    void OnPipelineHit();
+
+    void OnPipelineCreated(double milliseconds);
+
+    PipelineCacheStatistics GetStatistics() const;
+
+  private:
+    std::vector<char> LoadData() const;
+
+  private:
+    vk::Device device;
+    std::string path;
+
+    uint32_t vendorId;
+    uint32_t deviceId;
+    uint32_t driverVersion;
+    std::array<uint8_t, VK_UUID_SIZE> deviceUUID;
+    std::array<uint8_t, VK_UUID_SIZE> pipelineCacheUUID;
+
+    vk::UniquePipelineCache cache;
+
+    //hits are counted by every pipeline lookup, they don't take the lock
+    std::atomic<uint32_t> hits;
+    std::atomic<uint32_t> misses;
+
+    mutable std::mutex statisticsMutex;
+    PipelineCacheStatistics statistics;
+    bool isChanged;
+  };
+}
@@ -2,85 +2,297 @@
 #include "core.h"
 #include "framecontext.h"
 
-namespace vk
+#include <engine/profiling/cpu_profiler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
 {
-  bool operator<(const vk::Extent2D& l, const vk::Extent2D& r)
+  inline uint64_t HashCombine(uint64_t hash, uint64_t value)
+  {
+    return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+  }
+
+  //spreads the bits of a combined hash, the table takes its lowest bits
+  inline uint64_t HashFinalize(uint64_t hash)
+  {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+    return hash;
+  }
+
+  uint64_t GetBlendStatesHash(const std::vector<vk::PipelineColorBlendAttachmentState>& states)
   {
-    return std::tie(l.height, l.width) < std::tie(r.height, r.width);
+    uint64_t hash = states.size();
+    for (const vk::PipelineColorBlendAttachmentState& s : states)
+    {
+      hash = HashCombine(hash, s.blendEnable);
+      hash = HashCombine(hash, static_cast<uint64_t>(s.srcColorBlendFactor));
+      hash = HashCombine(hash, static_cast<uint64_t>(s.dstColorBlendFactor));
+      hash = HashCombine(hash, static_cast<uint64_t>(s.colorBlendOp));
+      hash = HashCombine(hash, static_cast<uint64_t>(s.srcAlphaBlendFactor));
+      hash = HashCombine(hash, static_cast<uint64_t>(s.dstAlphaBlendFactor));
+      hash = HashCombine(hash, static_cast<uint64_t>(s.alphaBlendOp));
+      hash = HashCombine(hash, static_cast<VkColorComponentFlags>(s.colorWriteMask));
+    }
+
+    return hash;
   }
 
-  bool operator<(const vk::PipelineColorBlendAttachmentState& l, const vk::PipelineColorBlendAttachmentState& r)
+  enum PipelineKeyFlags : uint32_t
   {
-    return std::tie(l.alphaBlendOp, l.blendEnable, l.colorBlendOp, l.colorWriteMask, l.dstAlphaBlendFactor, l.dstColorBlendFactor, l.srcAlphaBlendFactor, l.srcColorBlendFactor) <
-           std::tie(r.alphaBlendOp, r.blendEnable, r.colorBlendOp, r.colorWriteMask, r.dstAlphaBlendFactor, r.dstColorBlendFactor, r.srcAlphaBlendFactor, r.srcColorBlendFactor);
+    DepthTest = 1 << 0,
+    DepthWrite = 1 << 1,
+    DepthClamp = 1 << 2,
+    RasterizerDiscard = 1 << 3,
+    DepthBias = 1 << 4,
+  };
+
+  uint32_t GetPipelineKeyFlags(const Vulkan::DepthStencilSettings& depthStencilSettings, const Vulkan::RasterizationMode& rasterMode)
+  {
+    uint32_t flags = 0;
+    flags |= depthStencilSettings.depthTestEnabled ? DepthTest : 0;
+    flags |= depthStencilSettings.depthWriteEnabled ? DepthWrite : 0;
+    flags |= rasterMode.depthClampEnable ? DepthClamp : 0;
+    flags |= rasterMode.rasterizerDiscardEnable ? RasterizerDiscard : 0;
+    flags |= rasterMode.depthBiasEnable ? DepthBias : 0;
+
+    return flags;
   }
 }
 
 namespace Vulkan
 {
-  PipelineKey& PipelineKey::SetShaderProgramId(const std::string& id)
+  void PipelineKey::ComputeHash()
   {
-    shaderProgramId = id;
-    return *this;
-  }
+    uint64_t h = renderPass;
+    h = HashCombine(h, (static_cast<uint64_t>(programHandle) << 32) | vertexInputDeclarationId);
+    h = HashCombine(h, (static_cast<uint64_t>(blendStatesId) << 32) | subpass);
+    h = HashCombine(h, variantIndex);
 
-  PipelineKey& PipelineKey::SetVertexInputDeclaration(const VertexInputDeclaration& d)
-  {
-    vertexInputDeclaration = d;
-    return *this;
+    uint32_t lineWidthBits;
+    std::memcpy(&lineWidthBits, &lineWidth, sizeof(lineWidthBits));
+
+    const uint32_t modes = (topology << 24) | (polygonMode << 16) | (cullMode << 8) | frontFace;
+    h = HashCombine(h, (static_cast<uint64_t>(lineWidthBits) << 32) | modes);
+    h = HashCombine(h, flags);
+
+    hash = HashFinalize(h);
   }
 
-  PipelineKey& PipelineKey::SetTopology(const vk::PrimitiveTopology t)
+  bool PipelineKey::operator==(const PipelineKey& r) const
   {
-    topology = t;
-    return *this;
+    return hash == r.hash &&
+           std::tie(renderPass, programHandle, vertexInputDeclarationId, blendStatesId, variantIndex, subpass, lineWidth, topology, polygonMode, cullMode, frontFace, flags) ==
+           std::tie(r.renderPass, r.programHandle, r.vertexInputDeclarationId, r.blendStatesId, r.variantIndex, r.subpass, r.lineWidth, r.topology, r.polygonMode, r.cullMode, r.frontFace, r.flags);
   }
 
-  PipelineKey& PipelineKey::SetDepthStencilSettings(const DepthStencilSettings& s)
+  PipelineEntry* PipelineTable::Find(const PipelineKey& key) const
   {
-    depthStencilSettings = s;
-    return *this;
+    if (slots.empty())
+      return nullptr;
+
+    const size_t mask = slots.size() - 1;
+    for (size_t i = key.hash & mask; ; i = (i + 1) & mask)
+    {
+      const Slot& slot = slots[i];
+      if (slot.entry == nullptr)
+        return nullptr;
+
+      if (slot.key == key)
+        return slot.entry;
+    }
   }
 
-  PipelineKey& PipelineKey::SetRasterMode(const RasterizationMode& rm)
+  void PipelineTable::Insert(const PipelineKey& key, PipelineEntry* entry)
   {
-    rasterMode = rm;
-    return *this;
+    //at most half full, probe sequences stay short
+    if ((size + 1) * 2 > slots.size())
+      Grow();
+
+    const size_t mask = slots.size() - 1;
+    size_t i = key.hash & mask;
+    while (slots[i].entry != nullptr)
+      i = (i + 1) & mask;
+
+    slots[i].key = key;
+    slots[i].entry = entry;
+    ++size;
   }
 
-  PipelineKey& PipelineKey::SetViewportExtent(const vk::Extent2D e)
+  void PipelineTable::Grow()
   {
-    viewportExtent = e;
-    return *this;
+    std::vector<Slot> oldSlots = std::move(slots);
+
+    slots.clear();
+    slots.resize(oldSlots.empty() ? 64 : oldSlots.size() * 2);
+    size = 0;
+
+    for (const Slot& slot : oldSlots)
+      if (slot.entry != nullptr)
+        Insert(slot.key, slot.entry);
   }
 
-  PipelineKey& PipelineKey::SetRenderPass(const vk::RenderPass r)
+  PipelineStorage::PipelineStorage(Core& core)
+    : core(core)
   {
-    renderpass = r;
-    return *this;
+    const uint32_t workersCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    compilationPool = std::make_unique<WorkerPool>("compile", workersCount);
   }
 
-  PipelineKey& PipelineKey::SetSubpassNumber(const uint32_t n)
+  Pipeline* PipelineStorage::AccessPipeline(AccessMode mode,
+                                            const ShaderProgram& program,
+                                            const VertexInputDeclaration& vertexInputDeclaration,
+                                            vk::PrimitiveTopology topology,
+                                            const DepthStencilSettings& depthStencilSettings,
+                                            const RasterizationMode& rasterMode,
+                                            vk::RenderPass renderPass,
+                                            uint32_t subpassNumber,
+                                            const std::vector<vk::PipelineColorBlendAttachmentState>& outputAttachmentBlendStates,
+                                            uint32_t blendStatesId)
   {
-    subpass = n;
-    return *this;
+    //declaration and blend states are interned beforehand, the key is built from ids only
+    PipelineKey key;
+    key.renderPass = reinterpret_cast<uint64_t>(static_cast<VkRenderPass>(renderPass));
+    key.programHandle = program.GetHandle();
+    key.vertexInputDeclarationId = vertexInputDeclaration.GetId();
+    key.blendStatesId = blendStatesId;
+    key.variantIndex = program.GetVariantIndex();
+    key.subpass = subpassNumber;
+    key.lineWidth = rasterMode.lineWidth;
+    key.topology = static_cast<uint8_t>(topology);
+    key.polygonMode = static_cast<uint8_t>(rasterMode.polygonMode);
+    key.cullMode = static_cast<uint8_t>(rasterMode.cullMode);
+    key.frontFace = static_cast<uint8_t>(rasterMode.frontFace);
+    key.flags = GetPipelineKeyFlags(depthStencilSettings, rasterMode);
+    key.ComputeHash();
+
+    PipelineEntry* entry = nullptr;
+    {
+      std::shared_lock<std::shared_mutex> lock(tableMutex);
+      entry = table.Find(key);
+    }
+
+    bool isNew = false;
+    if (entry == nullptr)
+    {
+      std::lock_guard<std::shared_mutex> lock(tableMutex);
+
+      //another thread may have added the key after the shared lookup
+      entry = table.Find(key);
+      if (entry == nullptr)
+      {
+        entries.push_back(std::make_unique<PipelineEntry>());
+        entry = entries.back().get();
+        table.Insert(key, entry);
+        isNew = true;
+      }
+    }
+
+    if (!isNew)
+    {
+      if (Pipeline* pipeline = entry->pipeline.load(std::memory_order_acquire))
+      {
+        core.GetPipelineCache().OnPipelineHit();
+        return pipeline;
+      }
+
+      if (mode == AccessMode::NonBlocking)
+        return GetReadyPipeline(*entry);
+
+      //pipeline is compiled by another thread right now
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        pipelineCreated.wait(lock, [entry]() { return entry->pipeline.load(std::memory_order_acquire) != nullptr || entry->failure; });
+      }
+
+      return GetReadyPipeline(*entry);
+    }
+
+    const auto description = PipelineDescription()
+      .SetProgram(program)
+      .SetVertexInputDeclaration(vertexInputDeclaration)
+      .SetTopology(topology)
+      .SetDepthStencilSettings(depthStencilSettings)
+      .SetRasterMode(rasterMode)
+      .SetRenderPass(renderPass)
+      .SetSubpassNumber(subpassNumber)
+      .SetColorAttachmentBlendStates(outputAttachmentBlendStates);
+
+    if (mode == AccessMode::NonBlocking)
+    {
+      compilationPool->Submit([this, entry, description](uint32_t)
+      {
+        CreatePipeline(*entry, description);
+      });
+
+      return nullptr;
+    }
+
+    CreatePipeline(*entry, description);
+
+    return GetReadyPipeline(*entry);
   }
 
-  PipelineKey& PipelineKey::SetColorAttachmentBlendStates(const std::vector<vk::PipelineColorBlendAttachmentState>& bs)
+  void PipelineStorage::CreatePipeline(PipelineEntry& entry, const PipelineDescription& description)
   {
-    colorAttachmentBlendStates = bs;
-    return *this;
+    PROFILE_ZONE("PipelineStorage::CreatePipeline");
+
+    PipelineCache& pipelineCache = core.GetPipelineCache();
+    const ShaderProgram& program = *description.program;
+
+    try
+    {
+      const auto creationStart = std::chrono::steady_clock::now();
+
+      std::unique_ptr<Pipeline> pp = std::make_unique<Pipeline>(core.GetLogicalDevice(),
+                                                                pipelineCache.Get(),
+                                                                program,
+                                                                description.vertexInputDeclaration,
+                                                                program.GetLayouts(),
+                                                                description.topology,
+                                                                description.depthStencilSettings,
+                                                                description.rasterMode,
+                                                                description.renderPass,
+                                                                description.subpassNumber,
+                                                                description.outputAttachmentBlendStates);
+
+      pipelineCache.OnPipelineCreated(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - creationStart).count());
+
+      std::lock_guard<std::mutex> lock(mutex);
+      entry.owner = std::move(pp);
+      entry.pipeline.store(entry.owner.get(), std::memory_order_release);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      entry.failure = std::current_exception();
+    }
+
+    pipelineCreated.notify_all();
   }
 
-  bool PipelineKey::operator<(const PipelineKey& r) const
+  Pipeline* PipelineStorage::GetReadyPipeline(PipelineEntry& entry)
   {
-    return std::tie(shaderProgramId, vertexInputDeclaration, topology, depthStencilSettings, rasterMode, viewportExtent, renderpass, subpass, colorAttachmentBlendStates) <
-      std::tie(r.shaderProgramId, r.vertexInputDeclaration, r.topology, r.depthStencilSettings, r.rasterMode, r.viewportExtent, r.renderpass, r.subpass, r.colorAttachmentBlendStates);
+    Pipeline* pipeline = entry.pipeline.load(std::memory_order_acquire);
+    if (pipeline != nullptr)
+      return pipeline;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entry.failure)
+      std::rethrow_exception(entry.failure);
+
+    return nullptr;
   }
 
-  PipelineStorage::PipelineStorage(Core& core)
-    : core(core)
+  Pipeline* PipelineStorage::GetPipeline(const PipelineDescription& d)
   {
+    return AccessPipeline(AccessMode::Blocking, *d.program, d.vertexInputDeclaration, d.topology, d.depthStencilSettings, d.rasterMode, d.renderPass, d.subpassNumber, d.outputAttachmentBlendStates, InternBlendStates(d.outputAttachmentBlendStates));
   }
 
   Pipeline* PipelineStorage::GetPipeline(const ShaderProgram& program,
@@ -88,32 +300,11 @@ namespace Vulkan
     vk::PrimitiveTopology topology,
     const DepthStencilSettings& depthStencilSettings,
     const RasterizationMode& rasterMode,
-    const vk::Extent2D& viewportExtent,
     vk::RenderPass renderPass,
     uint32_t subpassNumber,
     const std::vector<vk::PipelineColorBlendAttachmentState>& outputAttachmentBlendStates)
   {
-    const auto key = PipelineKey()
-      .SetShaderProgramId(program.GetID())
-      .SetVertexInputDeclaration(vertexInputDeclaration)
-      .SetTopology(topology)
-      .SetDepthStencilSettings(depthStencilSettings)
-      .SetRasterMode(rasterMode)
-      .SetViewportExtent(viewportExtent)
-      .SetRenderPass(renderPass)
-      .SetSubpassNumber(subpassNumber)
-      .SetColorAttachmentBlendStates(outputAttachmentBlendStates);
-
-    if (storage.find(key) != storage.end())
-      return storage[key].get();
-
-    const std::vector<vk::DescriptorSetLayout>& layouts = program.GetLayouts();
-
-    std::unique_ptr<Pipeline> pp = std::make_unique<Pipeline>(core.GetLogicalDevice(), program, vertexInputDeclaration, layouts, topology, depthStencilSettings, rasterMode, viewportExtent, renderPass, subpassNumber, outputAttachmentBlendStates);
-    Pipeline* pipeline = pp.get();
-    storage[key] = std::move(pp);
-
-    return pipeline;
+    return AccessPipeline(AccessMode::Blocking, program, vertexInputDeclaration, topology, depthStencilSettings, rasterMode, renderPass, subpassNumber, outputAttachmentBlendStates, InternBlendStates(outputAttachmentBlendStates));
   }
 
   Pipeline* PipelineStorage::GetPipeline(const ShaderProgram& program, 
@@ -123,14 +314,87 @@ namespace Vulkan
                                          const RasterizationMode& rasterMode,
                                          const FrameContext& frameContext)
   {
-    return GetPipeline(program,
-                       vertexInputDeclaration,
-                       topology,
-                       depthStencilSettings,
-                       rasterMode,
-                       frameContext.BackbufferSize,
-                       frameContext.renderPass,
-                       frameContext.subpassNumber,
-                       frameContext.outputAttachmentBlendStates);
-  }
-}
\ No newline at end of file
+    return AccessPipeline(AccessMode::Blocking,
+                          program,
+                          vertexInputDeclaration,
+                          topology,
+                          depthStencilSettings,
+                          rasterMode,
+                          frameContext.renderPass,
+                          frameContext.subpassNumber,
+                          frameContext.outputAttachmentBlendStates,
+                          frameContext.outputAttachmentBlendStatesId);
+  }
+
+  Pipeline* PipelineStorage::TryGetPipeline(const PipelineDescription& d)
+  {
+    return AccessPipeline(AccessMode::NonBlocking, *d.program, d.vertexInputDeclaration, d.topology, d.depthStencilSettings, d.rasterMode, d.renderPass, d.subpassNumber, d.outputAttachmentBlendStates, InternBlendStates(d.outputAttachmentBlendStates));
+  }
+
+  Pipeline* PipelineStorage::TryGetPipeline(const ShaderProgram& program,
+                                            const VertexInputDeclaration& vertexInputDeclaration,
+                                            vk::PrimitiveTopology topology,
+                                            const DepthStencilSettings& depthStencilSettings,
+                                            const RasterizationMode& rasterMode,
+                                            const FrameContext& frameContext)
+  {
+    return AccessPipeline(AccessMode::NonBlocking,
+                          program,
+                          vertexInputDeclaration,
+                          topology,
+                          depthStencilSettings,
+                          rasterMode,
+                          frameContext.renderPass,
+                          frameContext.subpassNumber,
+                          frameContext.outputAttachmentBlendStates,
+                          frameContext.outputAttachmentBlendStatesId);
+  }
+
+  void PipelineStorage::WarmUp(const std::vector<PipelineDescription>& descriptions)
+  {
+    for (const PipelineDescription& description : descriptions)
+      TryGetPipeline(description);
+
+    //also waits for pipelines queued by the frames, warm up happens outside of them
+    compilationPool->Wait();
+
+    //rethrows compilation failures
+    for (const PipelineDescription& description : descriptions)
+      GetPipeline(description);
+  }
+
+  uint32_t PipelineStorage::InternBlendStates(const std::vector<vk::PipelineColorBlendAttachmentState>& states)
+  {
+    const uint64_t hash = GetBlendStatesHash(states);
+
+    std::lock_guard<std::mutex> lock(blendStatesMutex);
+    return blendStates.Intern(states, hash);
+  }
+
+  ComputePipeline* PipelineStorage::GetComputePipeline(const ComputeProgram& program)
+  {
+    const uint32_t handle = program.GetHandle();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PipelineCache& pipelineCache = core.GetPipelineCache();
+
+    const auto it = computeStorage.find(handle);
+    if (it != computeStorage.end())
+    {
+      pipelineCache.OnPipelineHit();
+      return it->second.get();
+    }
+
+    PROFILE_ZONE("PipelineStorage::CreateComputePipeline");
+    const auto creationStart = std::chrono::steady_clock::now();
+
+    std::unique_ptr<ComputePipeline> pp = std::make_unique<ComputePipeline>(core.GetLogicalDevice(), pipelineCache.Get(), program, program.GetLayouts());
+    ComputePipeline* pipeline = pp.get();
+    computeStorage[handle] = std::move(pp);
+
+    pipelineCache.OnPipelineCreated(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - creationStart).count());
+
+    return pipeline;
+  }
+}
@@ -3,65 +3,185 @@
 #include "Shader.h"
 #include "pipeline.h"
 #include "vertex_input_declaration.h"
+#include "worker_pool.h"
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.h>
 
 #include <tuple>
-#include <map>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
 
 namespace Vulkan
 {
   class Core;
   struct FrameContext;
 
-  class PipelineKey
+  //fixed size key of a graphics pipeline, program, vertex input declaration, blend states and variant are ids known before the lookup
+  struct PipelineKey
   {
-    friend class PipelineStorage;
-  public:
-    PipelineKey& SetShaderProgramId(const std::string& id);
+    uint64_t renderPass = 0;
+    uint32_t programHandle = 0;
+    uint32_t vertexInputDeclarationId = 0;
+    uint32_t blendStatesId = 0;
+    //variants of a program share its handle
+    uint32_t variantIndex = 0;
+    uint32_t subpass = 0;
+    float lineWidth = 0.0f;
+    uint8_t topology = 0;
+    uint8_t polygonMode = 0;
+    uint8_t cullMode = 0;
+    uint8_t frontFace = 0;
+    //depth test, depth write, depth clamp, rasterizer discard, depth bias
+    uint32_t flags = 0;
 
-    PipelineKey& SetVertexInputDeclaration(const VertexInputDeclaration& d);
+    //computed once the fields are set
+    uint64_t hash = 0;
 
-    PipelineKey& SetTopology(const vk::PrimitiveTopology t);
+    void ComputeHash();
 
-    PipelineKey& SetDepthStencilSettings(const DepthStencilSettings& s);
+    bool operator==(const PipelineKey& r) const;
+  };
 
-    PipelineKey& SetRasterMode(const RasterizationMode& rasterMode);
+  struct PipelineEntry
+  {
+    //published by the compiling thread once the pipeline is ready
+    std::atomic<Pipeline*> pipeline{ nullptr };
+    std::unique_ptr<Pipeline> owner;
+    std::exception_ptr failure;
+  };
 
-    PipelineKey& SetViewportExtent(const vk::Extent2D e);
+  //open addressing with linear probing, keys are never removed
+  class PipelineTable
+  {
+  public:
+    //nullptr when there is no such key
+    PipelineEntry* Find(const PipelineKey& key) const;
 
-    PipelineKey& SetRenderPass(const vk::RenderPass r);
+    void Insert(const PipelineKey& key, PipelineEntry* entry);
 
-    PipelineKey& SetSubpassNumber(const uint32_t n);
+  private:
+    void Grow();
 
-    PipelineKey& SetColorAttachmentBlendStates(const std::vector<vk::PipelineColorBlendAttachmentState>& bs);
+  private:
+    struct Slot
+    {
+      PipelineKey key;
+      PipelineEntry* entry = nullptr;
+    };
+
+    std::vector<Slot> slots;
+    size_t size = 0;
+  };
 
-    bool operator<(const PipelineKey& r) const;
+  //equal values get the same small id
+  template<class T>
+  class Interner
+  {
+  public:
+    //zero is never assigned
+    uint32_t Intern(const T& value, uint64_t hash)
+    {
+      const auto [begin, end] = ids.equal_range(hash);
+      for (auto it = begin; it != end; ++it)
+        if (values[it->second - 1] == value)
+          return it->second;
+
+      values.push_back(value);
+      const uint32_t id = static_cast<uint32_t>(values.size());
+      ids.emplace(hash, id);
+
+      return id;
+    }
 
   private:
-    std::string shaderProgramId;
+    std::vector<T> values;
+    std::unordered_multimap<uint64_t, uint32_t> ids;
+  };
+
+  //everything required to create a graphics pipeline, the program has to outlive the compilation
+  struct PipelineDescription
+  {
+    const ShaderProgram* program = nullptr;
     VertexInputDeclaration vertexInputDeclaration;
-    vk::PrimitiveTopology topology;
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
     DepthStencilSettings depthStencilSettings;
     RasterizationMode rasterMode;
-    vk::Extent2D viewportExtent;
-    vk::RenderPass renderpass;
-    uint32_t subpass = 0;
-    std::vector<vk::PipelineColorBlendAttachmentState> colorAttachmentBlendStates;
+    vk::RenderPass renderPass;
+    uint32_t subpassNumber = 0;
+    std::vector<vk::PipelineColorBlendAttachmentState> outputAttachmentBlendStates;
+
+    PipelineDescription& SetProgram(const ShaderProgram& p)
+    {
+      program = &p;
+      return *this;
+    }
+
+    PipelineDescription& SetVertexInputDeclaration(const VertexInputDeclaration& d)
+    {
+      vertexInputDeclaration = d;
+      return *this;
+    }
+
+    PipelineDescription& SetTopology(vk::PrimitiveTopology t)
+    {
+      topology = t;
+      return *this;
+    }
+
+    PipelineDescription& SetDepthStencilSettings(const DepthStencilSettings& s)
+    {
+      depthStencilSettings = s;
+      return *this;
+    }
+
+    PipelineDescription& SetRasterMode(const RasterizationMode& m)
+    {
+      rasterMode = m;
+      return *this;
+    }
+
+    PipelineDescription& SetRenderPass(vk::RenderPass r)
+    {
+      renderPass = r;
+      return *this;
+    }
+
+    PipelineDescription& SetSubpassNumber(uint32_t n)
+    {
+      subpassNumber = n;
+      return *this;
+    }
+
+    PipelineDescription& SetColorAttachmentBlendStates(const std::vector<vk::PipelineColorBlendAttachmentState>& bs)
+    {
+      outputAttachmentBlendStates = bs;
+      return *this;
+    }
   };
 
   class PipelineStorage
   {
+    enum class AccessMode
+    {
+      Blocking,
+      NonBlocking
+    };
+
   public:
     PipelineStorage(Core& core);
 
+    //blocks until the pipeline is created
+    Pipeline* GetPipeline(const PipelineDescription& description);
+
     Pipeline* GetPipeline(const ShaderProgram& program, 
                           const VertexInputDeclaration& vertexInputDeclaration, 
                           vk::PrimitiveTopology topology, 
                           const DepthStencilSettings& depthStencilSettings,
                           const RasterizationMode& rasterMode,
-                          const vk::Extent2D& viewportExtent, 
                           vk::RenderPass renderPass, 
                           uint32_t subpassNumber, 
                           const std::vector<vk::PipelineColorBlendAttachmentState>& outputAttachmentBlendStates);
@@ -73,9 +193,59 @@ namespace Vulkan
                           const RasterizationMode& rasterMode,
                           const FrameContext& frameContext);
 
+    //doesn't block: a missing pipeline is queued for the background compilation and nullptr is returned until it's ready
+    Pipeline* TryGetPipeline(const PipelineDescription& description);
+
+    Pipeline* TryGetPipeline(const ShaderProgram& program,
+                             const VertexInputDeclaration& vertexInputDeclaration,
+                             vk::PrimitiveTopology topology,
+                             const DepthStencilSettings& depthStencilSettings,
+                             const RasterizationMode& rasterMode,
+                             const FrameContext& frameContext);
+
+    //compiles pipelines in parallel and blocks until all of them are ready, meant for the loading
+    void WarmUp(const std::vector<PipelineDescription>& descriptions);
+
+    ComputePipeline* GetComputePipeline(const ComputeProgram& program);
+
+    //interned once per subpass, lookups from the frame context only copy the id
+    uint32_t InternBlendStates(const std::vector<vk::PipelineColorBlendAttachmentState>& blendStates);
+
+  private:
+    //key and description are built from the same arguments, the description is copied only on a miss
+    Pipeline* AccessPipeline(AccessMode mode,
+                             const ShaderProgram& program,
+                             const VertexInputDeclaration& vertexInputDeclaration,
+                             vk::PrimitiveTopology topology,
+                             const DepthStencilSettings& depthStencilSettings,
+                             const RasterizationMode& rasterMode,
+                             vk::RenderPass renderPass,
+                             uint32_t subpassNumber,
+                             const std::vector<vk::PipelineColorBlendAttachmentState>& outputAttachmentBlendStates,
+                             uint32_t blendStatesId);
+
+    void CreatePipeline(PipelineEntry& entry, const PipelineDescription& description);
+
+    Pipeline* GetReadyPipeline(PipelineEntry& entry);
+
   private:
     Core& core;
 
-    std::map<PipelineKey, std::unique_ptr<Pipeline>> storage;
+    //pipelines are requested from the recording workers, hits only share the table's lock
+    std::shared_mutex tableMutex;
+    PipelineTable table;
+    std::vector<std::unique_ptr<PipelineEntry>> entries;
+
+    std::mutex blendStatesMutex;
+    Interner<std::vector<vk::PipelineColorBlendAttachmentState>> blendStates;
+
+    //guards the compilation results and the compute pipelines
+    std::mutex mutex;
+    std::condition_variable pipelineCreated;
+    //compute pipelines depend on the program only
+    std::unordered_map<uint32_t, std::unique_ptr<ComputePipeline>> computeStorage;
+
+    //destroyed first, queued compilations finish while the entries are alive
+    std::unique_ptr<WorkerPool> compilationPool;
   };
 }
\ No newline at end of file
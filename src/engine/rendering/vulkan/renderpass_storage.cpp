@@ -70,6 +70,7 @@ namespace Vulkan
     for (const ImageAttachment& attachment : key.imageAttachments)
     {
       const auto desc = vk::AttachmentDescription()
+        .setFlags(attachment.mayAlias ? vk::AttachmentDescriptionFlagBits::eMayAlias : vk::AttachmentDescriptionFlags{})
         .setFormat(attachment.format)
         .setSamples(vk::SampleCountFlagBits::e1)
         .setLoadOp(attachment.loadOp)
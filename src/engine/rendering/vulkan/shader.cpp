@@ -4,29 +4,60 @@
 #include <engine/utils/utils.h>
 
 #include <iostream>
+#include <atomic>
 
 namespace
 {
-  vk::DescriptorType GetDescriptorType(Vulkan::UniformType type)
+  std::vector<vk::DescriptorSetLayout> CreateLayouts(vk::Device logicalDevice, const Vulkan::PipelineUniforms& uniforms)
   {
-    switch (type)
+    std::vector<vk::DescriptorSetLayout> layouts;
+
+    layouts.reserve(uniforms.sets.size());
+
+    for (int i = 0; i < uniforms.sets.size(); ++i)
     {
-    case Vulkan::UniformType::UniformBuffer:
-      return vk::DescriptorType::eUniformBuffer;
+      const Vulkan::UniformSetDescription& set = uniforms.sets[i];
 
-    case Vulkan::UniformType::SamplerCube:
-    case Vulkan::UniformType::Sampler2D:
-      return vk::DescriptorType::eCombinedImageSampler;
+      std::vector<vk::DescriptorSetLayoutBinding> bindings;
+      for (int j = 0; j < set.bindings.size(); ++j)
+      {
+        const Vulkan::UniformBindingDescription& binding = set.bindings[j];
 
-    case Vulkan::UniformType::SubpassInput:
-      return vk::DescriptorType::eInputAttachment;
+        if (binding.type == Vulkan::UniformType::None)
+          continue;
 
-    default:
-      throw std::runtime_error("unknown uniform type.");
+        const auto bindingDescription = vk::DescriptorSetLayoutBinding()
+          .setBinding(j)
+          .setDescriptorCount(1)
+          .setDescriptorType(Vulkan::GetDescriptorType(binding.type))
+          .setStageFlags(Vulkan::GetShaderStageFlags(binding.stages));
+
+        bindings.push_back(bindingDescription);
+      }
+
+      const auto layoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
+        .setBindingCount(bindings.size())
+        .setPBindings(bindings.data());
+      //.setFlags()
+
+      vk::DescriptorSetLayout layout = logicalDevice.createDescriptorSetLayout(layoutCreateInfo);
+      layouts.push_back(layout);
     }
+
+    return layouts;
   }
 
-  vk::ShaderStageFlags GetShaderStageFlag(Vulkan::ShaderStages stages)
+  //handles are never reused, pipelines of a destroyed program can't be taken by a new one
+  uint32_t AcquireProgramHandle()
+  {
+    static std::atomic<uint32_t> nextHandle{ 0 };
+    return nextHandle++;
+  }
+}
+
+namespace Vulkan
+{
+  vk::ShaderStageFlags GetShaderStageFlags(ShaderStages stages)
   {
     vk::ShaderStageFlags bits;
 
@@ -36,12 +67,37 @@ namespace
     if (HAS_STAGE(stages, SHADER_FRAGMENT_STAGE))
       bits |= vk::ShaderStageFlagBits::eFragment;
 
+    if (HAS_STAGE(stages, SHADER_COMPUTE_STAGE))
+      bits |= vk::ShaderStageFlagBits::eCompute;
+
     return bits;
   }
-}
 
-namespace Vulkan
-{
+  vk::DescriptorType GetDescriptorType(UniformType type)
+  {
+    switch (type)
+    {
+    case UniformType::UniformBuffer:
+      return vk::DescriptorType::eUniformBufferDynamic;
+
+    case UniformType::SamplerCube:
+    case UniformType::Sampler2D:
+      return vk::DescriptorType::eCombinedImageSampler;
+
+    case UniformType::SubpassInput:
+      return vk::DescriptorType::eInputAttachment;
+
+    case UniformType::StorageImage:
+      return vk::DescriptorType::eStorageImage;
+
+    case UniformType::StorageBuffer:
+      return vk::DescriptorType::eStorageBuffer;
+
+    default:
+      throw std::runtime_error("GetDescriptorType: unknown uniform type.");
+    }
+  }
+
   Shader::Shader(vk::Device logicalDevice, const std::vector<uint32_t>& byteCode)
   {
     uniforms = SpirvParser().ParseShader(byteCode);
@@ -58,60 +114,141 @@ namespace Vulkan
     return shaderModule.get();
   }
 
-  ShaderProgram::ShaderProgram(Core& core, Shader&& v, Shader&& fr)
+  SpecializationConstants::SpecializationConstants(const PipelineUniforms& uniforms, const SpecializationMap& values)
+  {
+    for (const auto& [name, value] : values)
+      if (uniforms.specializationConstants.find(name) == uniforms.specializationConstants.end())
+        throw std::runtime_error("SpecializationConstants: program doesn't have specialization constant " + name);
+
+    //ordered by the names, ids are unique within the program
+    for (const auto& [name, constant] : uniforms.specializationConstants)
+    {
+      const auto it = values.find(name);
+      const uint32_t value = it != values.end() ? it->second : constant.defaultValue;
+
+      entries.push_back(
+        vk::SpecializationMapEntry()
+        .setConstantID(constant.id)
+        .setOffset(static_cast<uint32_t>(data.size() * sizeof(uint32_t)))
+        .setSize(sizeof(uint32_t))
+      );
+      data.push_back(value);
+    }
+  }
+
+  vk::SpecializationInfo SpecializationConstants::GetInfo() const
+  {
+    return vk::SpecializationInfo()
+      .setMapEntryCount(static_cast<uint32_t>(entries.size()))
+      .setPMapEntries(entries.data())
+      .setDataSize(data.size() * sizeof(uint32_t))
+      .setPData(data.data());
+  }
+
+  uint64_t SpecializationConstants::GetHash() const
+  {
+    uint64_t hash = data.size();
+    for (size_t i = 0; i < data.size(); ++i)
+      hash = hash * 0x100000001b3ull ^ ((static_cast<uint64_t>(entries[i].constantID) << 32) | data[i]);
+
+    return hash;
+  }
+
+  bool SpecializationConstants::operator==(const SpecializationConstants& r) const
+  {
+    return entries == r.entries && data == r.data;
+  }
+
+  bool SpecializationConstants::operator<(const SpecializationConstants& r) const
+  {
+    if (data != r.data)
+      return data < r.data;
+
+    if (entries.size() != r.entries.size())
+      return entries.size() < r.entries.size();
+
+    for (size_t i = 0; i < entries.size(); ++i)
+      if (entries[i].constantID != r.entries[i].constantID)
+        return entries[i].constantID < r.entries[i].constantID;
+
+    return false;
+  }
+
+  ShaderProgram::ShaderProgram(Core& core, Shader&& v, Shader&& fr, const SpecializationMap& specializationValues)
     : core(core)
-    , vertex(std::move(v))
-    , fragment(std::move(fr))
+    , vertex(std::make_shared<Shader>(std::move(v)))
+    , fragment(std::make_shared<Shader>(std::move(fr)))
+    , variantIndex(0)
+    , isVariant(false)
   {
     id = Utils::UUID();
-    uniforms = vertex.GetUniformsDescriptions() + fragment.GetUniformsDescriptions();
-    layouts = CreateLayouts(core, uniforms);
+    handle = AcquireProgramHandle();
+    uniforms = vertex->GetUniformsDescriptions() + fragment->GetUniformsDescriptions();
+    layouts = CreateLayouts(core.GetLogicalDevice(), uniforms);
+    specialization = SpecializationConstants(uniforms, specializationValues);
+  }
+
+  ShaderProgram::ShaderProgram(const ShaderProgram& base, const SpecializationConstants& specialization, uint32_t variantIndex)
+    : core(base.core)
+    , vertex(base.vertex)
+    , fragment(base.fragment)
+    , uniforms(base.uniforms)
+    , layouts(base.layouts)
+    , specialization(specialization)
+    , id(Utils::UUID())
+    , handle(base.handle)
+    , variantIndex(variantIndex)
+    , isVariant(true)
+  {
   }
 
   ShaderProgram::~ShaderProgram()
   {
+    //variants are destroyed before the layouts they share
+    variants.clear();
+
+    if (isVariant)
+      return;
+
     for (const vk::DescriptorSetLayout& layout : layouts)
     {
       core.GetLogicalDevice().destroyDescriptorSetLayout(layout);
     }
   }
 
-  std::vector<vk::DescriptorSetLayout> ShaderProgram::CreateLayouts(Core& core, const PipelineUniforms& uniforms) const
+  const ShaderProgram& ShaderProgram::GetVariant(const SpecializationMap& specializationValues)
   {
-    std::vector<vk::DescriptorSetLayout> layouts;
+    if (isVariant)
+      throw std::runtime_error("ShaderProgram::GetVariant: variants are created from the base program.");
 
-    layouts.reserve(uniforms.sets.size());
+    const SpecializationConstants variantSpecialization(uniforms, specializationValues);
+    if (variantSpecialization == specialization)
+      return *this;
 
-    for (int i = 0; i < uniforms.sets.size(); ++i)
-    {
-      const UniformSetDescription& set = uniforms.sets[i];
+    std::lock_guard<std::mutex> lock(variantsMutex);
 
-      std::vector<vk::DescriptorSetLayoutBinding> bindings;
-      for (int j = 0; j < set.bindings.size(); ++j)
-      {
-        const UniformBindingDescription& binding = set.bindings[j];
-
-        if (binding.type == UniformType::None)
-          continue;
-
-        const auto bindingDescription = vk::DescriptorSetLayoutBinding()
-          .setBinding(j)
-          .setDescriptorCount(1)
-          .setDescriptorType(GetDescriptorType(binding.type))
-          .setStageFlags(GetShaderStageFlag(binding.stages));
+    std::unique_ptr<ShaderProgram>& variant = variants[variantSpecialization];
+    if (variant == nullptr)
+      variant.reset(new ShaderProgram(*this, variantSpecialization, static_cast<uint32_t>(variants.size())));
 
-        bindings.push_back(bindingDescription);
-      }
+    return *variant;
+  }
 
-      const auto layoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
-        .setBindingCount(bindings.size())
-        .setPBindings(bindings.data());
-      //.setFlags()
+  ComputeProgram::ComputeProgram(Core& core, Shader&& c)
+    : core(core)
+    , compute(std::move(c))
+  {
+    id = Utils::UUID();
+    handle = AcquireProgramHandle();
+    uniforms = compute.GetUniformsDescriptions();
+    layouts = CreateLayouts(core.GetLogicalDevice(), uniforms);
+  }
 
-      vk::DescriptorSetLayout layout = core.GetLogicalDevice().createDescriptorSetLayout(layoutCreateInfo);
-      layouts.push_back(layout);
+  ComputeProgram::~ComputeProgram()
+  {
+    for (const vk::DescriptorSetLayout& layout : layouts)
+    {
+      core.GetLogicalDevice().destroyDescriptorSetLayout(layout);
     }
-
-    return layouts;
   }
 }
\ No newline at end of file
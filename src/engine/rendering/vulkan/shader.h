@@ -4,12 +4,25 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
 namespace Vulkan
 {
   class Core;
 
+  //descriptor sets are grouped by how often their resources change,
+  //per-frame data is bound once per pass, per-draw data goes to push constants or is only moved by the dynamic offsets
+  constexpr uint32_t PER_FRAME_SET = 0;
+  constexpr uint32_t PER_MATERIAL_SET = 1;
+  constexpr uint32_t PER_DRAW_SET = 2;
+
+  vk::ShaderStageFlags GetShaderStageFlags(ShaderStages stages);
+
+  vk::DescriptorType GetDescriptorType(UniformType type);
+
   class Shader
   {
   public:
@@ -28,20 +41,58 @@ namespace Vulkan
     PipelineUniforms uniforms;
   };
 
+  //constant's name -> value bits, booleans are 0 or 1
+  typedef std::map<std::string, uint32_t> SpecializationMap;
+
+  //values of the program's specialization constants ordered by their ids,
+  //constants missing from the map keep the values the shaders declare
+  class SpecializationConstants
+  {
+  public:
+    SpecializationConstants() = default;
+    SpecializationConstants(const PipelineUniforms& uniforms, const SpecializationMap& values);
+
+    //points into the object, empty info when the program has no constants
+    vk::SpecializationInfo GetInfo() const;
+
+    uint64_t GetHash() const;
+
+    bool operator==(const SpecializationConstants& r) const;
+
+    bool operator<(const SpecializationConstants& r) const;
+
+  private:
+    std::vector<vk::SpecializationMapEntry> entries;
+    std::vector<uint32_t> data;
+  };
+
+  //vertex and fragment shaders with fixed values of their specialization constants,
+  //variants share the base program's modules, layouts and handle
   class ShaderProgram
   {
   public:
-    ShaderProgram(Core& core, Shader&& vertex, Shader&& fragment);
+    ShaderProgram(Core& core, Shader&& vertex, Shader&& fragment, const SpecializationMap& specialization = {});
     ~ShaderProgram();
 
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    //created once per set of values and owned by the base program, safe to call from the recording workers
+    const ShaderProgram& GetVariant(const SpecializationMap& specialization);
+
     inline const Shader& GetVertexShader() const
     {
-      return vertex;
+      return *vertex;
     }
 
     inline const Shader& GetFragmentShader() const
     {
-      return fragment;
+      return *fragment;
+    }
+
+    inline const SpecializationConstants& GetSpecialization() const
+    {
+      return specialization;
     }
 
     inline const PipelineUniforms& GetCombinedUniformsInformation() const
@@ -59,19 +110,83 @@ namespace Vulkan
       return id;
     }
 
+    //small integer standing for the program in the pipeline keys
+    inline uint32_t GetHandle() const
+    {
+      return handle;
+    }
+
+    //tells the variants sharing the handle apart, zero for the base program
+    inline uint32_t GetVariantIndex() const
+    {
+      return variantIndex;
+    }
+
+  private:
+    ShaderProgram(const ShaderProgram& base, const SpecializationConstants& specialization, uint32_t variantIndex);
+
   private:
-    std::vector<vk::DescriptorSetLayout> CreateLayouts(Core& core, const PipelineUniforms& uniforms) const;
+    Core& core;
+
+    std::shared_ptr<const Shader> vertex;
+    std::shared_ptr<const Shader> fragment;
+
+    PipelineUniforms uniforms;
+    std::vector<vk::DescriptorSetLayout> layouts;
+    SpecializationConstants specialization;
+
+    std::string id;
+    uint32_t handle;
+    uint32_t variantIndex;
+    //layouts belong to the base program
+    bool isVariant;
+
+    std::mutex variantsMutex;
+    std::map<SpecializationConstants, std::unique_ptr<ShaderProgram>> variants;
+  };
+
+  class ComputeProgram
+  {
+  public:
+    ComputeProgram(Core& core, Shader&& compute);
+    ~ComputeProgram();
+
+    inline const Shader& GetComputeShader() const
+    {
+      return compute;
+    }
+
+    inline const PipelineUniforms& GetCombinedUniformsInformation() const
+    {
+      return uniforms;
+    }
+
+    inline const std::vector<vk::DescriptorSetLayout> GetLayouts() const
+    {
+      return layouts;
+    }
+
+    inline std::string GetID() const
+    {
+      return id;
+    }
+
+    //small integer standing for the program in the pipeline keys
+    inline uint32_t GetHandle() const
+    {
+      return handle;
+    }
 
   private:
     Core& core;
 
-    Shader vertex;
-    Shader fragment;
+    Shader compute;
 
     PipelineUniforms uniforms;
     std::vector<vk::DescriptorSetLayout> layouts;
 
     std::string id;
+    uint32_t handle;
   };
 
 }
\ No newline at end of file
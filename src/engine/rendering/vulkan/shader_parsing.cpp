@@ -1,8 +1,9 @@
 #include "shader_parsing.h"
 
+#include <algorithm>
 #include <iostream>
 
-#include <spirv_cross/spirv_glsl.hpp>
+#include <spirv_cross/spirv_cross.hpp>
 
 namespace
 {
@@ -16,6 +17,9 @@ namespace
     case spv::ExecutionModel::ExecutionModelFragment:
       return SHADER_FRAGMENT_STAGE;
 
+    case spv::ExecutionModel::ExecutionModelGLCompute:
+      return SHADER_COMPUTE_STAGE;
+
     default:
       const std::string err = std::string("GetShaderStage: unknown shader stage: ") + std::to_string(ep.execution_model);
       throw std::runtime_error(err.c_str());
@@ -156,6 +160,45 @@ namespace Vulkan
       }
     }
 
+    //stages may see different parts of the block, the pipeline exposes their union to all of them
+    PushConstantDescription& basePush = base.pushConstants;
+    const PushConstantDescription& mergePush = r.pushConstants;
+
+    if (basePush.size == 0)
+    {
+      basePush = mergePush;
+    }
+    else if (mergePush.size != 0)
+    {
+      const uint32_t begin = std::min(basePush.offset, mergePush.offset);
+      const uint32_t end = std::max(basePush.offset + basePush.size, mergePush.offset + mergePush.size);
+
+      basePush.offset = begin;
+      basePush.size = end - begin;
+      basePush.stages |= mergePush.stages;
+    }
+
+    std::map<std::string, SpecializationConstantDescription>& baseConstants = base.specializationConstants;
+
+    for (const auto& [name, constant] : r.specializationConstants)
+    {
+      const auto it = baseConstants.find(name);
+      if (it == baseConstants.end())
+      {
+        for (const auto& [baseName, baseConstant] : baseConstants)
+          if (baseConstant.id == constant.id)
+            throw std::runtime_error("PipelineUniforms::operator+: different specialization constants with the same id.");
+
+        baseConstants[name] = constant;
+        continue;
+      }
+
+      if (it->second.id != constant.id || it->second.defaultValue != constant.defaultValue)
+        throw std::runtime_error("PipelineUniforms::operator+: specialization constant differs between the stages.");
+
+      it->second.stages |= constant.stages;
+    }
+
     return base;
   }
 
@@ -163,63 +206,127 @@ namespace Vulkan
   {
     PipelineUniforms uniforms;
 
-    spirv_cross::CompilerGLSL glsl{ byteCode };
+    //base compiler only parses the module, no backend is set up for the reflection
+    const spirv_cross::Compiler compiler{ byteCode.data(), byteCode.size() };
+
+    const spirv_cross::ShaderResources resources = compiler.get_shader_resources();
 
-    const spirv_cross::ShaderResources resources = glsl.get_shader_resources();
+    const spirv_cross::SmallVector<spirv_cross::EntryPoint> entryPoints = compiler.get_entry_points_and_stages();
+    if (entryPoints.empty())
+      throw std::runtime_error("SpirvParser::ParseShader: shader doesn't have an entry point.");
 
-    const spirv_cross::SmallVector<spirv_cross::EntryPoint> entryPoints = glsl.get_entry_points_and_stages();
     if (entryPoints.size() != 1)
       std::printf("Warning: Shader::ParseShader: shader has more than one entry point, using the first one.\n");
 
-    const spirv_cross::EntryPoint entry = glsl.get_entry_points_and_stages()[0];
-
-    const ShaderStages stage = GetShaderStage(entry);
+    const ShaderStages stage = GetShaderStage(entryPoints[0]);
 
     for (const auto& ubo : resources.uniform_buffers)
     {
-      spirv_cross::SPIRType type = glsl.get_type(ubo.type_id);
+      const spirv_cross::SPIRType& type = compiler.get_type(ubo.type_id);
 
       UniformBindingDescription description;
-      description.size = glsl.get_declared_struct_size(type);
+      description.size = compiler.get_declared_struct_size(type);
       description.type = UniformType::UniformBuffer;
       description.stages = stage;
 
-      const unsigned int set = glsl.get_decoration(ubo.id, spv::Decoration::DecorationDescriptorSet);
-      const unsigned int binding = glsl.get_decoration(ubo.id, spv::Decoration::DecorationBinding);
+      const unsigned int set = compiler.get_decoration(ubo.id, spv::Decoration::DecorationDescriptorSet);
+      const unsigned int binding = compiler.get_decoration(ubo.id, spv::Decoration::DecorationBinding);
 
       uniforms.AddUniform(set, binding, ubo.name, description);
     }
 
     for (const auto& sampler : resources.sampled_images)
     {
-      spirv_cross::SPIRType type = glsl.get_type(sampler.type_id);
+      const spirv_cross::SPIRType& type = compiler.get_type(sampler.type_id);
 
       UniformBindingDescription description;
       description.size = 0;
       description.stages = stage;
       description.type = GetUniformTypeFromSpirvDim(type.image.dim);
 
-      const unsigned int set = glsl.get_decoration(sampler.id, spv::Decoration::DecorationDescriptorSet);
-      const unsigned int binding = glsl.get_decoration(sampler.id, spv::Decoration::DecorationBinding);
+      const unsigned int set = compiler.get_decoration(sampler.id, spv::Decoration::DecorationDescriptorSet);
+      const unsigned int binding = compiler.get_decoration(sampler.id, spv::Decoration::DecorationBinding);
 
       uniforms.AddUniform(set, binding, sampler.name, description);
     }
 
     for (const auto& subpassInput : resources.subpass_inputs)
     {
-      spirv_cross::SPIRType type = glsl.get_type(subpassInput.type_id);
+      const spirv_cross::SPIRType& type = compiler.get_type(subpassInput.type_id);
 
       UniformBindingDescription description;
       description.size = 0;
       description.stages = stage;
       description.type = UniformType::SubpassInput;
 
-      const unsigned int set = glsl.get_decoration(subpassInput.id, spv::Decoration::DecorationDescriptorSet);
-      const unsigned int binding = glsl.get_decoration(subpassInput.id, spv::Decoration::DecorationBinding);
+      const unsigned int set = compiler.get_decoration(subpassInput.id, spv::Decoration::DecorationDescriptorSet);
+      const unsigned int binding = compiler.get_decoration(subpassInput.id, spv::Decoration::DecorationBinding);
 
       uniforms.AddUniform(set, binding, subpassInput.name, description);
     }
 
+    for (const auto& storageImage : resources.storage_images)
+    {
+      UniformBindingDescription description;
+      description.size = 0;
+      description.stages = stage;
+      description.type = UniformType::StorageImage;
+
+      const unsigned int set = compiler.get_decoration(storageImage.id, spv::Decoration::DecorationDescriptorSet);
+      const unsigned int binding = compiler.get_decoration(storageImage.id, spv::Decoration::DecorationBinding);
+
+      uniforms.AddUniform(set, binding, storageImage.name, description);
+    }
+
+    for (const auto& ssbo : resources.storage_buffers)
+    {
+      const spirv_cross::SPIRType& type = compiler.get_type(ssbo.type_id);
+
+      //size of the fixed part, runtime arrays don't count
+      UniformBindingDescription description;
+      description.size = compiler.get_declared_struct_size(type);
+      description.type = UniformType::StorageBuffer;
+      description.stages = stage;
+
+      const unsigned int set = compiler.get_decoration(ssbo.id, spv::Decoration::DecorationDescriptorSet);
+      const unsigned int binding = compiler.get_decoration(ssbo.id, spv::Decoration::DecorationBinding);
+
+      uniforms.AddUniform(set, binding, ssbo.name, description);
+    }
+
+    if (resources.push_constant_buffers.size() > 1)
+      throw std::runtime_error("SpirvParser::ParseShader: shader has more than one push constant block.");
+
+    for (const auto& pushConstant : resources.push_constant_buffers)
+    {
+      const spirv_cross::SPIRType& type = compiler.get_type(pushConstant.base_type_id);
+
+      //declared size counts from the block's start, members may begin at an offset shared with another stage
+      const uint32_t offset = type.member_types.empty() ? 0 : compiler.type_struct_member_offset(type, 0);
+
+      uniforms.pushConstants.offset = offset;
+      uniforms.pushConstants.size = static_cast<uint32_t>(compiler.get_declared_struct_size(type)) - offset;
+      uniforms.pushConstants.stages = stage;
+    }
+
+    for (const spirv_cross::SpecializationConstant& specConstant : compiler.get_specialization_constants())
+    {
+      const spirv_cross::SPIRConstant& constant = compiler.get_constant(specConstant.id);
+      const spirv_cross::SPIRType& type = compiler.get_type(constant.constant_type);
+
+      const bool isScalar = type.vecsize == 1 && type.columns == 1;
+      const bool is32Bit = type.basetype == spirv_cross::SPIRType::Boolean || type.width == 32;
+      if (!isScalar || !is32Bit)
+        throw std::runtime_error("SpirvParser::ParseShader: only 32-bit scalar specialization constants are supported.");
+
+      SpecializationConstantDescription description;
+      description.id = specConstant.constant_id;
+      description.defaultValue = constant.scalar();
+      description.stages = stage;
+
+      uniforms.specializationConstants[compiler.get_name(specConstant.id)] = description;
+    }
+
     return uniforms;
   }
 }
\ No newline at end of file
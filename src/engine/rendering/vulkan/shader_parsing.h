@@ -14,11 +14,14 @@ namespace Vulkan
     Sampler2D,
     SamplerCube,
     SubpassInput,
+    StorageImage,
+    StorageBuffer,
   };
 
   typedef unsigned int ShaderStages;
   #define SHADER_VERTEX_STAGE (Vulkan::ShaderStages) 0x1
   #define SHADER_FRAGMENT_STAGE (Vulkan::ShaderStages) 0x2
+  #define SHADER_COMPUTE_STAGE (Vulkan::ShaderStages) 0x4
   #define HAS_STAGE(v, s) (v & s)
 
   struct UniformBindingDescription
@@ -49,6 +52,27 @@ namespace Vulkan
     }
   };
 
+  //the only push constant block of a stage, merged stages share one range of the pipeline layout
+  struct PushConstantDescription
+  {
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    ShaderStages stages = 0;
+
+    inline bool operator<(const PushConstantDescription& r) const
+    {
+      return std::tie(offset, size, stages) < std::tie(r.offset, r.size, r.stages);
+    }
+  };
+
+  //32-bit scalar, booleans are passed as VkBool32
+  struct SpecializationConstantDescription
+  {
+    uint32_t id = 0;
+    uint32_t defaultValue = 0;
+    ShaderStages stages = 0;
+  };
+
   typedef std::string UniformName;
 
   struct UniformSetPair
@@ -71,6 +95,8 @@ namespace Vulkan
   {
     std::vector<UniformSetDescription> sets;
     std::map<UniformName, UniformSetPair> uniformsMap;
+    PushConstantDescription pushConstants;
+    std::map<std::string, SpecializationConstantDescription> specializationConstants;
 
     void AddUniform(unsigned int set, unsigned int binding, const std::string& name, const UniformBindingDescription& description);
 
@@ -82,7 +108,7 @@ namespace Vulkan
 
     inline bool operator<(const PipelineUniforms& r) const
     {
-      return sets < r.sets;
+      return std::tie(sets, pushConstants) < std::tie(r.sets, r.pushConstants);
     }
   };
 
@@ -5,9 +5,7 @@
 #include <limits>
 #include <algorithm>
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
-#undef VK_USE_PLATFORM_WIN32_KHR
 
 #undef max
 #undef min
@@ -0,0 +1,188 @@
+#include "transient_attachment_pool.h"
+#include "core.h"
+
+#include <algorithm>
+
+namespace
+{
+  //frames an unused set survives, so a resize or a skipped pass doesn't recreate everything
+  constexpr uint64_t EvictionDelay = 8;
+}
+
+namespace Vulkan
+{
+  bool TransientAttachmentKey::operator<(const TransientAttachmentKey& r) const
+  {
+    return std::tie(format, extent.width, extent.height, usage, aspect) <
+      std::tie(r.format, r.extent.width, r.extent.height, r.usage, r.aspect);
+  }
+
+  TransientAttachmentKey& TransientAttachmentKey::SetFormat(vk::Format format)
+  {
+    this->format = format;
+    return *this;
+  }
+
+  TransientAttachmentKey& TransientAttachmentKey::SetExtent(vk::Extent2D extent)
+  {
+    this->extent = extent;
+    return *this;
+  }
+
+  TransientAttachmentKey& TransientAttachmentKey::SetUsage(vk::ImageUsageFlags usage)
+  {
+    this->usage = usage;
+    return *this;
+  }
+
+  TransientAttachmentKey& TransientAttachmentKey::SetAspect(vk::ImageAspectFlags aspect)
+  {
+    this->aspect = aspect;
+    return *this;
+  }
+
+  bool TransientAttachmentSetKey::operator<(const TransientAttachmentSetKey& r) const
+  {
+    return std::tie(attachments, memoryGroups) < std::tie(r.attachments, r.memoryGroups);
+  }
+
+  TransientAttachmentPool::TransientAttachmentPool(Core& core)
+    : core(core)
+    , frame(0)
+  {
+  }
+
+  const TransientAttachmentSet* TransientAttachmentPool::Acquire(const TransientAttachmentSetKey& key)
+  {
+    std::vector<std::unique_ptr<Entry>>& candidates = entries[key];
+
+    for (std::unique_ptr<Entry>& entry : candidates)
+    {
+      if (entry->inUse == false)
+      {
+        entry->inUse = true;
+        entry->lastUsedFrame = frame;
+        return &entry->set;
+      }
+    }
+
+    std::unique_ptr<Entry> entry = AllocateEntry(key);
+    entry->inUse = true;
+    entry->lastUsedFrame = frame;
+
+    const TransientAttachmentSet* set = &entry->set;
+    entriesBySet[set] = entry.get();
+    candidates.push_back(std::move(entry));
+
+    return set;
+  }
+
+  void TransientAttachmentPool::Release(const TransientAttachmentSet* set)
+  {
+    const auto it = entriesBySet.find(set);
+    if (it == entriesBySet.end())
+      throw std::runtime_error("TransientAttachmentPool::Release: set doesn't belong to the pool.");
+
+    it->second->inUse = false;
+  }
+
+  void TransientAttachmentPool::BeginFrame()
+  {
+    ++frame;
+
+    for (auto keyIt = entries.begin(); keyIt != entries.end();)
+    {
+      std::vector<std::unique_ptr<Entry>>& candidates = keyIt->second;
+
+      for (auto it = candidates.begin(); it != candidates.end();)
+      {
+        Entry& entry = **it;
+
+        if (entry.inUse || (frame - entry.lastUsedFrame) <= EvictionDelay)
+        {
+          ++it;
+          continue;
+        }
+
+        //a recreated view may get the same handle, nothing may still refer to the destroyed one
+        for (const ImageView& view : entry.set.views)
+        {
+          core.GetFramebufferStorage().ReleaseFramebuffers(view.Get());
+          core.ReleaseDescriptorSets(view.Get());
+        }
+
+        entriesBySet.erase(&entry.set);
+        it = candidates.erase(it);
+      }
+
+      if (candidates.empty())
+        keyIt = entries.erase(keyIt);
+      else
+        ++keyIt;
+    }
+  }
+
+  std::unique_ptr<TransientAttachmentPool::Entry> TransientAttachmentPool::AllocateEntry(const TransientAttachmentSetKey& key)
+  {
+    const size_t attachmentsCount = key.attachments.size();
+    const uint32_t groupsCount = attachmentsCount > 0
+      ? *std::max_element(key.memoryGroups.begin(), key.memoryGroups.end()) + 1
+      : 0;
+
+    std::vector<vk::UniqueImage> handles;
+    std::vector<vk::MemoryRequirements> groupRequirements(groupsCount);
+    for (vk::MemoryRequirements& req : groupRequirements)
+      req.setMemoryTypeBits(~0u).setAlignment(1);
+
+    //group can live in lazily allocated memory only if every image in it is transient
+    std::vector<bool> groupIsTransient(groupsCount, true);
+
+    std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+    TransientMemoryStatistics& stats = entry->set.statistics;
+    stats.attachmentsCount = static_cast<uint32_t>(attachmentsCount);
+    stats.memoryGroupsCount = groupsCount;
+
+    for (size_t i = 0; i < attachmentsCount; ++i)
+    {
+      const TransientAttachmentKey& attachment = key.attachments[i];
+
+      vk::UniqueImage img = core.CreateImage(vk::ImageType::e2D, attachment.format, vk::Extent3D{ attachment.extent.width, attachment.extent.height, 1 }, attachment.usage, vk::ImageCreateFlags{}, 1);
+      const vk::MemoryRequirements req = core.GetLogicalDevice().getImageMemoryRequirements(img.get());
+
+      vk::MemoryRequirements& groupReq = groupRequirements[key.memoryGroups[i]];
+      groupReq.size = std::max(groupReq.size, req.size);
+      groupReq.alignment = std::max(groupReq.alignment, req.alignment);
+      groupReq.memoryTypeBits &= req.memoryTypeBits;
+
+      if (!(attachment.usage & vk::ImageUsageFlagBits::eTransientAttachment))
+        groupIsTransient[key.memoryGroups[i]] = false;
+
+      stats.unaliasedBytes += req.size;
+      handles.push_back(std::move(img));
+    }
+
+    for (uint32_t group = 0; group < groupsCount; ++group)
+    {
+      const vk::MemoryRequirements& req = groupRequirements[group];
+
+      if (groupIsTransient[group])
+        entry->memory.push_back(core.AllocateTransientAttachmentMemory(req));
+      else
+        entry->memory.push_back(core.AllocateDeviceLocalMemory(req, ResourceTiling::Optimal));
+
+      stats.aliasedBytes += req.size;
+    }
+
+    for (size_t i = 0; i < attachmentsCount; ++i)
+    {
+      const TransientAttachmentKey& attachment = key.attachments[i];
+
+      entry->images.push_back(
+        core.BindAliasedImage(std::move(handles[i]), entry->memory[key.memoryGroups[i]], attachment.format, attachment.aspect)
+      );
+      entry->set.views.push_back(entry->images.back().GetView());
+    }
+
+    return entry;
+  }
+}
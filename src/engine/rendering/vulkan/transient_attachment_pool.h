@@ -0,0 +1,97 @@
+#pragma once
+
+#include "image.h"
+#include "memory_allocator.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Vulkan
+{
+  class Core;
+
+  struct TransientAttachmentKey
+  {
+    vk::Format format;
+    vk::Extent2D extent;
+    vk::ImageUsageFlags usage;
+    vk::ImageAspectFlags aspect;
+
+    bool operator<(const TransientAttachmentKey& r) const;
+
+    TransientAttachmentKey& SetFormat(vk::Format format);
+
+    TransientAttachmentKey& SetExtent(vk::Extent2D extent);
+
+    TransientAttachmentKey& SetUsage(vk::ImageUsageFlags usage);
+
+    TransientAttachmentKey& SetAspect(vk::ImageAspectFlags aspect);
+  };
+
+  //attachments owned by one render graph, the ones of the same memory group are never alive at once and share memory
+  struct TransientAttachmentSetKey
+  {
+    std::vector<TransientAttachmentKey> attachments;
+    std::vector<uint32_t> memoryGroups;
+
+    bool operator<(const TransientAttachmentSetKey& r) const;
+  };
+
+  struct TransientMemoryStatistics
+  {
+    //peak memory if every attachment had its own allocation
+    vk::DeviceSize unaliasedBytes = 0;
+    //peak memory with aliasing
+    vk::DeviceSize aliasedBytes = 0;
+    uint32_t attachmentsCount = 0;
+    uint32_t memoryGroupsCount = 0;
+  };
+
+  struct TransientAttachmentSet
+  {
+    std::vector<ImageView> views;
+    TransientMemoryStatistics statistics;
+  };
+
+  //render graph attachments recycled across frames, a set stays busy until its frame's graph releases it.
+  //sets not requested for a while are destroyed together with their framebuffers
+  class TransientAttachmentPool
+  {
+    struct Entry
+    {
+      TransientAttachmentSet set;
+      std::vector<MemoryAllocation> memory;
+      std::vector<Image> images;
+      bool inUse = false;
+      uint64_t lastUsedFrame = 0;
+    };
+
+  public:
+    TransientAttachmentPool(Core& core);
+
+    const TransientAttachmentSet* Acquire(const TransientAttachmentSetKey& key);
+
+    void Release(const TransientAttachmentSet* set);
+
+    //has to be called when all released attachments are no longer used by the gpu
+    void BeginFrame();
+
+    inline size_t GetSetsCount() const
+    {
+      return entriesBySet.size();
+    }
+
+  private:
+    std::unique_ptr<Entry> AllocateEntry(const TransientAttachmentSetKey& key);
+
+  private:
+    Core& core;
+    uint64_t frame;
+
+    std::map<TransientAttachmentSetKey, std::vector<std::unique_ptr<Entry>>> entries;
+    std::map<const TransientAttachmentSet*, Entry*> entriesBySet;
+  };
+}
@@ -0,0 +1,52 @@
+#include "uniform_ring.h"
+#include "core.h"
+
+namespace Vulkan
+{
+  UniformRing::UniformRing(Core& core, vk::DeviceSize pageSize, vk::DeviceSize alignment)
+    : core(core)
+    , pageSize(pageSize)
+    , alignment(alignment)
+    , currentPage(0)
+    , head(0)
+  {
+    pages.push_back(core.AllocateHostBuffer(pageSize, vk::BufferUsageFlagBits::eUniformBuffer));
+    pages.back().Map();
+  }
+
+  UniformSlice UniformRing::Allocate(vk::DeviceSize size)
+  {
+    if (size > pageSize)
+      throw std::runtime_error("UniformRing::Allocate: uniform is bigger than the ring's page.");
+
+    vk::DeviceSize offset = (head + alignment - 1) / alignment * alignment;
+
+    if (offset + size > pageSize)
+    {
+      ++currentPage;
+      offset = 0;
+
+      if (currentPage == pages.size())
+      {
+        pages.push_back(core.AllocateHostBuffer(pageSize, vk::BufferUsageFlagBits::eUniformBuffer));
+        pages.back().Map();
+      }
+    }
+
+    head = offset + size;
+
+    HostBuffer& page = pages[currentPage];
+
+    return UniformSlice{
+      page.GetBuffer(),
+      offset,
+      static_cast<char*>(page.GetMappedMemory()) + offset
+    };
+  }
+
+  void UniformRing::Reset()
+  {
+    currentPage = 0;
+    head = 0;
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "buffer.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+namespace Vulkan
+{
+  class Core;
+
+  struct UniformSlice
+  {
+    vk::Buffer buffer;
+    vk::DeviceSize offset = 0;
+    void* mappedMemory = nullptr;
+  };
+
+  //linear allocator of a virtual frame's uniform data, mapped pages are reused after the frame timeline passes their frame
+  class UniformRing
+  {
+  public:
+    UniformRing(Core& core, vk::DeviceSize pageSize, vk::DeviceSize alignment);
+
+    UniformSlice Allocate(vk::DeviceSize size);
+
+    void Reset();
+
+  private:
+    Core& core;
+    vk::DeviceSize pageSize;
+    vk::DeviceSize alignment;
+
+    std::vector<HostBuffer> pages;
+    size_t currentPage;
+    vk::DeviceSize head;
+  };
+}
@@ -1,103 +1,235 @@
 #include "uniforms_accessor.h"
+#include "uniform_ring.h"
 #include "core.h"
 #include "image.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace Vulkan
 {
-  UniformsAccessor::UniformsAccessor(Core& core, vk::DescriptorPool descriptorPool, const std::vector<vk::DescriptorSetLayout>& layouts, const PipelineUniforms& uniforms)
+  UniformsAccessor::UniformsAccessor(Core& core, DescriptorSetCache* descriptorSetCache, UniformRing* uniformRing, const std::vector<vk::DescriptorSetLayout>& layouts, const PipelineUniforms& uniforms)
     : core(core)
-    , descriptorPool(descriptorPool)
+    , descriptorSetCache(descriptorSetCache)
+    , uniformRing(uniformRing)
     , layouts(layouts)
     , uniforms(uniforms)
   {
     currentDescriptorSets.resize(layouts.size());
+    //sets without bindings, like the gaps between the frequencies, still need a set to be bound
+    dirtySets.resize(layouts.size(), true);
+
+    for (unsigned int set = 0; set < uniforms.sets.size(); ++set)
+      for (unsigned int binding = 0; binding < uniforms.sets[set].bindings.size(); ++binding)
+        if (uniforms.sets[set].bindings[binding].type == UniformType::UniformBuffer)
+          dynamicOffsets[UniformSetPair{ set, binding }] = 0;
   }
 
-  std::tuple<UniformSetPair, UniformBindingDescription, vk::DescriptorSet> UniformsAccessor::AccessDescriptorSet(const UniformName& name, UniformType type)
+  const UniformSetPair& UniformsAccessor::AccessBinding(const UniformName& name, UniformType type) const
   {
-    const UniformSetPair setBinding = uniforms.GetSetBindingPair(name);
+    const UniformSetPair& setBinding = uniforms.GetSetBindingPair(name);
     const UniformBindingDescription& bindingDescription = uniforms.GetBindingDescription(setBinding.set, setBinding.binding);
 
     if (bindingDescription.type != type)
-      throw std::runtime_error("UniformsAccessor::AccessDescriptorSet, uniform doesn't have a required type.");
+      throw std::runtime_error("UniformsAccessor::AccessBinding, uniform doesn't have a required type.");
 
-    const bool isBindingAlreadyInUse = writes.find(setBinding) != writes.end();
-    vk::DescriptorSet& dscSet = currentDescriptorSets[setBinding.set];
+    return setBinding;
+  }
 
-    if (dscSet == vk::DescriptorSet{} || isBindingAlreadyInUse)
-    {
-      const auto allocInfo = vk::DescriptorSetAllocateInfo()
-        .setDescriptorPool(descriptorPool)
-        .setDescriptorSetCount(1)
-        .setPSetLayouts(&layouts[setBinding.set]);
+  void UniformsAccessor::SetUniformBuffer(const UniformName& name, const void* data, size_t size)
+  {
+    const UniformSetPair& setBinding = AccessBinding(name, UniformType::UniformBuffer);
+    const UniformBindingDescription& bindingDescription = uniforms.GetBindingDescription(setBinding.set, setBinding.binding);
 
-      ownedDescriptorSets.push_back(
-        std::move(core.GetLogicalDevice().allocateDescriptorSetsUnique(allocInfo)[0])
-      );
+    if (size != bindingDescription.size)
+      throw std::runtime_error("UniformsAccessor::SetUniformBuffer, uniform's size is not equal to the requested mapping structure.");
 
-      dscSet = ownedDescriptorSets.back().get();
+    const UniformSlice slice = uniformRing->Allocate(size);
+    std::memcpy(slice.mappedMemory, data, size);
+    dynamicOffsets[setBinding] = static_cast<uint32_t>(slice.offset);
 
-      for (auto& [_, write] : writes)
-      {
-        write.dstSet = dscSet;
-      }
-    }
+    //descriptor points to the ring's page, only the dynamic offset changes within it
+    const auto bufferInfo = vk::DescriptorBufferInfo()
+      .setBuffer(slice.buffer)
+      .setOffset(0)
+      .setRange(bindingDescription.size);
 
-    return { setBinding, bindingDescription, dscSet };
+    SetBuffer(setBinding, vk::DescriptorType::eUniformBufferDynamic, bufferInfo);
   }
 
-  void UniformsAccessor::SetSampler2D(const UniformName& name, const Image& img)
+  void UniformsAccessor::SetPushConstants(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, const void* data, size_t size)
   {
-    auto [setBinding, _, dscSet] = AccessDescriptorSet(name, UniformType::Sampler2D);
+    const PushConstantDescription& pushConstants = uniforms.pushConstants;
+
+    if (pushConstants.size == 0)
+      throw std::runtime_error("UniformsAccessor::SetPushConstants, program doesn't have push constants.");
+
+    if (size != pushConstants.size)
+      throw std::runtime_error("UniformsAccessor::SetPushConstants, push constants' size is not equal to the requested mapping structure.");
+
+    commandBuffer.pushConstants(layout, GetShaderStageFlags(pushConstants.stages), pushConstants.offset, pushConstants.size, data);
+  }
+
+  void UniformsAccessor::SetBuffer(const UniformSetPair& setBinding, vk::DescriptorType descriptorType, const vk::DescriptorBufferInfo& bufferInfo)
+  {
+    const auto it = bufferInfos.find(setBinding);
+    if (it != bufferInfos.end() && it->second == bufferInfo)
+      return;
+
+    bufferInfos[setBinding] = bufferInfo;
 
     writes[setBinding] = vk::WriteDescriptorSet()
       .setDescriptorCount(1)
-      .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+      .setDescriptorType(descriptorType)
       .setDstArrayElement(0)
       .setDstBinding(setBinding.binding)
-      .setDstSet(dscSet)
-      .setPImageInfo(&img.GetDescriptorImageInfo());
+      .setPBufferInfo(&bufferInfos[setBinding]);
+
+    dirtySets[setBinding.set] = true;
   }
 
-  void UniformsAccessor::SetSamplerCube(const UniformName& name, const ImageView& img)
+  void UniformsAccessor::SetImage(const UniformName& name, UniformType type, vk::DescriptorType descriptorType, const vk::DescriptorImageInfo& imageInfo)
   {
-    auto [setBinding, _, dscSet] = AccessDescriptorSet(name, UniformType::SamplerCube);
+    const UniformSetPair& setBinding = AccessBinding(name, type);
+
+    const auto it = imageInfos.find(setBinding);
+    if (it != imageInfos.end() && it->second == imageInfo)
+      return;
+
+    imageInfos[setBinding] = imageInfo;
 
     writes[setBinding] = vk::WriteDescriptorSet()
       .setDescriptorCount(1)
-      .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+      .setDescriptorType(descriptorType)
       .setDstArrayElement(0)
       .setDstBinding(setBinding.binding)
-      .setDstSet(dscSet)
-      .setPImageInfo(&img.GetDescriptorImageInfo());
+      .setPImageInfo(&imageInfos[setBinding]);
+
+    dirtySets[setBinding.set] = true;
+  }
+
+  void UniformsAccessor::SetSampler2D(const UniformName& name, const Image& img)
+  {
+    SetImage(name, UniformType::Sampler2D, vk::DescriptorType::eCombinedImageSampler, img.GetDescriptorImageInfo());
+  }
+
+  void UniformsAccessor::SetSampler2D(const UniformName& name, const ImageView& img)
+  {
+    SetImage(name, UniformType::Sampler2D, vk::DescriptorType::eCombinedImageSampler, img.GetDescriptorImageInfo());
+  }
+
+  void UniformsAccessor::SetSamplerCube(const UniformName& name, const ImageView& img)
+  {
+    SetImage(name, UniformType::SamplerCube, vk::DescriptorType::eCombinedImageSampler, img.GetDescriptorImageInfo());
   }
 
   void UniformsAccessor::SetSubpassInput(const UniformName& name, const ImageView& view)
   {
-    auto [setBinding, _, dscSet] = AccessDescriptorSet(name, UniformType::SubpassInput);
+    SetImage(name, UniformType::SubpassInput, vk::DescriptorType::eInputAttachment, view.GetDescriptorImageInfo());
+  }
 
-    writes[setBinding] = vk::WriteDescriptorSet()
-      .setDescriptorCount(1)
-      .setDescriptorType(vk::DescriptorType::eInputAttachment)
-      .setDstArrayElement(0)
-      .setDstBinding(setBinding.binding)
-      .setDstSet(dscSet)
-      .setPImageInfo(&view.GetDescriptorImageInfo());
+  void UniformsAccessor::SetStorageImage(const UniformName& name, const ImageView& view)
+  {
+    const auto imageInfo = vk::DescriptorImageInfo()
+      .setImageView(view.Get())
+      .setImageLayout(vk::ImageLayout::eGeneral);
+
+    SetImage(name, UniformType::StorageImage, vk::DescriptorType::eStorageImage, imageInfo);
+  }
+
+  void UniformsAccessor::SetStorageBuffer(const UniformName& name, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range)
+  {
+    const auto bufferInfo = vk::DescriptorBufferInfo()
+      .setBuffer(buffer)
+      .setOffset(offset)
+      .setRange(range);
+
+    SetBuffer(AccessBinding(name, UniformType::StorageBuffer), vk::DescriptorType::eStorageBuffer, bufferInfo);
   }
 
-  std::vector<vk::DescriptorSet> UniformsAccessor::GetUpdatedDescriptorSets()
+  vk::DescriptorSet UniformsAccessor::GetDescriptorSet(unsigned int set)
   {
-    if (writes.size() > 0)
+    const auto begin = writes.lower_bound(UniformSetPair{ set, 0 });
+    const auto end = writes.lower_bound(UniformSetPair{ set + 1, 0 });
+
+    setKey.layout = layouts[set];
+    setKey.bindings.clear();
+
+    for (auto it = begin; it != end; ++it)
     {
-      std::vector<vk::WriteDescriptorSet> writesInfo;
-      writesInfo.reserve(writes.size());
+      const vk::WriteDescriptorSet& write = it->second;
 
-      for (const auto& [_, w] : writes)
-        writesInfo.push_back(w);
+      DescriptorBindingKey binding;
+      binding.binding = write.dstBinding;
+      binding.type = write.descriptorType;
 
-      core.GetLogicalDevice().updateDescriptorSets(writesInfo.size(), writesInfo.data(), 0, nullptr);
+      if (write.pBufferInfo != nullptr)
+      {
+        binding.buffer = write.pBufferInfo->buffer;
+        binding.offset = write.pBufferInfo->offset;
+        binding.range = write.pBufferInfo->range;
+      }
+
+      if (write.pImageInfo != nullptr)
+      {
+        binding.imageView = write.pImageInfo->imageView;
+        binding.sampler = write.pImageInfo->sampler;
+        binding.imageLayout = write.pImageInfo->imageLayout;
+      }
+
+      setKey.bindings.push_back(binding);
     }
 
-    return currentDescriptorSets;
+    setKey.ComputeHash();
+
+    const vk::DescriptorSet cachedSet = descriptorSetCache->Find(setKey);
+    if (cachedSet != vk::DescriptorSet{})
+      return cachedSet;
+
+    setWrites.clear();
+    for (auto it = begin; it != end; ++it)
+      setWrites.push_back(it->second);
+
+    return descriptorSetCache->Insert(setKey, uniforms.sets[set], setWrites);
+  }
+
+  uint32_t UniformsAccessor::GetEndSet(uint32_t firstSet, uint32_t setsCount) const
+  {
+    const uint32_t totalSets = static_cast<uint32_t>(currentDescriptorSets.size());
+
+    if (firstSet > totalSets)
+      throw std::runtime_error("UniformsAccessor::GetEndSet: the program has no such descriptor set.");
+
+    return setsCount == ALL_SETS ? totalSets : std::min(totalSets, firstSet + setsCount);
+  }
+
+  vk::ArrayProxy<const vk::DescriptorSet> UniformsAccessor::GetUpdatedDescriptorSets(uint32_t firstSet, uint32_t setsCount)
+  {
+    const uint32_t endSet = GetEndSet(firstSet, setsCount);
+
+    for (unsigned int set = firstSet; set < endSet; ++set)
+    {
+      if (!dirtySets[set])
+        continue;
+
+      currentDescriptorSets[set] = GetDescriptorSet(set);
+      dirtySets[set] = false;
+    }
+
+    return vk::ArrayProxy<const vk::DescriptorSet>(endSet - firstSet, currentDescriptorSets.data() + firstSet);
+  }
+
+  vk::ArrayProxy<const uint32_t> UniformsAccessor::GetDynamicOffsets(uint32_t firstSet, uint32_t setsCount)
+  {
+    const uint32_t endSet = GetEndSet(firstSet, setsCount);
+
+    dynamicOffsetsList.clear();
+
+    const auto begin = dynamicOffsets.lower_bound(UniformSetPair{ firstSet, 0 });
+    const auto end = dynamicOffsets.lower_bound(UniformSetPair{ endSet, 0 });
+    for (auto it = begin; it != end; ++it)
+      dynamicOffsetsList.push_back(it->second);
+
+    return dynamicOffsetsList;
   }
-}
\ No newline at end of file
+}
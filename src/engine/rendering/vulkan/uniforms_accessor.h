@@ -3,59 +3,89 @@
 #include <vulkan/vulkan.hpp>
 #include "Shader.h"
 #include "buffer.h"
+#include "descriptor_set_cache.h"
 
 namespace Vulkan
 {
   class Core;
   class Image;
   class ImageView;
+  class UniformRing;
 
   class UniformsAccessor
   {
   public:
-    UniformsAccessor(Core& core, vk::DescriptorPool descriptorPool, const std::vector<vk::DescriptorSetLayout>& layouts, const PipelineUniforms& uniforms);
+    UniformsAccessor(Core& core, DescriptorSetCache* descriptorSetCache, UniformRing* uniformRing, const std::vector<vk::DescriptorSetLayout>& layouts, const PipelineUniforms& uniforms);
 
     template<class T>
     void SetUniformBuffer(const UniformName& name, const T* data)
     {
-      auto [setBinding, bindingDescription, dscSet] = AccessDescriptorSet(name, UniformType::UniformBuffer);
-
-      if (sizeof(T) != bindingDescription.size)
-        throw std::runtime_error("UniformsAccessor::GetUniformBuffer, uniform's size is not equal to the requested mapping structure.");
-
-      HostBuffer buf = core.AllocateHostBuffer(bindingDescription.size, vk::BufferUsageFlagBits::eUniformBuffer);
-      buf.UploadMemory(data, sizeof(T), 0);
-      ownedBuffers.push_back(std::move(buf));
-
-      writes[setBinding] = vk::WriteDescriptorSet()
-        .setDescriptorCount(1)
-        .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-        .setDstArrayElement(0)
-        .setDstBinding(setBinding.binding)
-        .setDstSet(dscSet)
-        .setPBufferInfo(&ownedBuffers.back().GetFullBufferUpdateInfo());
+      SetUniformBuffer(name, data, sizeof(T));
     }
 
-    std::tuple<UniformSetPair, UniformBindingDescription, vk::DescriptorSet> AccessDescriptorSet(const UniformName& name, UniformType type);
+    void SetUniformBuffer(const UniformName& name, const void* data, size_t size);
+
+    //recorded right away, the layout must come from a pipeline of the accessor's program
+    template<class T>
+    void SetPushConstants(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, const T* data)
+    {
+      SetPushConstants(commandBuffer, layout, data, sizeof(T));
+    }
+
+    void SetPushConstants(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, const void* data, size_t size);
 
     void SetSampler2D(const UniformName& name, const Image& img);
 
+    void SetSampler2D(const UniformName& name, const ImageView& img);
+
     void SetSamplerCube(const UniformName& name, const ImageView& img);
 
     void SetSubpassInput(const UniformName& name, const ImageView& img);
 
-    std::vector<vk::DescriptorSet> GetUpdatedDescriptorSets();
+    void SetStorageImage(const UniformName& name, const ImageView& img);
+
+    void SetStorageBuffer(const UniformName& name, vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+
+    //sets with changed bindings are taken from the cache or built once, views stay valid until the next change.
+    //a range lets the sets of different frequencies be rebound separately, see PER_FRAME_SET
+    vk::ArrayProxy<const vk::DescriptorSet> GetUpdatedDescriptorSets(uint32_t firstSet = 0, uint32_t setsCount = ALL_SETS);
+
+    //offsets into the uniform ring of the same sets ordered by [set:binding] as bindDescriptorSets expects them
+    vk::ArrayProxy<const uint32_t> GetDynamicOffsets(uint32_t firstSet = 0, uint32_t setsCount = ALL_SETS);
+
+    static constexpr uint32_t ALL_SETS = ~0u;
+
+  private:
+    const UniformSetPair& AccessBinding(const UniformName& name, UniformType type) const;
+
+    void SetImage(const UniformName& name, UniformType type, vk::DescriptorType descriptorType, const vk::DescriptorImageInfo& imageInfo);
+
+    void SetBuffer(const UniformSetPair& setBinding, vk::DescriptorType descriptorType, const vk::DescriptorBufferInfo& bufferInfo);
+
+    vk::DescriptorSet GetDescriptorSet(unsigned int set);
+
+    uint32_t GetEndSet(uint32_t firstSet, uint32_t setsCount) const;
 
   private:
     Core& core;
-    vk::DescriptorPool descriptorPool;
+    DescriptorSetCache* descriptorSetCache;
+    UniformRing* uniformRing;
     std::vector<vk::DescriptorSetLayout> layouts;
     PipelineUniforms uniforms;
 
     std::vector<vk::DescriptorSet> currentDescriptorSets;
-    std::vector<vk::UniqueDescriptorSet> ownedDescriptorSets;
-    std::vector<Buffer> ownedBuffers;
+    //a binding of the set got a different resource
+    std::vector<bool> dirtySets;
+
+    //reused between the lookups, no allocations once they have grown
+    DescriptorSetKey setKey;
+    std::vector<vk::WriteDescriptorSet> setWrites;
 
     std::map<UniformSetPair, vk::WriteDescriptorSet> writes;
+    std::map<UniformSetPair, vk::DescriptorBufferInfo> bufferInfos;
+    std::map<UniformSetPair, vk::DescriptorImageInfo> imageInfos;
+
+    std::map<UniformSetPair, uint32_t> dynamicOffsets;
+    std::vector<uint32_t> dynamicOffsetsList;
   };
 }
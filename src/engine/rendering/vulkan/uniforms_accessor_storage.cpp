@@ -4,24 +4,32 @@
 
 namespace Vulkan
 {
-  UniformsAccessorStorage::UniformsAccessorStorage(Core& core, vk::DescriptorPool descriptorPool)
+  UniformsAccessorStorage::UniformsAccessorStorage(Core& core, DescriptorSetCache* descriptorSetCache, UniformRing* uniformRing)
     : core(core)
-    , descriptorPool(descriptorPool)
+    , descriptorSetCache(descriptorSetCache)
+    , uniformRing(uniformRing)
   {
   }
 
   UniformsAccessor* UniformsAccessorStorage::GetUniformsAccessor(const ShaderProgram& program)
   {
-    const PipelineUniforms& uniforms = program.GetCombinedUniformsInformation();
-    const std::vector<vk::DescriptorSetLayout>& layouts = program.GetLayouts();
+    return GetUniformsAccessor(program.GetCombinedUniformsInformation(), program.GetLayouts());
+  }
 
+  UniformsAccessor* UniformsAccessorStorage::GetUniformsAccessor(const ComputeProgram& program)
+  {
+    return GetUniformsAccessor(program.GetCombinedUniformsInformation(), program.GetLayouts());
+  }
+
+  UniformsAccessor* UniformsAccessorStorage::GetUniformsAccessor(const PipelineUniforms& uniforms, const std::vector<vk::DescriptorSetLayout>& layouts)
+  {
     const auto it = contexts.find(uniforms);
     if (it != contexts.end())
     {
       return it->second.get();
     }
 
-    contexts[uniforms] = std::make_unique<UniformsAccessor>(core, descriptorPool, layouts, uniforms);
+    contexts[uniforms] = std::make_unique<UniformsAccessor>(core, descriptorSetCache, uniformRing, layouts, uniforms);
 
     return contexts.at(uniforms).get();
   }
@@ -9,19 +9,28 @@ namespace Vulkan
 {
   class Core;
   class ShaderProgram;
+  class ComputeProgram;
+  class UniformRing;
+  class DescriptorSetCache;
 
   class UniformsAccessorStorage
   {
   public:
-    UniformsAccessorStorage(Core& core, vk::DescriptorPool descriptorPool);
+    UniformsAccessorStorage(Core& core, DescriptorSetCache* descriptorSetCache, UniformRing* uniformRing);
 
     UniformsAccessor* GetUniformsAccessor(const ShaderProgram& program);
 
+    UniformsAccessor* GetUniformsAccessor(const ComputeProgram& program);
+
     void Reset();
 
+  private:
+    UniformsAccessor* GetUniformsAccessor(const PipelineUniforms& uniforms, const std::vector<vk::DescriptorSetLayout>& layouts);
+
   private:
     Core& core;
-    vk::DescriptorPool descriptorPool;
+    DescriptorSetCache* descriptorSetCache;
+    UniformRing* uniformRing;
 
     std::map<PipelineUniforms, std::unique_ptr<UniformsAccessor>> contexts;
   };
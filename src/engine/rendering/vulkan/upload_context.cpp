@@ -0,0 +1,272 @@
+#include "upload_context.h"
+#include "core.h"
+
+namespace
+{
+  constexpr vk::DeviceSize StagingAlignment = 16;
+}
+
+namespace Vulkan
+{
+  UploadContext::UploadContext(Core& core, vk::Queue queue, uint32_t queueFamilyIndex, uint32_t dstQueueFamilyIndex, vk::DeviceSize stagingSize)
+    : core(core)
+    , logicalDevice(core.GetLogicalDevice())
+    , queue(queue)
+    , queueFamilyIndex(queueFamilyIndex)
+    , dstQueueFamilyIndex(dstQueueFamilyIndex)
+    , stagingSize(stagingSize)
+    , stagingHead(0)
+    , stagingUsed(0)
+    , lastSubmittedTicket(0)
+  {
+    const auto cmdPoolCreateInfo = vk::CommandPoolCreateInfo()
+      .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient)
+      .setQueueFamilyIndex(queueFamilyIndex);
+    cmdPool = logicalDevice.createCommandPoolUnique(cmdPoolCreateInfo);
+
+    const auto semaphoreTypeCreateInfo = vk::SemaphoreTypeCreateInfo()
+      .setSemaphoreType(vk::SemaphoreType::eTimeline)
+      .setInitialValue(0);
+    timelineSemaphore = logicalDevice.createSemaphoreUnique(vk::SemaphoreCreateInfo().setPNext(&semaphoreTypeCreateInfo));
+
+    staging = core.AllocateHostBuffer(stagingSize, vk::BufferUsageFlagBits::eTransferSrc);
+  }
+
+  UploadContext::~UploadContext()
+  {
+    Wait(Submit());
+  }
+
+  void UploadContext::CopyToBuffer(const void* src, vk::DeviceSize size, vk::Buffer dst, vk::DeviceSize dstOffset)
+  {
+    const auto [stagingBuffer, stagingOffset] = WriteStaging(src, size);
+
+    const auto copyRegion = vk::BufferCopy()
+      .setSize(size)
+      .setSrcOffset(stagingOffset)
+      .setDstOffset(dstOffset);
+
+    GetRecordingBatch().cmdBuffer->copyBuffer(stagingBuffer, dst, 1, &copyRegion);
+  }
+
+  void UploadContext::CopyToImage(const void* src, vk::DeviceSize size, vk::Image dst, const vk::ImageSubresourceRange& subresourceRange, const std::vector<vk::BufferImageCopy>& copyRegions, vk::ImageLayout finalLayout)
+  {
+    const auto [stagingBuffer, stagingOffset] = WriteStaging(src, size);
+    vk::CommandBuffer cmdBuffer = GetRecordingBatch().cmdBuffer.get();
+
+    auto imgMemoryBarrier = vk::ImageMemoryBarrier()
+      .setSrcAccessMask(vk::AccessFlagBits{})
+      .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setOldLayout(vk::ImageLayout::eUndefined)
+      .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setImage(dst)
+      .setSubresourceRange(subresourceRange);
+
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+      vk::DependencyFlagBits{},
+      0, nullptr,
+      0, nullptr,
+      1, &imgMemoryBarrier);
+
+    std::vector<vk::BufferImageCopy> regions = copyRegions;
+    for (vk::BufferImageCopy& region : regions)
+      region.bufferOffset += stagingOffset;
+
+    cmdBuffer.copyBufferToImage(stagingBuffer, dst, vk::ImageLayout::eTransferDstOptimal, static_cast<uint32_t>(regions.size()), regions.data());
+
+    //same family: the image is visible to every shader stage reading it
+    if (queueFamilyIndex == dstQueueFamilyIndex)
+    {
+      imgMemoryBarrier = vk::ImageMemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(finalLayout)
+        .setImage(dst)
+        .setSubresourceRange(subresourceRange);
+
+      cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits{},
+        0, nullptr,
+        0, nullptr,
+        1, &imgMemoryBarrier);
+
+      return;
+    }
+
+    //exclusive image changes the owner: release here, the matching acquire goes to the graphics queue
+    imgMemoryBarrier = vk::ImageMemoryBarrier()
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits{})
+      .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setNewLayout(finalLayout)
+      .setSrcQueueFamilyIndex(queueFamilyIndex)
+      .setDstQueueFamilyIndex(dstQueueFamilyIndex)
+      .setImage(dst)
+      .setSubresourceRange(subresourceRange);
+
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+      vk::DependencyFlagBits{},
+      0, nullptr,
+      0, nullptr,
+      1, &imgMemoryBarrier);
+
+    GetRecordingBatch().acquireBarriers.push_back(imgMemoryBarrier
+      .setSrcAccessMask(vk::AccessFlagBits{})
+      .setDstAccessMask(vk::AccessFlagBits::eShaderRead));
+  }
+
+  UploadTicket UploadContext::Submit()
+  {
+    if (!recordingBatch.has_value())
+      return lastSubmittedTicket;
+
+    Batch& batch = recordingBatch.value();
+    batch.cmdBuffer->end();
+    batch.ticket = ++lastSubmittedTicket;
+
+    const auto timelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+      .setSignalSemaphoreValueCount(1)
+      .setPSignalSemaphoreValues(&batch.ticket);
+
+    const auto submitInfo = vk::SubmitInfo()
+      .setPNext(&timelineSubmitInfo)
+      .setCommandBufferCount(1)
+      .setPCommandBuffers(&batch.cmdBuffer.get())
+      .setSignalSemaphoreCount(1)
+      .setPSignalSemaphores(&timelineSemaphore.get());
+
+    queue.submit(1, &submitInfo, vk::Fence{});
+
+    pendingAcquireBarriers.insert(pendingAcquireBarriers.end(), batch.acquireBarriers.begin(), batch.acquireBarriers.end());
+    batch.acquireBarriers.clear();
+
+    inFlightBatches.push_back(std::move(batch));
+    recordingBatch.reset();
+
+    return lastSubmittedTicket;
+  }
+
+  bool UploadContext::RecordAcquireBarriers(vk::CommandBuffer cmdBuffer)
+  {
+    if (pendingAcquireBarriers.empty())
+      return false;
+
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+      vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+      vk::DependencyFlagBits{},
+      0, nullptr,
+      0, nullptr,
+      static_cast<uint32_t>(pendingAcquireBarriers.size()), pendingAcquireBarriers.data());
+
+    pendingAcquireBarriers.clear();
+    return true;
+  }
+
+  bool UploadContext::IsComplete(UploadTicket ticket) const
+  {
+    return logicalDevice.getSemaphoreCounterValue(timelineSemaphore.get()) >= ticket;
+  }
+
+  void UploadContext::Wait(UploadTicket ticket) const
+  {
+    const auto waitInfo = vk::SemaphoreWaitInfo()
+      .setSemaphoreCount(1)
+      .setPSemaphores(&timelineSemaphore.get())
+      .setPValues(&ticket);
+
+    logicalDevice.waitSemaphores(waitInfo, uint64_t(-1));
+  }
+
+  UploadContext::Batch& UploadContext::GetRecordingBatch()
+  {
+    if (recordingBatch.has_value())
+      return recordingBatch.value();
+
+    Batch batch;
+    if (!freeCmdBuffers.empty())
+    {
+      batch.cmdBuffer = std::move(freeCmdBuffers.back());
+      freeCmdBuffers.pop_back();
+    }
+    else
+    {
+      const auto cmdBufferAllocateInfo = vk::CommandBufferAllocateInfo()
+        .setCommandPool(cmdPool.get())
+        .setCommandBufferCount(1)
+        .setLevel(vk::CommandBufferLevel::ePrimary);
+
+      batch.cmdBuffer = std::move(logicalDevice.allocateCommandBuffersUnique(cmdBufferAllocateInfo)[0]);
+    }
+
+    batch.cmdBuffer->begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    recordingBatch = std::move(batch);
+    return recordingBatch.value();
+  }
+
+  std::tuple<vk::Buffer, vk::DeviceSize> UploadContext::WriteStaging(const void* src, vk::DeviceSize size)
+  {
+    //too big for the ring, give it its own staging buffer that lives until the batch is retired
+    if (size > stagingSize)
+    {
+      HostBuffer overflow = core.AllocateHostBuffer(size, vk::BufferUsageFlagBits::eTransferSrc);
+      overflow.UploadMemory(src, size, 0);
+
+      const vk::Buffer buffer = overflow.GetBuffer();
+      GetRecordingBatch().overflowBuffers.push_back(std::move(overflow));
+
+      return { buffer, 0 };
+    }
+
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize consumed = 0;
+    auto tryReserve = [&]()
+    {
+      if (stagingUsed == 0)
+        stagingHead = 0;
+
+      offset = (stagingHead + StagingAlignment - 1) & ~(StagingAlignment - 1);
+      if (offset + size > stagingSize)
+        offset = 0;
+
+      consumed = (offset >= stagingHead ? offset - stagingHead : stagingSize - stagingHead) + size;
+      return stagingUsed + consumed <= stagingSize;
+    };
+
+    RetireCompletedBatches();
+    while (!tryReserve())
+    {
+      if (!inFlightBatches.empty())
+        Wait(inFlightBatches.front().ticket);
+      else
+        Wait(Submit());
+
+      RetireCompletedBatches();
+    }
+
+    staging.UploadMemory(src, size, offset);
+    stagingHead = offset + size;
+    stagingUsed += consumed;
+    GetRecordingBatch().stagingBytes += consumed;
+
+    return { staging.GetBuffer(), offset };
+  }
+
+  void UploadContext::RetireCompletedBatches()
+  {
+    const UploadTicket completedTicket = logicalDevice.getSemaphoreCounterValue(timelineSemaphore.get());
+
+    while (!inFlightBatches.empty() && inFlightBatches.front().ticket <= completedTicket)
+    {
+      Batch& batch = inFlightBatches.front();
+
+      stagingUsed -= batch.stagingBytes;
+      batch.cmdBuffer->reset(vk::CommandBufferResetFlags());
+      freeCmdBuffers.push_back(std::move(batch.cmdBuffer));
+
+      inFlightBatches.pop_front();
+    }
+  }
+}
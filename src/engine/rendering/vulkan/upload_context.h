@@ -0,0 +1,90 @@
+#pragma once
+
+#include "buffer.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <vector>
+#include <tuple>
+#include <optional>
+
+namespace Vulkan
+{
+  class Core;
+
+  //value of the upload timeline semaphore signaled when a batch is finished
+  typedef uint64_t UploadTicket;
+
+  //copies go through a persistently mapped staging ring into one transfer command buffer,
+  //the host waits only in Wait. images uploaded on a family other than the graphics one
+  //are acquired on the graphics queue with RecordAcquireBarriers after their batch is submitted
+  class UploadContext
+  {
+    struct Batch
+    {
+      vk::UniqueCommandBuffer cmdBuffer;
+      UploadTicket ticket = 0;
+      vk::DeviceSize stagingBytes = 0;
+      std::vector<HostBuffer> overflowBuffers;
+      std::vector<vk::ImageMemoryBarrier> acquireBarriers;
+    };
+
+  public:
+    UploadContext(Core& core, vk::Queue queue, uint32_t queueFamilyIndex, uint32_t dstQueueFamilyIndex, vk::DeviceSize stagingSize);
+
+    ~UploadContext();
+
+    void CopyToBuffer(const void* src, vk::DeviceSize size, vk::Buffer dst, vk::DeviceSize dstOffset = 0);
+
+    void CopyToImage(const void* src, vk::DeviceSize size, vk::Image dst, const vk::ImageSubresourceRange& subresourceRange, const std::vector<vk::BufferImageCopy>& copyRegions, vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    //submits everything recorded so far, returns the ticket of the last submitted batch
+    UploadTicket Submit();
+
+    //records ownership acquires of the images from the submitted batches, returns false when there was nothing to acquire
+    bool RecordAcquireBarriers(vk::CommandBuffer cmdBuffer);
+
+    bool IsComplete(UploadTicket ticket) const;
+
+    void Wait(UploadTicket ticket) const;
+
+    inline UploadTicket GetLastSubmittedTicket() const
+    {
+      return lastSubmittedTicket;
+    }
+
+    inline vk::Semaphore GetTimelineSemaphore() const
+    {
+      return timelineSemaphore.get();
+    }
+
+  private:
+    Batch& GetRecordingBatch();
+
+    std::tuple<vk::Buffer, vk::DeviceSize> WriteStaging(const void* src, vk::DeviceSize size);
+
+    void RetireCompletedBatches();
+
+  private:
+    Core& core;
+    vk::Device logicalDevice;
+    vk::Queue queue;
+    uint32_t queueFamilyIndex;
+    uint32_t dstQueueFamilyIndex;
+    vk::UniqueCommandPool cmdPool;
+    vk::UniqueSemaphore timelineSemaphore;
+
+    HostBuffer staging;
+    vk::DeviceSize stagingSize;
+    vk::DeviceSize stagingHead;
+    vk::DeviceSize stagingUsed;
+
+    std::optional<Batch> recordingBatch;
+    std::deque<Batch> inFlightBatches;
+    std::vector<vk::UniqueCommandBuffer> freeCmdBuffers;
+    std::vector<vk::ImageMemoryBarrier> pendingAcquireBarriers;
+
+    UploadTicket lastSubmittedTicket;
+  };
+}
@@ -16,7 +16,14 @@ namespace Vulkan
     glm::vec3 position;
     glm::vec2 uv;
 
-    static inline VertexInputDeclaration GetVID()
+    //built once, copies keep the interned id of the pipeline keys
+    static inline const VertexInputDeclaration& GetVID()
+    {
+      static const VertexInputDeclaration vid = CreateVID();
+      return vid;
+    }
+
+    static inline VertexInputDeclaration CreateVID()
     {
       VertexInputDeclaration vid;
 
@@ -37,7 +44,14 @@ namespace Vulkan
   {
     glm::vec3 position;
 
-    static inline VertexInputDeclaration GetVID()
+    //built once, copies keep the interned id of the pipeline keys
+    static inline const VertexInputDeclaration& GetVID()
+    {
+      static const VertexInputDeclaration vid = CreateVID();
+      return vid;
+    }
+
+    static inline VertexInputDeclaration CreateVID()
     {
       VertexInputDeclaration vid;
       vid.AddBindingDescription(0, sizeof(SkyBoxVertex));
@@ -1,5 +1,8 @@
 #include "vertex_input_declaration.h"
 
+#include <mutex>
+#include <unordered_map>
+
 namespace vk
 {
   bool operator<(const vk::VertexInputBindingDescription& l, const vk::VertexInputBindingDescription& r)
@@ -13,8 +16,32 @@ namespace vk
   }
 }
 
+namespace
+{
+  //declarations are interned once per object, not per pipeline lookup
+  std::mutex internMutex;
+  std::vector<Vulkan::VertexInputDeclaration> internedDeclarations;
+  std::unordered_multimap<uint64_t, uint32_t> internedIds;
+}
+
 namespace Vulkan
 {
+  VertexInputDeclaration::VertexInputDeclaration(const VertexInputDeclaration& r)
+    : bindingDescriptions(r.bindingDescriptions)
+    , attributeDescriptions(r.attributeDescriptions)
+    , id(r.id.load(std::memory_order_relaxed))
+  {
+  }
+
+  VertexInputDeclaration& VertexInputDeclaration::operator=(const VertexInputDeclaration& r)
+  {
+    bindingDescriptions = r.bindingDescriptions;
+    attributeDescriptions = r.attributeDescriptions;
+    id.store(r.id.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    return *this;
+  }
+
   void VertexInputDeclaration::AddBindingDescription(const uint32_t binding, const uint32_t stride)
   {
     const auto bindingDsc = vk::VertexInputBindingDescription()
@@ -22,6 +49,7 @@ namespace Vulkan
       .setStride(stride);
 
     bindingDescriptions.push_back(bindingDsc);
+    id.store(0, std::memory_order_relaxed);
   }
 
   void VertexInputDeclaration::AddAttributeDescription(const vk::Format format, const uint32_t binding, const uint32_t location, const uint32_t offset)
@@ -33,6 +61,7 @@ namespace Vulkan
       .setOffset(offset);
 
     attributeDescriptions.push_back(attributeDsc);
+    id.store(0, std::memory_order_relaxed);
   }
 
   const std::vector<vk::VertexInputBindingDescription>& VertexInputDeclaration::GetBindingDescriptions() const
@@ -49,4 +78,64 @@ namespace Vulkan
   {
     return std::tie(bindingDescriptions, attributeDescriptions) < std::tie(r.bindingDescriptions, r.attributeDescriptions);
   }
+
+  bool VertexInputDeclaration::operator==(const VertexInputDeclaration& r) const
+  {
+    return bindingDescriptions == r.bindingDescriptions && attributeDescriptions == r.attributeDescriptions;
+  }
+
+  uint64_t VertexInputDeclaration::GetHash() const
+  {
+    //FNV-1a over the fields, descriptions are small
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](uint64_t v)
+    {
+      hash ^= v;
+      hash *= 1099511628211ull;
+    };
+
+    for (const vk::VertexInputBindingDescription& b : bindingDescriptions)
+    {
+      add(b.binding);
+      add(b.stride);
+      add(static_cast<uint64_t>(b.inputRate));
+    }
+
+    for (const vk::VertexInputAttributeDescription& a : attributeDescriptions)
+    {
+      add(a.location);
+      add(a.binding);
+      add(static_cast<uint64_t>(a.format));
+      add(a.offset);
+    }
+
+    return hash;
+  }
+
+  uint32_t VertexInputDeclaration::GetId() const
+  {
+    const uint32_t cachedId = id.load(std::memory_order_relaxed);
+    if (cachedId != 0)
+      return cachedId;
+
+    const uint64_t hash = GetHash();
+
+    std::lock_guard<std::mutex> lock(internMutex);
+
+    uint32_t internedId = 0;
+    const auto [begin, end] = internedIds.equal_range(hash);
+    for (auto it = begin; it != end && internedId == 0; ++it)
+      if (internedDeclarations[it->second - 1] == *this)
+        internedId = it->second;
+
+    if (internedId == 0)
+    {
+      internedDeclarations.push_back(*this);
+      internedId = static_cast<uint32_t>(internedDeclarations.size());
+      internedIds.emplace(hash, internedId);
+    }
+
+    id.store(internedId, std::memory_order_relaxed);
+    return internedId;
+  }
 }
\ No newline at end of file
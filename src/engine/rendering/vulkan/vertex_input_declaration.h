@@ -1,8 +1,8 @@
 #pragma once
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.hpp>
 
+#include <atomic>
 #include <tuple>
 
 namespace Vulkan 
@@ -10,6 +10,10 @@ namespace Vulkan
   class VertexInputDeclaration
   {
   public:
+    VertexInputDeclaration() = default;
+    VertexInputDeclaration(const VertexInputDeclaration& r);
+    VertexInputDeclaration& operator=(const VertexInputDeclaration& r);
+
     void AddBindingDescription(const uint32_t binding, const uint32_t stride);
 
     void AddAttributeDescription(const vk::Format format, const uint32_t binding, const uint32_t location, const uint32_t offset);
@@ -19,8 +23,17 @@ namespace Vulkan
 
     bool operator<(const VertexInputDeclaration& r) const;
 
+    bool operator==(const VertexInputDeclaration& r) const;
+
+    uint64_t GetHash() const;
+
+    //equal declarations share the id, it is interned on the first call and kept by the copies
+    uint32_t GetId() const;
+
   private:
     std::vector<vk::VertexInputBindingDescription> bindingDescriptions;
     std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
+    //zero until interned
+    mutable std::atomic<uint32_t> id{ 0 };
   };
 }
\ No newline at end of file
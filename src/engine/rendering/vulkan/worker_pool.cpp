@@ -0,0 +1,97 @@
+#include "worker_pool.h"
+
+#include <engine/profiling/cpu_profiler.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace Vulkan
+{
+  WorkerPool::WorkerPool(const std::string& name, uint32_t workersCount)
+    : name(name)
+    , activeJobs(0)
+    , isStopping(false)
+  {
+    if (workersCount == 0)
+      throw std::runtime_error("WorkerPool::WorkerPool: pool requires at least one worker.");
+
+    workers.reserve(workersCount);
+    for (uint32_t i = 0; i < workersCount; ++i)
+      workers.emplace_back(&WorkerPool::WorkerLoop, this, i);
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      isStopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (std::thread& worker : workers)
+      worker.join();
+  }
+
+  void WorkerPool::Submit(WorkerJob job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push(std::move(job));
+      ++activeJobs;
+    }
+    jobAvailable.notify_one();
+  }
+
+  void WorkerPool::Wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [this]() { return activeJobs == 0; });
+
+    if (failure)
+    {
+      std::exception_ptr e = failure;
+      failure = nullptr;
+      std::rethrow_exception(e);
+    }
+  }
+
+  void WorkerPool::WorkerLoop(uint32_t workerIndex)
+  {
+    PROFILE_THREAD_NAME(name + "_" + std::to_string(workerIndex));
+
+    for (;;)
+    {
+      WorkerJob job;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobAvailable.wait(lock, [this]() { return isStopping || !jobs.empty(); });
+
+        if (jobs.empty())
+          return;
+
+        job = std::move(jobs.front());
+        jobs.pop();
+      }
+
+      std::exception_ptr jobFailure;
+      try
+      {
+        PROFILE_ZONE("WorkerPool::Job");
+        job(workerIndex);
+      }
+      catch (...)
+      {
+        jobFailure = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (jobFailure && !failure)
+          failure = jobFailure;
+
+        --activeJobs;
+      }
+      jobsDone.notify_all();
+    }
+  }
+}
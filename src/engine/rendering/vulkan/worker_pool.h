@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <queue>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace Vulkan
+{
+  //job receives the index of the worker executing it
+  typedef std::function<void(uint32_t workerIndex)> WorkerJob;
+
+  class WorkerPool
+  {
+  public:
+    //name prefixes the workers' thread names in the profiler traces
+    WorkerPool(const std::string& name, uint32_t workersCount);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(WorkerJob job);
+
+    //blocks until every submitted job is done, rethrows the first failure
+    void Wait();
+
+    inline uint32_t GetWorkersCount() const
+    {
+      return static_cast<uint32_t>(workers.size());
+    }
+
+  private:
+    void WorkerLoop(uint32_t workerIndex);
+
+  private:
+    std::string name;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    std::queue<WorkerJob> jobs;
+    uint32_t activeJobs;
+    std::exception_ptr failure;
+    bool isStopping;
+  };
+}
@@ -50,6 +50,114 @@ SCENARIO("Uniforms from different stages can be merged", "[SpirvParser]") {
   }
 }
 
+SCENARIO("Storage uniforms of a compute shader are recognized", "[SpirvParser]") {
+  SpirvParser parser;
+
+  GIVEN("Compute shader with a storage image and a storage buffer") {
+    auto shader = ReadFile("../data/shaders/spirv/tests/test2_compute_storage.comp.spv");
+
+    WHEN("Shader is parsed") {
+      auto uniforms = parser.ParseShader(shader);
+
+      THEN("Storage uniforms are recognized") {
+        REQUIRE(uniforms.sets.size() == 1);
+        REQUIRE(uniforms.sets[0].inUse == true);
+        REQUIRE(uniforms.sets[0].bindings.size() == 2);
+        REQUIRE(uniforms.sets[0].bindings[0].type == UniformType::StorageImage);
+        REQUIRE(uniforms.sets[0].bindings[0].stages == SHADER_COMPUTE_STAGE);
+        REQUIRE(uniforms.sets[0].bindings[1].type == UniformType::StorageBuffer);
+        REQUIRE(uniforms.sets[0].bindings[1].size == 16 * 16);
+        REQUIRE(uniforms.sets[0].bindings[1].stages == SHADER_COMPUTE_STAGE);
+        REQUIRE(uniforms.uniformsMap.find("storage_image_uniform") != uniforms.uniformsMap.end());
+        REQUIRE(uniforms.uniformsMap.find("storage_buffer_uniform") != uniforms.uniformsMap.end());
+      }
+    }
+  }
+}
+
+SCENARIO("Sets split by update frequency keep their indices", "[SpirvParser]") {
+  SpirvParser parser;
+
+  GIVEN("Vertex shader with per-frame and per-draw sets and no material set") {
+    auto shader = ReadFile("../data/shaders/spirv/tests/test3_frequency_sets.vert.spv");
+
+    WHEN("Shader is parsed") {
+      auto uniforms = parser.ParseShader(shader);
+
+      THEN("The unused set between them is kept empty") {
+        REQUIRE(uniforms.sets.size() == 3);
+        REQUIRE(uniforms.sets[0].inUse == true);
+        REQUIRE(uniforms.sets[1].inUse == false);
+        REQUIRE(uniforms.sets[1].bindings.empty());
+        REQUIRE(uniforms.sets[2].inUse == true);
+        REQUIRE(uniforms.sets[2].bindings[0].type == UniformType::UniformBuffer);
+        REQUIRE(uniforms.sets[2].bindings[0].size == 64);
+        REQUIRE(uniforms.GetSetBindingPair("per_draw_uniform").set == 2);
+      }
+    }
+  }
+}
+
+SCENARIO("Push constants are reflected and merged", "[SpirvParser]") {
+  SpirvParser parser;
+
+  GIVEN("Vertex shader with a whole push constant block and fragment shader with its tail") {
+    auto vertex = ReadFile("../data/shaders/spirv/tests/test4_push_constants.vert.spv");
+    auto fragment = ReadFile("../data/shaders/spirv/tests/test4_push_constants.frag.spv");
+
+    WHEN("Shaders are parsed") {
+      auto vertexUniforms = parser.ParseShader(vertex);
+      auto fragmentUniforms = parser.ParseShader(fragment);
+
+      THEN("Every stage has its own range") {
+        REQUIRE(vertexUniforms.sets.empty());
+        REQUIRE(vertexUniforms.pushConstants.offset == 0);
+        REQUIRE(vertexUniforms.pushConstants.size == 80);
+        REQUIRE(vertexUniforms.pushConstants.stages == SHADER_VERTEX_STAGE);
+        REQUIRE(fragmentUniforms.pushConstants.offset == 64);
+        REQUIRE(fragmentUniforms.pushConstants.size == 16);
+        REQUIRE(fragmentUniforms.pushConstants.stages == SHADER_FRAGMENT_STAGE);
+      }
+    }
+
+    WHEN("Their uniforms are merged") {
+      auto uniforms = parser.ParseShader(fragment) + parser.ParseShader(vertex);
+
+      THEN("The range covers both stages") {
+        REQUIRE(uniforms.pushConstants.offset == 0);
+        REQUIRE(uniforms.pushConstants.size == 80);
+        REQUIRE(uniforms.pushConstants.stages == (SHADER_VERTEX_STAGE | SHADER_FRAGMENT_STAGE));
+      }
+    }
+  }
+}
+
+SCENARIO("Specialization constants are reflected and merged", "[SpirvParser]") {
+  SpirvParser parser;
+
+  GIVEN("Vertex and fragment shaders sharing a specialization constant") {
+    auto vertex = ReadFile("../data/shaders/spirv/tests/test5_specialization.vert.spv");
+    auto fragment = ReadFile("../data/shaders/spirv/tests/test5_specialization.frag.spv");
+
+    WHEN("Their uniforms are parsed and merged") {
+      auto uniforms = parser.ParseShader(vertex) + parser.ParseShader(fragment);
+      auto& constants = uniforms.specializationConstants;
+
+      THEN("Every constant keeps its id, default value and stages") {
+        REQUIRE(constants.size() == 3);
+        REQUIRE(constants.at("use_offset").id == 0);
+        REQUIRE(constants.at("use_offset").defaultValue == 0);
+        REQUIRE(constants.at("use_offset").stages == (SHADER_VERTEX_STAGE | SHADER_FRAGMENT_STAGE));
+        REQUIRE(constants.at("offset").id == 1);
+        REQUIRE(constants.at("offset").stages == SHADER_VERTEX_STAGE);
+        REQUIRE(constants.at("outputs_count").id == 2);
+        REQUIRE(constants.at("outputs_count").defaultValue == 3);
+        REQUIRE(constants.at("outputs_count").stages == SHADER_FRAGMENT_STAGE);
+      }
+    }
+  }
+}
+
 int main(int argc, char* argv[]) {
   // global setup...
 